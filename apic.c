@@ -0,0 +1,238 @@
+/* apic.c - Functions to interact with the local and I/O APICs
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "i8259.h"
+#include "spinlock.h"
+#include "paging/page_structs.h"
+#include "paging/tlb.h"
+#include "devices/pit.h"
+#include "scheduler/scheduler.h"
+#include "scheduler/smp.h"
+
+uint8_t apic_enabled = 0;
+
+static uint32_t lapic_base = LAPIC_DEFAULT_BASE;
+static uint32_t ioapic_base = IOAPIC_DEFAULT_BASE;
+
+/* local APIC timer count for one scheduler tick, measured once by the boot processor */
+static uint32_t lapic_timer_count = 0;
+
+/* I/O APIC pin and MP table flags of each ISA IRQ, identity unless the MP table overrides it */
+static uint8_t isa_irq_pin[ISA_IRQS] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static uint16_t isa_irq_flags[ISA_IRQS];
+
+/* the select/window pair has to be written back to back */
+static spinlock_t ioapic_lock = SPINLOCK_INIT;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t *)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(lapic_base + reg) = val;
+}
+
+static void ioapic_write(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t *)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t *)(ioapic_base + IOAPIC_WINDOW) = val;
+}
+
+/* void apic_map(uint32_t lapic_addr, uint32_t ioapic_addr);
+ * Inputs: lapic_addr -- physical address of the local APIC registers
+ *         ioapic_addr -- physical address of the I/O APIC registers
+ * Return Value: none
+ * Function: Identity maps the 4MB pages holding both, uncached and kernel only */
+void apic_map(uint32_t lapic_addr, uint32_t ioapic_addr) {
+    lapic_base = lapic_addr;
+    ioapic_base = ioapic_addr;
+
+    page_directory[lapic_base >> PAGE_DIR_SHIFT] = (lapic_base & FOUR_MB_PAGE_MASK) | RW_SUPERVISOR_UNCACHED_4MB_MASK;
+    page_directory[ioapic_base >> PAGE_DIR_SHIFT] = (ioapic_base & FOUR_MB_PAGE_MASK) | RW_SUPERVISOR_UNCACHED_4MB_MASK;
+
+    tlb_flush_page(lapic_base, TLB_REASON_APIC);
+    tlb_flush_page(ioapic_base, TLB_REASON_APIC);
+}
+
+/* void apic_set_isa_route(uint32_t irq, uint8_t pin, uint16_t flags);
+ * Inputs: irq -- ISA IRQ number
+ *         pin -- I/O APIC input it is wired to
+ *         flags -- polarity and trigger mode from the MP table, 0 for the bus default
+ * Return Value: none
+ * Function: Records an interrupt assignment read from the MP table */
+void apic_set_isa_route(uint32_t irq, uint8_t pin, uint16_t flags) {
+    if (irq >= ISA_IRQS)
+        return;
+    isa_irq_pin[irq] = pin;
+    isa_irq_flags[irq] = flags;
+}
+
+/* void ioapic_set_irq(uint32_t irq, uint8_t masked);
+ * Inputs: irq -- ISA IRQ number
+ *         masked -- 1 to mask it, 0 to deliver it
+ * Return Value: none
+ * Function: Programs the redirection entry for irq. ISA IRQs all go to the
+ *           boot processor on the same vector the PICs used */
+void ioapic_set_irq(uint32_t irq, uint8_t masked) {
+    uint32_t low;
+    uint32_t reg;
+    uint32_t flags;
+
+    if (irq >= ISA_IRQS)
+        return;
+
+    low = ISA_IRQ_VECTOR_BASE + irq;
+    if ((isa_irq_flags[irq] & MP_INTR_POLARITY_MASK) == MP_INTR_POLARITY_LOW)
+        low |= IOAPIC_ACTIVE_LOW;
+    if ((isa_irq_flags[irq] & MP_INTR_TRIGGER_MASK) == MP_INTR_TRIGGER_LEVEL)
+        low |= IOAPIC_LEVEL;
+    if (masked)
+        low |= IOAPIC_MASKED;
+
+    // each redirection entry is two registers, low half first
+    reg = IOAPIC_REDTBL + 2 * isa_irq_pin[irq];
+    spin_lock_irqsave(&ioapic_lock, flags);
+    ioapic_write(reg + 1, (uint32_t) cpus[0].apic_id << IOAPIC_DEST_SHIFT);
+    ioapic_write(reg, low);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/* uint8_t lapic_id(void);
+ * Inputs: none
+ * Return Value: APIC id of this processor */
+uint8_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/* void lapic_eoi(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Tells this processor's local APIC we are done with the current interrupt */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Writes the interrupt command register and waits for the local APIC to send it */
+static void lapic_send_icr(uint8_t apic_id, uint32_t low) {
+    uint32_t flags;
+    cli_and_save(flags);
+
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t) apic_id << LAPIC_ICR_DEST_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, low);
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+        asm volatile ("pause");
+
+    restore_flags(flags);
+}
+
+/* void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+ * Inputs: apic_id -- processor to interrupt
+ *         vector -- vector it takes the interrupt on
+ * Return Value: none */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector) {
+    lapic_send_icr(apic_id, vector);
+}
+
+/* void lapic_start_ap(uint8_t apic_id, uint32_t addr);
+ * Inputs: apic_id -- processor to wake up
+ *         addr -- 4kB aligned real mode address below 1MB it starts at
+ * Return Value: none
+ * Function: INIT, then two STARTUPs as the MP spec says. A processor that already
+ *           started ignores the second one */
+void lapic_start_ap(uint8_t apic_id, uint32_t addr) {
+    lapic_send_icr(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    lapic_send_icr(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    pit_delay_us(AP_INIT_DELAY_US);
+
+    lapic_send_icr(apic_id, LAPIC_ICR_STARTUP | (addr >> 12));
+    pit_delay_us(AP_STARTUP_DELAY_US);
+    lapic_send_icr(apic_id, LAPIC_ICR_STARTUP | (addr >> 12));
+    pit_delay_us(AP_STARTUP_DELAY_US);
+}
+
+/* Counts local APIC timer ticks over LAPIC_CALIBRATE_US of PIT time */
+static void lapic_timer_calibrate(void) {
+    uint32_t elapsed;
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    pit_delay_us(LAPIC_CALIBRATE_US);
+    elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    lapic_timer_count = elapsed * (1000000 / LAPIC_CALIBRATE_US) / LAPIC_TIMER_HZ;
+    if (lapic_timer_count == 0)
+        lapic_timer_count = 1;
+}
+
+/* void lapic_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Software enables this processor's local APIC, masks the legacy
+ *           LINT pins and starts the periodic scheduler tick */
+void lapic_init(void) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+
+    // the error status register has to be written before it is read
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+
+    if (lapic_timer_count == 0)
+        lapic_timer_calibrate();
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_timer_count);
+}
+
+/* void apic_enable(uint8_t has_imcr);
+ * Inputs: has_imcr -- the MP table says the PICs are wired through an IMCR
+ * Return Value: none
+ * Function: Masks the 8259s, moves every IRQ they had enabled over to the
+ *           I/O APIC and brings up the boot processor's local APIC. Must be
+ *           called with interrupts off */
+void apic_enable(uint8_t has_imcr) {
+    uint32_t irq;
+    uint32_t pin;
+
+    // machines with an IMCR send the PICs straight to the processor until told otherwise
+    if (has_imcr) {
+        outb(IMCR_SELECT, IMCR_SELECT_PORT);
+        outb(IMCR_APIC_MODE, IMCR_DATA_PORT);
+    }
+
+    for (pin = 0; pin < ISA_IRQS; pin++)
+        ioapic_write(IOAPIC_REDTBL + 2 * pin, IOAPIC_MASKED);
+
+    apic_enabled = 1;
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        if (irq == SLAVE_IRQ)
+            continue;
+        if (irq < NUM_IRQS && !(master_mask & (1 << irq)))
+            ioapic_set_irq(irq, 0);
+        if (irq >= NUM_IRQS && !(slave_mask & (1 << (irq - NUM_IRQS))))
+            ioapic_set_irq(irq, 0);
+    }
+
+    outb(FULL_MASK, MASTER_8259_PORT_DATA);
+    outb(FULL_MASK, SLAVE_8259_PORT_DATA);
+
+    lapic_init();
+}
+
+/* void lapic_timer_handler(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Per processor tick, same job as the PIT has on one processor */
+void lapic_timer_handler(void) {
+    // acknowledge first, we may not return here until our next time slice
+    lapic_eoi();
+    scheduler_step();
+}
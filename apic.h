@@ -0,0 +1,112 @@
+/* apic.h - Defines used in interactions with the local and I/O APICs
+ * vim:ts=4 noexpandtab
+ *
+ * On a multiprocessor machine the 8259s are masked and the I/O APIC delivers
+ * the ISA IRQs to the boot processor instead. Every processor gets its
+ * scheduler tick from its own local APIC timer.
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+/* Vectors past the ones the PICs use */
+#define LAPIC_TIMER_VECTOR  0x40
+#define RESCHED_VECTOR      0x41
+#define SPURIOUS_VECTOR     0xFF
+
+#ifndef ASM
+
+#include "types.h"
+
+/* Where the APICs live unless the MP table says otherwise */
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+#define IOAPIC_DEFAULT_BASE 0xFEC00000
+
+/* Local APIC registers, byte offsets from its base */
+#define LAPIC_ID            0x020
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ESR           0x280
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+#define LAPIC_ID_SHIFT          24
+#define LAPIC_SVR_ENABLE        0x00000100
+#define LAPIC_LVT_MASKED        0x00010000
+#define LAPIC_TIMER_PERIODIC    0x00020000
+#define LAPIC_TIMER_DIV_16      0x3
+#define LAPIC_ICR_INIT          0x00000500
+#define LAPIC_ICR_STARTUP       0x00000600
+#define LAPIC_ICR_PENDING       0x00001000
+#define LAPIC_ICR_ASSERT        0x00004000
+#define LAPIC_ICR_LEVEL         0x00008000
+#define LAPIC_ICR_DEST_SHIFT    24
+
+/* I/O APIC registers, reached through the select/window pair */
+#define IOAPIC_REGSEL       0x00
+#define IOAPIC_WINDOW       0x10
+#define IOAPIC_REDTBL       0x10
+#define IOAPIC_MASKED       0x00010000
+#define IOAPIC_ACTIVE_LOW   0x00002000
+#define IOAPIC_LEVEL        0x00008000
+#define IOAPIC_DEST_SHIFT   24
+
+/* MP table interrupt flags for an ISA IRQ routed to an I/O APIC pin */
+#define MP_INTR_POLARITY_MASK   0x3
+#define MP_INTR_POLARITY_LOW    0x3
+#define MP_INTR_TRIGGER_MASK    0xC
+#define MP_INTR_TRIGGER_LEVEL   0xC
+
+/* ISA IRQs come in on 0x20 + irq, same as with the PICs */
+#define ISA_IRQS            16
+#define ISA_IRQ_VECTOR_BASE 0x20
+
+/* Interrupt mode configuration register, routes the PICs away from LINT0 */
+#define IMCR_SELECT_PORT    0x22
+#define IMCR_DATA_PORT      0x23
+#define IMCR_SELECT         0x70
+#define IMCR_APIC_MODE      0x01
+
+/* Scheduler ticks per second on each processor */
+#define LAPIC_TIMER_HZ      100
+/* How long the PIT runs while we count local APIC timer ticks, in us */
+#define LAPIC_CALIBRATE_US  10000
+/* Delays the MP spec asks for between INIT and STARTUP IPIs, in us */
+#define AP_INIT_DELAY_US    10000
+#define AP_STARTUP_DELAY_US 200
+
+/* Set once interrupts go through the APICs instead of the 8259s */
+extern uint8_t apic_enabled;
+
+/* Maps the APIC registers, has to run before any processor copies the page directory */
+void apic_map(uint32_t lapic_addr, uint32_t ioapic_addr);
+/* Routes ISA irq to I/O APIC pin with the MP table's polarity/trigger flags */
+void apic_set_isa_route(uint32_t irq, uint8_t pin, uint16_t flags);
+/* Switches the boot processor from the 8259s to the APICs */
+void apic_enable(uint8_t has_imcr);
+/* Enables this processor's local APIC and starts its timer */
+void lapic_init(void);
+/* APIC id of the processor we are running on */
+uint8_t lapic_id(void);
+/* Acknowledges the interrupt being handled on this processor */
+void lapic_eoi(void);
+/* Sends vector to the processor with the given APIC id */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+/* Runs the INIT, STARTUP, STARTUP sequence that wakes up a processor at addr */
+void lapic_start_ap(uint8_t apic_id, uint32_t addr);
+/* Unmasks (masked == 0) or masks an ISA IRQ on the I/O APIC */
+void ioapic_set_irq(uint32_t irq, uint8_t masked);
+/* Local APIC timer interrupt, drives the scheduler */
+void lapic_timer_handler(void);
+
+#endif /* ASM */
+
+#endif /* _APIC_H */
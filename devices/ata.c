@@ -0,0 +1,133 @@
+#include "ata.h"
+#include "../lib.h"
+
+/* void ata_io_delay()
+ * Inputs: None
+ * Return Value: None
+ * Function: the drive needs 400ns after being selected before its status
+ *           means anything, each read of the control port takes ~100ns */
+static void ata_io_delay() {
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+}
+
+/* int32_t ata_wait(uint8_t want_drq)
+ * Inputs: want_drq - also wait for the drive to have data for us or want data from us
+ * Return Value: 0 once it is ready, -1 on an error or if it never gets there
+ * Function: polls the status register */
+static int32_t ata_wait(uint8_t want_drq) {
+    uint32_t status;
+    uint32_t polls;
+
+    for(polls = 0; polls < ATA_POLL_LIMIT; polls++) {
+        status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+        if(status == ATA_STATUS_FLOATING)
+            return -1;
+        if(status & ATA_STATUS_BSY)
+            continue;
+        if(status & (ATA_STATUS_ERR | ATA_STATUS_DF))
+            return -1;
+        if(!want_drq || (status & ATA_STATUS_DRQ))
+            return 0;
+    }
+    return -1;
+}
+
+/* void ata_select(uint8_t drive, uint32_t lba, uint32_t count)
+ * Inputs: drive - ATA_DRIVE_MASTER or ATA_DRIVE_SLAVE
+ *         lba - first sector
+ *         count - sectors the next command covers, 256 is sent as 0
+ * Return Value: None
+ * Function: loads the task file for a read or write */
+static void ata_select(uint8_t drive, uint32_t lba, uint32_t count) {
+    outb(ATA_CTRL_NIEN, ATA_PRIMARY_CTRL);
+    outb(ATA_DRIVE_LBA | (drive ? ATA_DRIVE_SLAVE_BIT : 0) | ((lba >> 24) & 0x0F), ATA_PRIMARY_IO + ATA_REG_DRIVE);
+    ata_io_delay();
+    outb(count & 0xFF, ATA_PRIMARY_IO + ATA_REG_SECCOUNT);
+    outb(lba & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_LO);
+    outb((lba >> 8) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_MID);
+    outb((lba >> 16) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_HI);
+}
+
+/* uint32_t ata_identify(uint8_t drive)
+ * Inputs: drive - ATA_DRIVE_MASTER or ATA_DRIVE_SLAVE
+ * Return Value: sectors the drive has, 0 if nothing answers or it isn't an ATA disk
+ * Function: sends IDENTIFY DEVICE */
+uint32_t ata_identify(uint8_t drive) {
+    uint16_t ident[ATA_SECTOR_WORDS];
+    uint32_t i;
+
+    ata_select(drive, 0, 0);
+    outb(ATA_CMD_IDENTIFY, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+    if(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0)
+        return 0;
+    if(ata_wait(0) != 0)
+        return 0;
+    // ATAPI and SATA devices put their signature here instead of answering
+    if(inb(ATA_PRIMARY_IO + ATA_REG_LBA_MID) != 0 || inb(ATA_PRIMARY_IO + ATA_REG_LBA_HI) != 0)
+        return 0;
+    if(ata_wait(1) != 0)
+        return 0;
+
+    for(i = 0; i < ATA_SECTOR_WORDS; i++)
+        ident[i] = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+    return ident[ATA_IDENT_SECTORS] | ((uint32_t) ident[ATA_IDENT_SECTORS + 1] << 16);
+}
+
+/* int32_t ata_read(uint8_t drive, uint32_t lba, uint32_t count, void* buf)
+ * Inputs: drive - ATA_DRIVE_MASTER or ATA_DRIVE_SLAVE
+ *         lba - first sector
+ *         count - sectors to read, at most 256
+ *         buf - count * ATA_SECTOR_SIZE bytes
+ * Return Value: 0, -1 if the drive reported an error
+ * Function: one READ SECTORS command, polled */
+int32_t ata_read(uint8_t drive, uint32_t lba, uint32_t count, void* buf) {
+    uint16_t* words = (uint16_t *) buf;
+    uint32_t sector, i;
+
+    if(count == 0 || count > 256 || lba + count > ATA_LBA28_MAX)
+        return -1;
+
+    ata_select(drive, lba, count);
+    outb(ATA_CMD_READ_PIO, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+    for(sector = 0; sector < count; sector++) {
+        ata_io_delay();
+        if(ata_wait(1) != 0)
+            return -1;
+        for(i = 0; i < ATA_SECTOR_WORDS; i++)
+            *words++ = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+    }
+    return 0;
+}
+
+/* int32_t ata_write(uint8_t drive, uint32_t lba, uint32_t count, const void* buf)
+ * Inputs: drive - ATA_DRIVE_MASTER or ATA_DRIVE_SLAVE
+ *         lba - first sector
+ *         count - sectors to write, at most 256
+ *         buf - count * ATA_SECTOR_SIZE bytes
+ * Return Value: 0, -1 if the drive reported an error
+ * Function: one WRITE SECTORS command, polled, then a cache flush so the
+ *           data is on the disk once we return */
+int32_t ata_write(uint8_t drive, uint32_t lba, uint32_t count, const void* buf) {
+    const uint16_t* words = (const uint16_t *) buf;
+    uint32_t sector, i;
+
+    if(count == 0 || count > 256 || lba + count > ATA_LBA28_MAX)
+        return -1;
+
+    ata_select(drive, lba, count);
+    outb(ATA_CMD_WRITE_PIO, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+    for(sector = 0; sector < count; sector++) {
+        ata_io_delay();
+        if(ata_wait(1) != 0)
+            return -1;
+        for(i = 0; i < ATA_SECTOR_WORDS; i++)
+            outw(*words++, ATA_PRIMARY_IO + ATA_REG_DATA);
+    }
+
+    outb(ATA_CMD_CACHE_FLUSH, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+    ata_io_delay();
+    return ata_wait(0);
+}
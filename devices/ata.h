@@ -0,0 +1,66 @@
+/** ata.h - polled PIO driver for ATA disks on the primary channel
+ *
+ *  Only LBA28 reads and writes, done a sector at a time by polling the
+ *  status register. The drives are told not to interrupt (nIEN), so IRQ 14
+ *  never fires. Callers serialize access to the channel themselves.
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "../types.h"
+
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+
+// registers, as offsets from ATA_PRIMARY_IO
+#define ATA_REG_DATA        0
+#define ATA_REG_ERROR       1
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA_LO      3
+#define ATA_REG_LBA_MID     4
+#define ATA_REG_LBA_HI      5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7
+#define ATA_REG_COMMAND     7
+
+#define ATA_STATUS_ERR      0x01
+#define ATA_STATUS_DRQ      0x08
+#define ATA_STATUS_DF       0x20
+#define ATA_STATUS_BSY      0x80
+// what an empty channel reads back
+#define ATA_STATUS_FLOATING 0xFF
+
+#define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30
+#define ATA_CMD_CACHE_FLUSH 0xE7
+#define ATA_CMD_IDENTIFY    0xEC
+
+// device control register, keeps the drives from raising interrupts
+#define ATA_CTRL_NIEN       0x02
+
+// drive register, LBA mode with bits 24-27 of the LBA in the low nibble
+#define ATA_DRIVE_LBA       0xE0
+#define ATA_DRIVE_SLAVE_BIT 0x10
+#define ATA_LBA28_MAX       0x0FFFFFFF
+
+#define ATA_DRIVE_MASTER    0
+#define ATA_DRIVE_SLAVE     1
+
+#define ATA_SECTOR_SIZE     512
+#define ATA_SECTOR_WORDS    (ATA_SECTOR_SIZE / 2)
+// IDENTIFY words holding the number of LBA28 sectors
+#define ATA_IDENT_SECTORS   60
+// status polls before we give up on the drive
+#define ATA_POLL_LIMIT      1000000
+
+/* number of LBA28 sectors on drive, 0 if there is no ATA disk there */
+extern uint32_t ata_identify(uint8_t drive);
+
+/* reads count sectors starting at lba into buf, 0 or -1 */
+extern int32_t ata_read(uint8_t drive, uint32_t lba, uint32_t count, void* buf);
+
+/* writes count sectors from buf starting at lba and flushes the drive's cache, 0 or -1 */
+extern int32_t ata_write(uint8_t drive, uint32_t lba, uint32_t count, const void* buf);
+
+#endif /* _ATA_H */
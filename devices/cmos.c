@@ -1,4 +1,5 @@
 #include "cmos.h"
+#include "../paging/vdata.h"
 
 void cmos_init() {
     // enable update interrupts
@@ -34,6 +35,7 @@ void cmos_handler() {
 
     // printf("cmos int\n");
 
-    // things to call on update to datetime
-    update_status_bar_time(cmos_hours, cmos_minutes, cmos_sec);
+    // things to call on update to datetime, drawn later by the kworker
+    queue_status_bar_time(cmos_hours, cmos_minutes, cmos_sec);
+    vdata_set_wall_clock(cmos_hours, cmos_minutes, cmos_sec);
 }
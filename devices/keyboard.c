@@ -1,4 +1,5 @@
 #include "keyboard.h"
+#include "../fs/poll.h"
 
 // global variables
 uint32_t flags;
@@ -60,6 +61,7 @@ void keyboard_handler(void) {
     printable_char = '\0';
     idx_offset = 0;
 
+    spin_lock(&terminal_lock);
     // read status of keyboard
     status = inb(KEYBOARD_STATUS_PORT);
     if (status & 0x01) {
@@ -114,6 +116,11 @@ void keyboard_handler(void) {
             parse_buffer[2] = '0';
             parse_buffer[3] = '1';
             read_parser(parse_buffer);
+        } else if (alt_pressed && ((keycode >= F1 && keycode <= F10) || keycode == F11 || keycode == F12)) {
+            // switch to term n on Fn, other flag is for all terminals inited
+            uint8_t new_term = (keycode <= F10) ? keycode - F1 : keycode - F11 + (F10 - F1 + 1);
+            if (new_term < num_terminals)
+                terminal_switch(new_term);
         } else if (keycode == KEY_UP) {
             prev_command();
         } else if(keycode == KEY_DOWN) {
@@ -144,18 +151,8 @@ void keyboard_handler(void) {
                 key_pressed = 0;
             }
         }
-        if (printable_char == '!' && shift_pressed != 1 && alt_pressed) {
-            // switch to term 1 on F1, other flag is for all terminals inited
-            terminal_switch(TERMINAL_1, 1);
-        } else if (printable_char == '@' && shift_pressed != 1 && alt_pressed) {
-            // switch to term 2 on F2, other flag is for all terminals inited
-            terminal_switch(TERMINAL_2, 1);
-        } else if (printable_char == '#' && shift_pressed != 1 && alt_pressed) {
-            // switch to term 3 on F3, other flag is for all terminals inited
-            terminal_switch(TERMINAL_3, 1);
-        }
         // if char is valid, print it
-        else if (printable_char > 0 && !ctrl_pressed) { //normal character has been pressed
+        if (printable_char > 0 && !ctrl_pressed) { //normal character has been pressed
             // setup condition codes
             parse_buffer[0] = printable_char;
             parse_buffer[1] = '0';
@@ -172,6 +169,7 @@ void keyboard_handler(void) {
         }
 
     }
+    spin_unlock(&terminal_lock);
     // send eoi
     send_eoi(KEYBOARD_IRQ);
 }
@@ -183,12 +181,12 @@ void move_cursor(int cursor_loc) {
     int cursor_row, cursor_col;
 
     //Making sure cursor is not negative
-    if (three_terminals[current_term].cursor_loc <= 0) {
-        three_terminals[current_term].cursor_loc = 0;
+    if (terminals[current_term]->cursor_loc <= 0) {
+        terminals[current_term]->cursor_loc = 0;
     }
     //Getting row and col to display cursor
-    cursor_row = (three_terminals[current_term].cursor_loc / NUM_COLS);
-    cursor_col = (three_terminals[current_term].cursor_loc % NUM_COLS);
+    cursor_row = (terminals[current_term]->cursor_loc / NUM_COLS);
+    cursor_col = (terminals[current_term]->cursor_loc % NUM_COLS);
     //Ensuring cursor is not more than max rows
     if (cursor_row >= NUM_ROWS - STATUS_BAR_HEIGHT) {
         cursor_row = NUM_ROWS - 1 - STATUS_BAR_HEIGHT;
@@ -214,8 +212,8 @@ void enable_cursor() {
     outb((inb(0x3D5) & 0xE0) | 15, 0x3D5);
 
     //Initializing location
-    three_terminals[current_term].cursor_loc = 0;
-    move_cursor(three_terminals[current_term].cursor_loc);
+    terminals[current_term]->cursor_loc = 0;
+    move_cursor(terminals[current_term]->cursor_loc);
 }
 /*
  * read_parser()
@@ -232,7 +230,7 @@ void enable_cursor() {
 int read_parser(unsigned char * parser_buffer) {
 
     // only accept keypress if the terminal is doing a terminal read, otherwise block
-    if (!three_terminals[current_term].read_in_progress)
+    if (!terminals[current_term]->read_in_progress)
         return 0;
 
     if (parser_buffer == NULL) { //if parser buffer is empty
@@ -265,19 +263,19 @@ void cursor_left(){
     int bytes_written;
     int live_buffer_location;
 
-    y_loc = three_terminals[current_term].screen_y;
-    x_loc = three_terminals[current_term].screen_x;
-    row_idx = three_terminals[current_term].row_index;
-    bytes_written = three_terminals[current_term].bytes_written;
-    live_buffer_location = three_terminals[current_term].live_buffer_location;
+    y_loc = terminals[current_term]->screen_y;
+    x_loc = terminals[current_term]->screen_x;
+    row_idx = terminals[current_term]->row_index;
+    bytes_written = terminals[current_term]->bytes_written;
+    live_buffer_location = terminals[current_term]->live_buffer_location;
 
 
     if ((live_buffer_location > bytes_written)){
-            three_terminals[current_term].cursor_loc--;
-            three_terminals[current_term].screen_x = three_terminals[current_term].cursor_loc % NUM_COLS;
-            three_terminals[current_term].screen_y = three_terminals[current_term].cursor_loc / NUM_COLS;
-            move_cursor(three_terminals[current_term].cursor_loc);
-            three_terminals[current_term].live_buffer_location--;
+            terminals[current_term]->cursor_loc--;
+            terminals[current_term]->screen_x = terminals[current_term]->cursor_loc % NUM_COLS;
+            terminals[current_term]->screen_y = terminals[current_term]->cursor_loc / NUM_COLS;
+            move_cursor(terminals[current_term]->cursor_loc);
+            terminals[current_term]->live_buffer_location--;
     }
 }
 /*
@@ -295,19 +293,19 @@ void cursor_right(){
     int bytes_written;
     int live_buffer_location;
 
-    y_loc = three_terminals[current_term].screen_y;
-    x_loc = three_terminals[current_term].screen_x;
-    row_idx = three_terminals[current_term].row_index;
-    bytes_written = three_terminals[current_term].bytes_written;
-    bytes_read = three_terminals[current_term].bytes_read;
-    live_buffer_location = three_terminals[current_term].live_buffer_location;
+    y_loc = terminals[current_term]->screen_y;
+    x_loc = terminals[current_term]->screen_x;
+    row_idx = terminals[current_term]->row_index;
+    bytes_written = terminals[current_term]->bytes_written;
+    bytes_read = terminals[current_term]->bytes_read;
+    live_buffer_location = terminals[current_term]->live_buffer_location;
 
     if (!(y_loc == NUM_ROWS - 1 && x_loc == NUM_COLS - 1) && (live_buffer_location < bytes_read)){
-            three_terminals[current_term].cursor_loc++;
-            three_terminals[current_term].screen_x = three_terminals[current_term].cursor_loc % NUM_COLS;
-            three_terminals[current_term].screen_y = three_terminals[current_term].cursor_loc / NUM_COLS;
-            move_cursor(three_terminals[current_term].cursor_loc);
-            three_terminals[current_term].live_buffer_location++;
+            terminals[current_term]->cursor_loc++;
+            terminals[current_term]->screen_x = terminals[current_term]->cursor_loc % NUM_COLS;
+            terminals[current_term]->screen_y = terminals[current_term]->cursor_loc / NUM_COLS;
+            move_cursor(terminals[current_term]->cursor_loc);
+            terminals[current_term]->live_buffer_location++;
     }
 }
 /*
@@ -325,15 +323,15 @@ void command_buffer_scroll(int terminal_idx){
 
     for (row = 0; row < MAX_COMMAND_STORE-1; row++){
         for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++){
-            three_terminals[terminal_idx].command_buffer[row][idx] = three_terminals[terminal_idx].command_buffer[row+1][idx];
+            terminals[terminal_idx]->command_buffer[row][idx] = terminals[terminal_idx]->command_buffer[row+1][idx];
         }
     }
 
     for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++){
-        three_terminals[terminal_idx].command_buffer[MAX_COMMAND_STORE-1][idx] = '\0';
+        terminals[terminal_idx]->command_buffer[MAX_COMMAND_STORE-1][idx] = '\0';
     }
 
-    three_terminals[terminal_idx].write_command_row = MAX_COMMAND_STORE-1;
+    terminals[terminal_idx]->write_command_row = MAX_COMMAND_STORE-1;
 
 }
 /*
@@ -350,38 +348,38 @@ void prev_command(){
     int view_row;
     int write_row;
     char parse_buffer[4];
-    view_row = three_terminals[current_term].view_command_row;
-    write_row = three_terminals[current_term].write_command_row;
-    bytes_written = three_terminals[current_term].bytes_written;
-    bytes_read_store = three_terminals[current_term].bytes_read_store;
+    view_row = terminals[current_term]->view_command_row;
+    write_row = terminals[current_term]->write_command_row;
+    bytes_written = terminals[current_term]->bytes_written;
+    bytes_read_store = terminals[current_term]->bytes_read_store;
 
     if (view_row == write_row){
         buf_idx = bytes_written;
         for (idx = 0; idx < SCREEN_SIZE; idx++){
             if (idx < bytes_read_store)
-                three_terminals[current_term].temp_commands[idx] = three_terminals[current_term].live_buffer[buf_idx];
+                terminals[current_term]->temp_commands[idx] = terminals[current_term]->live_buffer[buf_idx];
             else
             {
-                three_terminals[current_term].temp_commands[idx] = '\0';
+                terminals[current_term]->temp_commands[idx] = '\0';
             }
             buf_idx++;  
         }
-        three_terminals[current_term].temp_bytes_read = three_terminals[current_term].bytes_read;
+        terminals[current_term]->temp_bytes_read = terminals[current_term]->bytes_read;
     }
 
     if (view_row > 0){
-        three_terminals[current_term].view_command_row--;
-        view_row = three_terminals[current_term].view_command_row;
+        terminals[current_term]->view_command_row--;
+        view_row = terminals[current_term]->view_command_row;
 
         for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++) {
             backspace();
         }
 
         for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++) { //copy data from keyboard buffer into char_buffer
-            if (three_terminals[current_term].command_buffer[view_row][idx] == '\0'){
+            if (terminals[current_term]->command_buffer[view_row][idx] == '\0'){
                 break;
             }
-                parse_buffer[0] = three_terminals[current_term].command_buffer[view_row][idx];
+                parse_buffer[0] = terminals[current_term]->command_buffer[view_row][idx];
                 parse_buffer[1] = '0';
                 parse_buffer[2] = '0';
                 parse_buffer[3] = '0';
@@ -403,41 +401,41 @@ void next_command(){
     int view_row;
     int write_row;
     char parse_buffer[4];
-    view_row = three_terminals[current_term].view_command_row;
-    write_row = three_terminals[current_term].write_command_row;
-    bytes_written = three_terminals[current_term].bytes_written;
-    bytes_read_store = three_terminals[current_term].bytes_read_store;
+    view_row = terminals[current_term]->view_command_row;
+    write_row = terminals[current_term]->write_command_row;
+    bytes_written = terminals[current_term]->bytes_written;
+    bytes_read_store = terminals[current_term]->bytes_read_store;
 
     if (view_row == write_row){
         buf_idx = bytes_written;
         for (idx = 0; idx < SCREEN_SIZE; idx++){
             if (idx < bytes_read_store)
-                three_terminals[current_term].temp_commands[idx] = three_terminals[current_term].live_buffer[buf_idx];
+                terminals[current_term]->temp_commands[idx] = terminals[current_term]->live_buffer[buf_idx];
             else
             {
-                three_terminals[current_term].temp_commands[idx] = '\0';
+                terminals[current_term]->temp_commands[idx] = '\0';
             }
             buf_idx++;  
         }
-        three_terminals[current_term].temp_bytes_read = three_terminals[current_term].bytes_read;
+        terminals[current_term]->temp_bytes_read = terminals[current_term]->bytes_read;
     }
 
     if (view_row < write_row){
-        three_terminals[current_term].view_command_row++;
-        view_row = three_terminals[current_term].view_command_row;
+        terminals[current_term]->view_command_row++;
+        view_row = terminals[current_term]->view_command_row;
 
         for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++) {
             backspace();
         }
 
         for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++) { //copy data from keyboard buffer into char_buffer
-            if (three_terminals[current_term].command_buffer[view_row][idx] == '\0'){
+            if (terminals[current_term]->command_buffer[view_row][idx] == '\0'){
                 break;
             }
             if (view_row <= write_row-1)
-                parse_buffer[0] = three_terminals[current_term].command_buffer[view_row][idx];
+                parse_buffer[0] = terminals[current_term]->command_buffer[view_row][idx];
             else
-                parse_buffer[0] = three_terminals[current_term].temp_commands[idx];
+                parse_buffer[0] = terminals[current_term]->temp_commands[idx];
             parse_buffer[1] = '0';
             parse_buffer[2] = '0';
             parse_buffer[3] = '0';
@@ -448,26 +446,21 @@ void next_command(){
 /*
  * terminal_scroll
  * Description: Scrolls the terminal window up when necessary
- * Input: None
+ * Input: terminal_idx - terminal to scroll
  * Output: None
  * Side effects: Updates the history buffer to scroll up
  * Return: None
  */
-void terminal_scroll() {
+void terminal_scroll(int terminal_idx) {
     //Initializing variables
     int idx;
-    int row;
     uint32_t addr;
-    uint32_t terminal_idx;
 
     //Getting the right address to scroll
-    if (current_term == all_process[current_process_pid].active_terminal_idx) {
+    if (current_term == terminal_idx)
         addr = VISUAL_VIRTUAL_ADDR;
-        terminal_idx = current_term;
-    } else {
-        terminal_idx = all_process[current_process_pid].active_terminal_idx;
+    else
         addr = virtual_terminal_addresses[terminal_idx];
-    }
 
     char * video_mem_ptr = (char * ) addr;
 
@@ -479,30 +472,53 @@ void terminal_scroll() {
         *(uint8_t * )(video_mem_ptr + ((NUM_COLS * (NUM_ROWS - STATUS_BAR_HEIGHT - 1) + idx) << 1)) = '\0';
     }
 
-    // update history buffer
+    // update history buffer once we are out of the interrupt handler
+    queue_work(&terminals[terminal_idx]->history_work);
+
+    // adjust bookkeeping info
+    terminals[terminal_idx]->row_index--;
+    terminals[terminal_idx]->screen_x = 0;
+    terminals[terminal_idx]->screen_y = (NUM_ROWS - STATUS_BAR_HEIGHT - 1);
+    terminals[terminal_idx]->cursor_loc = (NUM_COLS * terminals[terminal_idx]->row_index);
+}
+
+/*
+ * terminal_history_sync
+ * Description: Copies what is on a terminal's screen into its history buffer
+ * Input: terminal_idx - terminal that scrolled
+ * Output: none
+ * Side effects: overwrites the history buffer, a row at a time so the keyboard isn't held off
+ * Return: none
+ */
+void terminal_history_sync(uint32_t terminal_idx) {
+    int idx;
+    int row;
+    char * video_mem_ptr;
+    uint32_t flags;
+
     for (row = 0; row < NUM_ROWS - STATUS_BAR_HEIGHT; row++) {
+        spin_lock_irqsave(&terminal_lock, flags);
+        // the terminal may have been switched on or off screen since it scrolled
+        if (current_term == (int) terminal_idx)
+            video_mem_ptr = (char * ) VISUAL_VIRTUAL_ADDR;
+        else
+            video_mem_ptr = (char * ) virtual_terminal_addresses[terminal_idx];
         for (idx = 0; idx < NUM_COLS; idx++) {
-            three_terminals[terminal_idx].history_buffer[row][idx] = * (uint8_t * )(video_mem_ptr + ((NUM_COLS * row + idx) << 1));
+            terminals[terminal_idx]->history_buffer[row][idx] = * (uint8_t * )(video_mem_ptr + ((NUM_COLS * row + idx) << 1));
         }
+        spin_unlock_irqrestore(&terminal_lock, flags);
     }
-
-    // adjust bookkeeping info
-    three_terminals[terminal_idx].row_index--;
-    three_terminals[terminal_idx].screen_x = 0;
-    three_terminals[terminal_idx].screen_y = (NUM_ROWS - STATUS_BAR_HEIGHT - 1);
-    three_terminals[terminal_idx].cursor_loc = (NUM_COLS * three_terminals[terminal_idx].row_index);
 }
 
 /*
  * terminal_switch
  * Description: Switches to a different terminal to display
  * Input: new_term - terminal we want to switch to
-          all_terms_initialized - have we initialized all the terminals yet
  * Output: none
  * Side effects: displays a different terminal
  * Return: none
  */
-void terminal_switch(int new_term, uint8_t all_terms_initialized) {
+void terminal_switch(int new_term) {
 
     if (new_term == current_term)
         return;
@@ -513,17 +529,15 @@ void terminal_switch(int new_term, uint8_t all_terms_initialized) {
     memcpy((void * ) VISUAL_VIRTUAL_ADDR, (void * ) virtual_terminal_addresses[new_term], 0x1000);
 
     //Updating the cursor
-    uint8_t old_term = current_term;
     current_term = new_term;
-    move_cursor(three_terminals[new_term].cursor_loc);
+    move_cursor(terminals[new_term]->cursor_loc);
 
-    draw_status_bar();
+    queue_status_bar_redraw();
 
-    //Switching over
-    if (all_terms_initialized) {
-        current_multiprocess = new_term;
-        process_context_switch(old_term, new_term);
-    }
+    //the running process's vidmap page may have just moved on or off screen, here and on every other processor
+    if (current_process_pid != NO_PID)
+        scheduler_map_process(PCB[current_process_pid]);
+    scheduler_kick_others();
 }
 
 /*
@@ -538,28 +552,28 @@ void buffer_clear() {
     //Initialize variables
     int idx;
     int row;
-    three_terminals[current_term].cursor_loc = 0;
+    terminals[current_term]->cursor_loc = 0;
 
     //Move Cursor and updating last row
-    move_cursor(three_terminals[current_term].cursor_loc);
+    move_cursor(terminals[current_term]->cursor_loc);
     for (row = 0; row < NUM_ROWS - STATUS_BAR_HEIGHT; row++)
         for (idx = 0; idx < NUM_COLS; idx++)
-            three_terminals[current_term].history_buffer[row][idx] = '\0'; //clear the history buffer
+            terminals[current_term]->history_buffer[row][idx] = '\0'; //clear the history buffer
 
     clear_multi((uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term);
-    three_terminals[current_term].row_index = 0;
+    terminals[current_term]->row_index = 0;
 
     //Reprinting the last row
-    for (idx = 0; idx < three_terminals[current_term].bytes_read; idx++) {
-        three_terminals[current_term].history_buffer[three_terminals[current_term].row_index][idx] = three_terminals[current_term].live_buffer[idx]; //store the keyboard buffer into history buffer
-        putc_multi(three_terminals[current_term].history_buffer[three_terminals[current_term].row_index][idx], (uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term); //output the line keyboard buffer
-        three_terminals[current_term].cursor_loc += 1;
-        three_terminals[current_term].screen_x = three_terminals[current_term].cursor_loc % NUM_COLS;
-        three_terminals[current_term].screen_y = three_terminals[current_term].cursor_loc / NUM_COLS;
-        move_cursor(three_terminals[current_term].cursor_loc);
+    for (idx = 0; idx < terminals[current_term]->bytes_read; idx++) {
+        terminals[current_term]->history_buffer[terminals[current_term]->row_index][idx] = terminals[current_term]->live_buffer[idx]; //store the keyboard buffer into history buffer
+        putc_multi(terminals[current_term]->history_buffer[terminals[current_term]->row_index][idx], (uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term); //output the line keyboard buffer
+        terminals[current_term]->cursor_loc += 1;
+        terminals[current_term]->screen_x = terminals[current_term]->cursor_loc % NUM_COLS;
+        terminals[current_term]->screen_y = terminals[current_term]->cursor_loc / NUM_COLS;
+        move_cursor(terminals[current_term]->cursor_loc);
     }
 
-    three_terminals[current_term].live_buffer_location = three_terminals[current_term].bytes_read;
+    terminals[current_term]->live_buffer_location = terminals[current_term]->bytes_read;
 
 }
 
@@ -573,45 +587,48 @@ void buffer_clear() {
  */
 void new_line() {
     int idx;
-    for (idx = 0; idx < three_terminals[current_term].bytes_read; idx++) {
-        if (idx >= NUM_COLS && (three_terminals[current_term].row_index + 1 < NUM_ROWS - STATUS_BAR_HEIGHT)) {
-            three_terminals[current_term].history_buffer[three_terminals[current_term].row_index + 1][idx - NUM_COLS] = three_terminals[current_term].live_buffer[idx];
+    for (idx = 0; idx < terminals[current_term]->bytes_read; idx++) {
+        if (idx >= NUM_COLS && (terminals[current_term]->row_index + 1 < NUM_ROWS - STATUS_BAR_HEIGHT)) {
+            terminals[current_term]->history_buffer[terminals[current_term]->row_index + 1][idx - NUM_COLS] = terminals[current_term]->live_buffer[idx];
         } else
-            three_terminals[current_term].history_buffer[three_terminals[current_term].row_index][idx] = three_terminals[current_term].live_buffer[idx];
+            terminals[current_term]->history_buffer[terminals[current_term]->row_index][idx] = terminals[current_term]->live_buffer[idx];
     }
     //update row_indexes, two if more than one line is types
-    if (three_terminals[current_term].bytes_read > NUM_COLS)
-        three_terminals[current_term].row_index += 2;
+    if (terminals[current_term]->bytes_read > NUM_COLS)
+        terminals[current_term]->row_index += 2;
     else
-        three_terminals[current_term].row_index += 1;
+        terminals[current_term]->row_index += 1;
     //store a copy of live_buffer into live_buffer_storage for terminal_read usage
-    for (idx = 0; idx < three_terminals[current_term].bytes_read; idx++)
-        three_terminals[current_term].live_buffer_store[idx] = three_terminals[current_term].live_buffer[idx]; //store current live buffer into storage for terminal_read usage
+    for (idx = 0; idx < terminals[current_term]->bytes_read; idx++)
+        terminals[current_term]->live_buffer_store[idx] = terminals[current_term]->live_buffer[idx]; //store current live buffer into storage for terminal_read usage
     //store a new line character into last character for live_buffer_storage indicates new line character has been pressed
-    three_terminals[current_term].live_buffer_store[three_terminals[current_term].bytes_read] = '\n';
+    terminals[current_term]->live_buffer_store[terminals[current_term]->bytes_read] = '\n';
     //clear live_buffer
-    for (idx = 0; idx < three_terminals[current_term].bytes_read; idx++)
-        three_terminals[current_term].live_buffer[idx] = '\0';
+    for (idx = 0; idx < terminals[current_term]->bytes_read; idx++)
+        terminals[current_term]->live_buffer[idx] = '\0';
 
-    three_terminals[current_term].bytes_read_store = three_terminals[current_term].bytes_read; //store bytes_read into storage
+    terminals[current_term]->bytes_read_store = terminals[current_term]->bytes_read; //store bytes_read into storage
 
-    three_terminals[current_term].bytes_read = 0;
-    three_terminals[current_term].live_buffer_location = three_terminals[current_term].bytes_read;
+    terminals[current_term]->bytes_read = 0;
+    terminals[current_term]->live_buffer_location = terminals[current_term]->bytes_read;
     putc_multi('\n', (uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term);
+    //a line is ready for terminal_read
+    wake_up(&terminals[current_term]->read_queue);
+    poll_wake();
 
     //scroll the screen upward
     if (row_index >= NUM_ROWS - STATUS_BAR_HEIGHT) {
-        terminal_scroll();
+        terminal_scroll(current_term);
     }
 
     //reset bytes written
-    if (three_terminals[current_term].bytes_written > 0) {
-        three_terminals[current_term].bytes_written = 0;
+    if (terminals[current_term]->bytes_written > 0) {
+        terminals[current_term]->bytes_written = 0;
     }
 
     //update cursor position
-    three_terminals[current_term].cursor_loc = ((three_terminals[current_term].cursor_loc / NUM_COLS) + 1) * NUM_COLS;
-    move_cursor(three_terminals[current_term].cursor_loc);
+    terminals[current_term]->cursor_loc = ((terminals[current_term]->cursor_loc / NUM_COLS) + 1) * NUM_COLS;
+    move_cursor(terminals[current_term]->cursor_loc);
 }
 
 /*
@@ -626,39 +643,39 @@ void backspace() {
     int idx;
     int cursor_flag;
 
-    if (three_terminals[current_term].live_buffer_location > three_terminals[current_term].bytes_written) {
-        three_terminals[current_term].bytes_read--; //decrement amount of bytes read
-        three_terminals[current_term].live_buffer_location--;
+    if (terminals[current_term]->live_buffer_location > terminals[current_term]->bytes_written) {
+        terminals[current_term]->bytes_read--; //decrement amount of bytes read
+        terminals[current_term]->live_buffer_location--;
         cursor_flag = 1;
-        if (three_terminals[current_term].bytes_read < 0) { //check if line is already clear, if so set to zero to prevent errors
-            three_terminals[current_term].bytes_read = 0; //
+        if (terminals[current_term]->bytes_read < 0) { //check if line is already clear, if so set to zero to prevent errors
+            terminals[current_term]->bytes_read = 0; //
             cursor_flag = 0;
         }
 
-        three_terminals[current_term].live_buffer[three_terminals[current_term].live_buffer_location] = '\0'; //set last pressed entry in keyboard buffer to null
+        terminals[current_term]->live_buffer[terminals[current_term]->live_buffer_location] = '\0'; //set last pressed entry in keyboard buffer to null
 
-        if (three_terminals[current_term].screen_x == 0) {
-            three_terminals[current_term].screen_x = NUM_COLS - 1;
-            three_terminals[current_term].screen_y -= 1;
+        if (terminals[current_term]->screen_x == 0) {
+            terminals[current_term]->screen_x = NUM_COLS - 1;
+            terminals[current_term]->screen_y -= 1;
         } else {
-            three_terminals[current_term].screen_x -= 1;
+            terminals[current_term]->screen_x -= 1;
         }
 
-        if (three_terminals[current_term].live_buffer_location < three_terminals[current_term].bytes_read){
-            for (idx = three_terminals[current_term].live_buffer_location; idx < three_terminals[current_term].bytes_read+1; idx++){
-                three_terminals[current_term].live_buffer[idx] = three_terminals[current_term].live_buffer[idx+1];
-                setc_multi(idx, three_terminals[current_term].row_index, getc_multi(idx+1, three_terminals[current_term].row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
+        if (terminals[current_term]->live_buffer_location < terminals[current_term]->bytes_read){
+            for (idx = terminals[current_term]->live_buffer_location; idx < terminals[current_term]->bytes_read+1; idx++){
+                terminals[current_term]->live_buffer[idx] = terminals[current_term]->live_buffer[idx+1];
+                setc_multi(idx, terminals[current_term]->row_index, getc_multi(idx+1, terminals[current_term]->row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
             }
-            three_terminals[current_term].live_buffer[idx] = '\0';
-            setc_multi(idx, three_terminals[current_term].row_index, '\0', (uint8_t * ) VISUAL_VIRTUAL_ADDR);
+            terminals[current_term]->live_buffer[idx] = '\0';
+            setc_multi(idx, terminals[current_term]->row_index, '\0', (uint8_t * ) VISUAL_VIRTUAL_ADDR);
         } else {
-            setc_multi(three_terminals[current_term].screen_x, three_terminals[current_term].screen_y, '\0', (uint8_t * ) VISUAL_VIRTUAL_ADDR);
+            setc_multi(terminals[current_term]->screen_x, terminals[current_term]->screen_y, '\0', (uint8_t * ) VISUAL_VIRTUAL_ADDR);
         }
 
         //Updating cursor if necessary
-        if (three_terminals[current_term].cursor_loc > 0 && cursor_flag == 1) {
-            three_terminals[current_term].cursor_loc -= 1;
-            move_cursor(three_terminals[current_term].cursor_loc);
+        if (terminals[current_term]->cursor_loc > 0 && cursor_flag == 1) {
+            terminals[current_term]->cursor_loc -= 1;
+            move_cursor(terminals[current_term]->cursor_loc);
         }
     }
 }
@@ -676,35 +693,35 @@ void tab(unsigned char * parser_buffer) {
     int line_estimate;
     int tab_counter = 0;
     //The number is 3 because we are added three more spaces after the first for tab key
-    if ((three_terminals[current_term].bytes_read + 3) < (CHAR_BUFFER_SIZE - 1 + three_terminals[current_term].bytes_written)) { //check if tab will exceed maxinum char_buffer_size
+    if ((terminals[current_term]->bytes_read + 3) < (CHAR_BUFFER_SIZE - 1 + terminals[current_term]->bytes_written)) { //check if tab will exceed maxinum char_buffer_size
         for (tab_counter = 0; tab_counter < 4; tab_counter++) { //place 4 tabs into buffer
-            if (three_terminals[current_term].bytes_read >= NUM_COLS) { //check if we will got to a second line
+            if (terminals[current_term]->bytes_read >= NUM_COLS) { //check if we will got to a second line
                 line_estimate = 1; //buffer is over NUM_COL size with the new tab pressed
             } else {
                 line_estimate = 0;
             }
             //Scrolling if necessary
-            if ((line_estimate + three_terminals[current_term].row_index) >= NUM_ROWS - STATUS_BAR_HEIGHT) {
-                terminal_scroll();
-                three_terminals[current_term].cursor_loc += NUM_COLS;
+            if ((line_estimate + terminals[current_term]->row_index) >= NUM_ROWS - STATUS_BAR_HEIGHT) {
+                terminal_scroll(current_term);
+                terminals[current_term]->cursor_loc += NUM_COLS;
             }
 
-            if (three_terminals[current_term].live_buffer_location < three_terminals[current_term].bytes_read)
-            for (idx = three_terminals[current_term].bytes_read - 1; idx >= three_terminals[current_term].live_buffer_location; idx--){
-                three_terminals[current_term].live_buffer[idx+1] = three_terminals[current_term].live_buffer[idx];
-                setc_multi(idx+1, three_terminals[current_term].row_index, getc_multi(idx, three_terminals[current_term].row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
+            if (terminals[current_term]->live_buffer_location < terminals[current_term]->bytes_read)
+            for (idx = terminals[current_term]->bytes_read - 1; idx >= terminals[current_term]->live_buffer_location; idx--){
+                terminals[current_term]->live_buffer[idx+1] = terminals[current_term]->live_buffer[idx];
+                setc_multi(idx+1, terminals[current_term]->row_index, getc_multi(idx, terminals[current_term]->row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
             }
 
-            three_terminals[current_term].live_buffer[three_terminals[current_term].live_buffer_location] = parser_buffer[0]; //set new character into the keyboard buffer
+            terminals[current_term]->live_buffer[terminals[current_term]->live_buffer_location] = parser_buffer[0]; //set new character into the keyboard buffer
 
             putc_multi(parser_buffer[0], (uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term); //print space
 
-            three_terminals[current_term].bytes_read++; //increment the amount of bytes read
-            three_terminals[current_term].live_buffer_location++;
+            terminals[current_term]->bytes_read++; //increment the amount of bytes read
+            terminals[current_term]->live_buffer_location++;
         }
         //4 since a tab is four spaces
-        three_terminals[current_term].cursor_loc += 4;
-        move_cursor(three_terminals[current_term].cursor_loc);
+        terminals[current_term]->cursor_loc += 4;
+        move_cursor(terminals[current_term]->cursor_loc);
     }
 }
 
@@ -721,31 +738,31 @@ void output_char(unsigned char * parser_buffer) {
 
     int line_estimate = 0;
 
-    if (three_terminals[current_term].bytes_read < (CHAR_BUFFER_SIZE - 1 + three_terminals[current_term].bytes_written)) { //normal pressing of the keyboard for the rest of the characters
-        if (three_terminals[current_term].bytes_read >= NUM_COLS) { //check if amount of character have exceeded NUM_COLS
+    if (terminals[current_term]->bytes_read < (CHAR_BUFFER_SIZE - 1 + terminals[current_term]->bytes_written)) { //normal pressing of the keyboard for the rest of the characters
+        if (terminals[current_term]->bytes_read >= NUM_COLS) { //check if amount of character have exceeded NUM_COLS
             line_estimate = 1;
         } else {
             line_estimate = 0;
         }
-        if ((line_estimate + three_terminals[current_term].row_index) >= NUM_ROWS - STATUS_BAR_HEIGHT) { //check if we are exceeeding maxinum number of rows
-            terminal_scroll();
-            three_terminals[current_term].cursor_loc += NUM_COLS;
+        if ((line_estimate + terminals[current_term]->row_index) >= NUM_ROWS - STATUS_BAR_HEIGHT) { //check if we are exceeeding maxinum number of rows
+            terminal_scroll(current_term);
+            terminals[current_term]->cursor_loc += NUM_COLS;
         }
 
-        if (three_terminals[current_term].live_buffer_location < three_terminals[current_term].bytes_read)
-            for (idx = three_terminals[current_term].bytes_read - 1; idx >= three_terminals[current_term].live_buffer_location; idx--){
-                three_terminals[current_term].live_buffer[idx+1] = three_terminals[current_term].live_buffer[idx];
-                setc_multi(idx+1, three_terminals[current_term].row_index, getc_multi(idx, three_terminals[current_term].row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
+        if (terminals[current_term]->live_buffer_location < terminals[current_term]->bytes_read)
+            for (idx = terminals[current_term]->bytes_read - 1; idx >= terminals[current_term]->live_buffer_location; idx--){
+                terminals[current_term]->live_buffer[idx+1] = terminals[current_term]->live_buffer[idx];
+                setc_multi(idx+1, terminals[current_term]->row_index, getc_multi(idx, terminals[current_term]->row_index, (uint8_t * ) VISUAL_VIRTUAL_ADDR), (uint8_t * ) VISUAL_VIRTUAL_ADDR);
             }
 
-        three_terminals[current_term].live_buffer[three_terminals[current_term].live_buffer_location] = parser_buffer[0]; //set new character into the keyboard buffer
+        terminals[current_term]->live_buffer[terminals[current_term]->live_buffer_location] = parser_buffer[0]; //set new character into the keyboard buffer
 
         putc_multi(parser_buffer[0], (uint8_t * ) VISUAL_VIRTUAL_ADDR, current_term); //print the character that was pressed to the screen
 
         //Updates bytes read and cursor location
-        three_terminals[current_term].bytes_read++;
-        three_terminals[current_term].live_buffer_location++;
-        three_terminals[current_term].cursor_loc += 1;
-        move_cursor(three_terminals[current_term].cursor_loc);
+        terminals[current_term]->bytes_read++;
+        terminals[current_term]->live_buffer_location++;
+        terminals[current_term]->cursor_loc += 1;
+        move_cursor(terminals[current_term]->cursor_loc);
     }
 }
@@ -19,9 +19,10 @@
 #define BACKSPACE 14
 #define ENTER 28
 #define TAB 15
-#define ALT_F1 0x68
-#define ALT_F2 0x69
-#define ALT_F3 0x6A
+#define F1 0x3B
+#define F10 0x44
+#define F11 0x57
+#define F12 0x58
 #define KEY_UP 0x48
 #define KEY_DOWN 0x50
 #define KEY_RIGHT 0x4D
@@ -65,11 +66,13 @@ void move_cursor(int cursor_loc);
 void enable_cursor();
 
 //switch the terminal
-void terminal_switch(int new_term, uint8_t all_terms_initialized);
+void terminal_switch(int new_term);
 //clear the buffer
 void buffer_clear();
 //scrolls the terminal
-void terminal_scroll();
+void terminal_scroll(int terminal_idx);
+//copies a terminal's screen back into its history buffer, run by the kworker
+void terminal_history_sync(uint32_t terminal_idx);
 void terminal_scrollv2();
 void command_buffer_scroll(int terminal_idx);
 void prev_command();
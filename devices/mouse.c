@@ -1,7 +1,10 @@
 #include "mouse.h"
 #include "keyboard.h"
+#include "../fs/poll.h"
 
 mouse_t mouse_data;
+// valid packets taken so far, a mouse fd's file position holds the count at its last read
+uint32_t mouse_packets;
 
 uint16_t fake_mouse_pos_x = FAKE_MOUSE_RES_X / 2;
 uint16_t fake_mouse_pos_y = FAKE_MOUSE_RES_Y / 2;
@@ -32,6 +35,7 @@ int32_t mouse_read(int fd, void* char_buffer, int bytes) {
     *(ptr + 4) = mouse_data.left_btn;
     *(ptr + 5) = mouse_data.middle_btn;
     *(ptr + 6) = mouse_data.right_btn;
+    current_files[fd].file_position = mouse_packets;
     return 0;
 }
 
@@ -52,6 +56,16 @@ int32_t mouse_write(int32_t fd, const void* buf, int32_t nbytes) {
     return 0;
 }
 
+/* int32_t mouse_poll(int32_t fd);
+ * Inputs: fd -- mouse fd
+ * Return Value: POLLOUT, and POLLIN if the mouse moved since this fd last read it
+ * Function: mouse_read never blocks, POLLIN only tells there is something new */
+int32_t mouse_poll(int32_t fd) {
+    if(current_files[fd].file_position != mouse_packets)
+        return POLLIN | POLLOUT;
+    return POLLOUT;
+}
+
 /* int32_t mouse_close(int32_t fd);
  * Inputs: fd -- ignored
  * Return Value: 0
@@ -167,5 +181,8 @@ void mouse_handler() {
     x_pos = (fake_mouse_pos_x * NUM_COLS) / FAKE_MOUSE_RES_X;
     y_pos = (fake_mouse_pos_y * NUM_ROWS) / FAKE_MOUSE_RES_Y;
 
+    mouse_packets++;
+    poll_wake();
+
     send_eoi(MOUSE_IRQ);
 }
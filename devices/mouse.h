@@ -46,5 +46,6 @@ int32_t mouse_open(const uint8_t* filename);
 int32_t mouse_read(int fd, void* char_buffer, int bytes);
 int32_t mouse_write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t mouse_close(int32_t fd);
+int32_t mouse_poll(int32_t fd);
 
 #endif
@@ -27,10 +27,42 @@ void pit_init() {
     NMI_enable();
 }
 
+/* void pit_delay_us(uint32_t us);
+ * Inputs: us - how long to wait, in microseconds
+ * Return Value: none
+ * Function: Busy waits on PIT channel 2, works with interrupts off and leaves
+ *           channel 0 alone. Used while bringing up the other processors */
+void pit_delay_us(uint32_t us) {
+    uint32_t count;
+    uint8_t gate;
+
+    while(us > PIT_MAX_DELAY_US) {
+        pit_delay_us(PIT_MAX_DELAY_US);
+        us -= PIT_MAX_DELAY_US;
+    }
+    count = (PIT_FREQ / 1000) * us / 1000;
+    if(count == 0)
+        count = 1;
+
+    // gate off and speaker off while we load the count
+    gate = inb(PIT_CH2_GATE_PORT) & ~(PIT_CH2_GATE | PIT_SPEAKER);
+    outb(gate, PIT_CH2_GATE_PORT);
+    outb(ONE_SHOT_CH2_CMD, PIT_MODECMD_PORT);
+    outb(count & 0xFF, PIT_CH2_PORT);
+    outb(count >> 8, PIT_CH2_PORT);
+
+    // raising the gate starts the count, OUT goes high when it hits 0
+    outb(gate | PIT_CH2_GATE, PIT_CH2_GATE_PORT);
+    while(!(inb(PIT_CH2_GATE_PORT) & PIT_CH2_OUT));
+    outb(gate, PIT_CH2_GATE_PORT);
+}
+
 /* void pit_handler(void);
  * Inputs: none
  * Return Value: none
  * Function: Handle IRQ0 PIT interrupts to trigger scheduling step */
 void pit_handler() {
+    // acknowledge first, we may not return here until our next time slice
+    send_eoi(PIT_IRQ);
     scheduler_step();
 }
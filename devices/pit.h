@@ -1,6 +1,8 @@
 #ifndef _PIT_H
 #define _PIT_H
 
+#include "../types.h"
+
 #define PIT_IRQ 0
 #define PIT_MODECMD_PORT 0x43
 #define PIT_CHZ_PORT 0x40
@@ -8,8 +10,21 @@
 
 #define SQ_WAVE_CHZ_CMD 0x36
 
+/* channel 2 is only used for busy waiting, its gate and output are on port 0x61 */
+#define PIT_CH2_PORT 0x42
+#define PIT_CH2_GATE_PORT 0x61
+#define PIT_CH2_GATE 0x01
+#define PIT_SPEAKER 0x02
+#define PIT_CH2_OUT 0x20
+/* channel 2, low then high byte, interrupt on terminal count */
+#define ONE_SHOT_CH2_CMD 0xB0
+/* longest wait a single 16 bit count covers, in us */
+#define PIT_MAX_DELAY_US 50000
+
 void pit_init(void);
 
+void pit_delay_us(uint32_t us);
+
 void pit_handler(void);
 
 #endif /* _PIT_H */
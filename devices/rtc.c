@@ -1,4 +1,5 @@
 #include "rtc.h"
+#include "../fs/poll.h"
 
 uint32_t global_count;
 uint32_t prev_count;
@@ -43,6 +44,7 @@ void rtc_init(void) {
 void rtc_handler(void) {
     
     global_count += 1;
+    poll_wake();
     
     // select register C
     outb(SELECT_C, SELECT_PORT);
@@ -82,16 +84,29 @@ int32_t rtc_open(const uint8_t* filename) {
 }
 
 /* void rtc_read(int32_t fd, void* buf, int32_t nbytes);
- * Inputs: ignored
- * Return Value: 0 on success
+ * Inputs: fd -- rtc fd, the rest are ignored
+ * Return Value: 0 on success, -1 if the fd is nonblocking and the period isn't over
  * spins until interrupt is received */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
-    uint32_t entered_count = global_count;
-    // wait until division # of ticks have passed since we entered rtc_read
-    while(entered_count + PCB[current_process_pid]->file[fd].file_position > global_count);
+    // wait until division # of ticks have passed since the last rtc_read, the inode holds its count
+    while(current_files[fd].inode + current_files[fd].file_position > global_count) {
+        if(current_files[fd].flags & FILE_NONBLOCK_FLAG)
+            return -1;
+    }
+    current_files[fd].inode = global_count;
     return 0;
 }
 
+/* int32_t rtc_poll(int32_t fd);
+ * Inputs: fd -- rtc fd
+ * Return Value: POLLOUT, and POLLIN once rtc_read would return right away
+ * the period is counted from the last read, so a poller never misses one */
+int32_t rtc_poll(int32_t fd) {
+    if(current_files[fd].inode + current_files[fd].file_position > global_count)
+        return POLLOUT;
+    return POLLIN | POLLOUT;
+}
+
 /* void rtc_read(int32_t fd, const void* buf, int32_t nbytes);
  * Inputs: all ignored except for buf -- ptr to integer refering to frequency
  * Return Value: -1 on fail, 0 on success
@@ -101,7 +116,8 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
     if(freq != 0 && (freq & (freq-1)) == 0 && freq <= RTC_MAX_FREQ) {
         // frequency is a power of 2 and is less than the maximum allowed freq
         // save our division in the file position in fd index for the right process
-        PCB[current_process_pid]->file[fd].file_position = RTC_MAX_FREQ / freq;
+        current_files[fd].file_position = RTC_MAX_FREQ / freq;
+        current_files[fd].inode = global_count;
         return 0;
     }
     // one of the preconditions failed
@@ -113,7 +129,7 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
  * Return Value: 0 on success
  * closes the RTC */
 int32_t rtc_close(int32_t fd) {
-    PCB[current_process_pid]->file[fd].file_position = 0;
+    current_files[fd].file_position = 0;
     return 0;
 }
 
@@ -48,6 +48,12 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 /* spins until interrupt is received */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 
+/* POLLIN once a read wouldn't spin, writes never do */
+int32_t rtc_poll(int32_t fd);
+
+/* interrupts taken so far, an rtc fd's inode holds the count at its last read */
+extern uint32_t global_count;
+
 /* closes RTC */
 int32_t rtc_close(int32_t fd);
 
@@ -1,4 +1,7 @@
 #include "terminal.h"
+#include "../fs/poll.h"
+
+spinlock_t terminal_lock = SPINLOCK_INIT;
 
 /*
  * terminal_init
@@ -14,21 +17,21 @@ void terminal_init() {
     //clear the history_buffer
     for (row = 0; row < NUM_ROWS - STATUS_BAR_HEIGHT; row++)
         for (idx = 0; idx < NUM_COLS; idx++)
-            three_terminals[current_term].history_buffer[row][idx] = '\0';
+            terminals[current_term]->history_buffer[row][idx] = '\0';
     //clear the live_buffer
     for (idx = 0; idx < SCREEN_SIZE; idx++) {
-        three_terminals[current_term].live_buffer[idx] = '\0';
-        three_terminals[current_term].live_buffer_store[idx] = '\0';
+        terminals[current_term]->live_buffer[idx] = '\0';
+        terminals[current_term]->live_buffer_store[idx] = '\0';
     }
     //set shared variables to zero
-    three_terminals[current_term].bytes_read = 0;
-    three_terminals[current_term].bytes_read_store = 0;
-    three_terminals[current_term].cursor_loc = 0;
-    three_terminals[current_term].screen_x = 0;
-    three_terminals[current_term].screen_y = 0;
-    three_terminals[current_term].row_index = 0;
-    three_terminals[current_term].bytes_written = 0;
-    three_terminals[current_term].read_in_progress = 0;
+    terminals[current_term]->bytes_read = 0;
+    terminals[current_term]->bytes_read_store = 0;
+    terminals[current_term]->cursor_loc = 0;
+    terminals[current_term]->screen_x = 0;
+    terminals[current_term]->screen_y = 0;
+    terminals[current_term]->row_index = 0;
+    terminals[current_term]->bytes_written = 0;
+    terminals[current_term]->read_in_progress = 0;
 
     // clear screen
     clear_multi((uint8_t * ) virtual_terminal_addresses[current_term], current_term);
@@ -61,17 +64,17 @@ int32_t terminal_close(int fd) {
     //clear history buffer
     for (row = 0; row < NUM_ROWS - STATUS_BAR_HEIGHT; row++)
         for (idx = 0; idx < NUM_COLS; idx++)
-            three_terminals[current_term].history_buffer[row][idx] = '\0';
+            terminals[current_term]->history_buffer[row][idx] = '\0';
     //clear the screen
     clear_multi((uint8_t * ) virtual_terminal_addresses[current_term], current_term);
     //clear all shared vaiables
-    three_terminals[current_term].row_index = 0;
-    three_terminals[current_term].bytes_written = 0;
-    three_terminals[current_term].bytes_read = 0;
-    three_terminals[current_term].bytes_read_store = 0;
+    terminals[current_term]->row_index = 0;
+    terminals[current_term]->bytes_written = 0;
+    terminals[current_term]->bytes_read = 0;
+    terminals[current_term]->bytes_read_store = 0;
     for (idx = 0; idx < CHAR_BUFFER_SIZE; idx++) {
-        three_terminals[current_term].live_buffer[idx] = '\0';
-        three_terminals[current_term].live_buffer_store[idx] = '\0';
+        terminals[current_term]->live_buffer[idx] = '\0';
+        terminals[current_term]->live_buffer_store[idx] = '\0';
     }
     return 0;
 }
@@ -81,8 +84,9 @@ int32_t terminal_close(int fd) {
  * Description: Reads the characters from keyboard and sends to write
  * Input: index, offset, buffer, and amount of characters to write to screen
  * Output: writes buffer globally saved buffer
- * Side effects: Updates the buffer to be written
- * Return: -1 on failure, 0 on success
+ * Side effects: Updates the buffer to be written, blocks until a line is entered
+ *               unless the fd is nonblocking
+ * Return: -1 on failure or if the fd is nonblocking and no line is ready, 0 on success
  */
 int32_t terminal_read(int fd, void * char_buffer, int bytes) {
 
@@ -96,61 +100,71 @@ int32_t terminal_read(int fd, void * char_buffer, int bytes) {
 
     uint32_t addr;
     uint32_t terminal_idx;
+    uint32_t flags;
 
-    if (current_term == all_process[current_process_pid].active_terminal_idx) {
+    if (current_term == PCB[current_process_pid]->terminal_idx) {
         addr = VISUAL_VIRTUAL_ADDR;
         terminal_idx = current_term;
     } else {
-        terminal_idx = all_process[current_process_pid].active_terminal_idx;
+        terminal_idx = PCB[current_process_pid]->terminal_idx;
         addr = virtual_terminal_addresses[terminal_idx];
     }
 
-    three_terminals[terminal_idx].read_in_progress = 1;
+    terminals[terminal_idx]->read_in_progress = 1;
 
     ptr = (char * ) char_buffer;
     if (ptr == NULL || bytes < 0)
         return -1;
-    cli();
-    if (three_terminals[terminal_idx].bytes_written != 0) {
-        local_bytes_written = three_terminals[terminal_idx].bytes_written;
+    spin_lock_irqsave(&terminal_lock, flags);
+    if (terminals[terminal_idx]->bytes_written != 0) {
+        local_bytes_written = terminals[terminal_idx]->bytes_written;
     }
-    sti();
-    // while(three_terminals[current_term].live_buffer_store[three_terminals[current_term].bytes_read_store] != '\n' || current_term != current_multiprocess) {
-    while (three_terminals[terminal_idx].live_buffer_store[three_terminals[terminal_idx].bytes_read_store] != '\n') {
-        //wait until a newline character has been pressed
+    spin_unlock(&terminal_lock);
+    // new_line sets the newline and then wakes us under sched_lock, so checking under it can't miss the wake up
+    spin_lock(&sched_lock);
+    while (terminals[terminal_idx]->live_buffer_store[terminals[terminal_idx]->bytes_read_store] != '\n') {
+        //a nonblocking reader fails here instead, another reader may have taken the line since poll said it was ready
+        if (current_files[fd].flags & FILE_NONBLOCK_FLAG) {
+            terminals[terminal_idx]->read_in_progress = 0;
+            spin_unlock_irqrestore(&sched_lock, flags);
+            return -1;
+        }
+        //sleep until a newline character has been pressed, new_line wakes us up
+        sleep_on(&terminals[terminal_idx]->read_queue);
     }
-    cli();
+    spin_unlock(&sched_lock);
+    spin_lock(&terminal_lock);
     buf_idx = 0;
 
-    if (three_terminals[terminal_idx].write_command_row >= MAX_COMMAND_STORE){
+    if (terminals[terminal_idx]->write_command_row >= MAX_COMMAND_STORE){
         command_buffer_scroll(terminal_idx);
     }
-    command_loc = three_terminals[terminal_idx].write_command_row;
+    command_loc = terminals[terminal_idx]->write_command_row;
 
-    for (idx = local_bytes_written; idx < three_terminals[terminal_idx].bytes_read_store; idx++) { //copy data from keyboard buffer into char_buffer
-        if (buf_idx < three_terminals[terminal_idx].bytes_read_store) {
-            ptr[buf_idx] = three_terminals[terminal_idx].live_buffer_store[idx];
-            if (three_terminals[terminal_idx].bytes_read_store > local_bytes_written){
-                three_terminals[terminal_idx].command_buffer[command_loc][buf_idx] = ptr[buf_idx];
+    for (idx = local_bytes_written; idx < terminals[terminal_idx]->bytes_read_store; idx++) { //copy data from keyboard buffer into char_buffer
+        if (buf_idx < terminals[terminal_idx]->bytes_read_store) {
+            ptr[buf_idx] = terminals[terminal_idx]->live_buffer_store[idx];
+            if (terminals[terminal_idx]->bytes_read_store > local_bytes_written){
+                terminals[terminal_idx]->command_buffer[command_loc][buf_idx] = ptr[buf_idx];
             }
             length += 1;
         }
         buf_idx++;
     }
-    if (three_terminals[terminal_idx].bytes_read_store > local_bytes_written){
-        three_terminals[terminal_idx].write_command_row++;
-        three_terminals[terminal_idx].view_command_row = three_terminals[terminal_idx].write_command_row;
+    if (terminals[terminal_idx]->bytes_read_store > local_bytes_written){
+        terminals[terminal_idx]->write_command_row++;
+        terminals[terminal_idx]->view_command_row = terminals[terminal_idx]->write_command_row;
     }
     ptr[buf_idx] = '\n';
     length += 1;
-    for (idx = 0; idx < three_terminals[terminal_idx].bytes_read_store; idx++) { //set live_buffer_storage to null
-        three_terminals[terminal_idx].live_buffer_store[idx] = '\0';
+    for (idx = 0; idx < terminals[terminal_idx]->bytes_read_store; idx++) { //set live_buffer_storage to null
+        terminals[terminal_idx]->live_buffer_store[idx] = '\0';
     }
-    three_terminals[terminal_idx].bytes_read_store = 0; //set keyboard buffer index to null
+    terminals[terminal_idx]->bytes_read_store = 0; //set keyboard buffer index to null
 
-    three_terminals[terminal_idx].read_in_progress = 0;
+    terminals[terminal_idx]->read_in_progress = 0;
 
-    sti();
+    spin_unlock_irqrestore(&terminal_lock, flags);
     return length; //return the length
 }
 
@@ -175,26 +189,26 @@ int write_parser(unsigned char * parser_buffer) {
 
     uint32_t addr;
     uint32_t terminal_idx;
-    if (current_term == all_process[current_process_pid].active_terminal_idx) {
+    if (current_term == PCB[current_process_pid]->terminal_idx) {
         addr = VISUAL_VIRTUAL_ADDR;
         terminal_idx = current_term;
     } else {
-        terminal_idx = all_process[current_process_pid].active_terminal_idx;
+        terminal_idx = PCB[current_process_pid]->terminal_idx;
         addr = virtual_terminal_addresses[terminal_idx];
     }
 
     //If column overflow then goes to next line
-    if (three_terminals[terminal_idx].bytes_written >= NUM_COLS) {
-        three_terminals[terminal_idx].row_index += 1;
-        three_terminals[terminal_idx].bytes_written = 0;
+    if (terminals[terminal_idx]->bytes_written >= NUM_COLS) {
+        terminals[terminal_idx]->row_index += 1;
+        terminals[terminal_idx]->bytes_written = 0;
     }
     //If row overflow then scrolls up
-    if (three_terminals[terminal_idx].row_index >= NUM_ROWS - STATUS_BAR_HEIGHT) {
-        terminal_scroll();
+    if (terminals[terminal_idx]->row_index >= NUM_ROWS - STATUS_BAR_HEIGHT) {
+        terminal_scroll(terminal_idx);
     }
 
     //Updates history buffer with new written text
-    three_terminals[terminal_idx].history_buffer[three_terminals[terminal_idx].row_index][three_terminals[terminal_idx].bytes_written] = parser_buffer[0];
+    terminals[terminal_idx]->history_buffer[terminals[terminal_idx]->row_index][terminals[terminal_idx]->bytes_written] = parser_buffer[0];
     //Prints the text
     putc_multi(parser_buffer[0], (uint8_t * ) addr, terminal_idx);
 
@@ -214,9 +228,10 @@ int32_t terminal_write(int fd,
 
     int idx;
     int buf_idx;
-    uint8_t terminal_idx = all_process[current_process_pid].active_terminal_idx;
+    uint8_t terminal_idx = PCB[current_process_pid]->terminal_idx;
     unsigned char buffer_to_parse[4];
     char * ptr = (char * ) char_buffer;
+    uint32_t flags;
 
     //Validating input parameters
     if (ptr == NULL || n < 0)
@@ -228,47 +243,73 @@ int32_t terminal_write(int fd,
     buffer_to_parse[2] = '0'; //Backspace is not pressed so default to 0
     buffer_to_parse[3] = '0'; //Tab is not pressed so default to 0
 
-    cli();
+    // terminal_lock is only held a chunk at a time, the mutex keeps the whole buffer together
+    mutex_lock(&terminals[terminal_idx]->write_mutex);
+    spin_lock_irqsave(&terminal_lock, flags);
     //Updating writing position
     for (idx = 0; idx < n; idx++) {
         //Writing char
         buffer_to_parse[0] = ptr[idx];
         write_parser(buffer_to_parse);
         //0 Because checking if first char on new line
-        if (three_terminals[terminal_idx].bytes_written % NUM_COLS == 0) {
+        if (terminals[terminal_idx]->bytes_written % NUM_COLS == 0) {
             for (buf_idx = 0; buf_idx < CHAR_BUFFER_SIZE; buf_idx++) {
-                three_terminals[terminal_idx].live_buffer[buf_idx] = '\0';
+                terminals[terminal_idx]->live_buffer[buf_idx] = '\0';
             }
-            three_terminals[terminal_idx].live_buffer[0] = ptr[idx];
+            terminals[terminal_idx]->live_buffer[0] = ptr[idx];
         } else {
-            three_terminals[terminal_idx].live_buffer[three_terminals[terminal_idx].bytes_written] = ptr[idx];
+            terminals[terminal_idx]->live_buffer[terminals[terminal_idx]->bytes_written] = ptr[idx];
         }
         //If enter is pressed then we want to skip to new line
         if (buffer_to_parse[0] == '\n') {
-            three_terminals[terminal_idx].bytes_written = 0;
+            terminals[terminal_idx]->bytes_written = 0;
             //1 is Added because we want to go to new line
-            three_terminals[terminal_idx].cursor_loc = ((three_terminals[terminal_idx].cursor_loc / NUM_COLS) + 1) * NUM_COLS;
-            three_terminals[terminal_idx].row_index++;
+            terminals[terminal_idx]->cursor_loc = ((terminals[terminal_idx]->cursor_loc / NUM_COLS) + 1) * NUM_COLS;
+            terminals[terminal_idx]->row_index++;
             for (buf_idx = 0; buf_idx < CHAR_BUFFER_SIZE; buf_idx++) {
-                three_terminals[terminal_idx].live_buffer[buf_idx] = '\0';
+                terminals[terminal_idx]->live_buffer[buf_idx] = '\0';
             }
         } else {
-            three_terminals[terminal_idx].bytes_written++;
-            three_terminals[terminal_idx].cursor_loc += 1;
+            terminals[terminal_idx]->bytes_written++;
+            terminals[terminal_idx]->cursor_loc += 1;
+        }
+        //Let the keyboard, mouse and RTC in between chunks instead of once per buffer
+        if ((idx + 1) % TERMINAL_WRITE_CHUNK == 0) {
+            spin_unlock_irqrestore(&terminal_lock, flags);
+            spin_lock_irqsave(&terminal_lock, flags);
         }
     }
 
     //Adding new line character at the end and updating variables
-    three_terminals[terminal_idx].live_buffer_store[0] = '\0';
-    three_terminals[terminal_idx].bytes_read_store = 0;
-    three_terminals[terminal_idx].bytes_read = (three_terminals[terminal_idx].bytes_written % NUM_COLS);
-    three_terminals[terminal_idx].bytes_written = (three_terminals[terminal_idx].bytes_written % NUM_COLS);
-    three_terminals[terminal_idx].live_buffer_location = three_terminals[terminal_idx].bytes_read;
+    terminals[terminal_idx]->live_buffer_store[0] = '\0';
+    terminals[terminal_idx]->bytes_read_store = 0;
+    terminals[terminal_idx]->bytes_read = (terminals[terminal_idx]->bytes_written % NUM_COLS);
+    terminals[terminal_idx]->bytes_written = (terminals[terminal_idx]->bytes_written % NUM_COLS);
+    terminals[terminal_idx]->live_buffer_location = terminals[terminal_idx]->bytes_read;
 
     // only move cursor if we are looking at the right screen
     if (current_term == terminal_idx) {
-        move_cursor(three_terminals[terminal_idx].cursor_loc);
+        move_cursor(terminals[terminal_idx]->cursor_loc);
     }
-    sti();
+    spin_unlock_irqrestore(&terminal_lock, flags);
+    mutex_unlock(&terminals[terminal_idx]->write_mutex);
     return n;
 }
+
+/*
+ * terminal_poll
+ * Description: Tells poll whether terminal_read would sleep
+ * Input: fd -- stdin or stdout
+ * Output: none
+ * Side effects: none, runs with sched_lock held like the check in terminal_read
+ * Return: POLLIN once new_line stored a line for the process's terminal, POLLOUT for stdout
+ */
+int32_t terminal_poll(int32_t fd) {
+    uint32_t terminal_idx = PCB[current_process_pid]->terminal_idx;
+
+    if (fd != STDIN_FD)
+        return POLLOUT;
+    if (terminals[terminal_idx]->live_buffer_store[terminals[terminal_idx]->bytes_read_store] == '\n')
+        return POLLIN;
+    return 0;
+}
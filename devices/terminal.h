@@ -15,3 +15,5 @@ int32_t terminal_close(int fd);
 int32_t terminal_read(int fd,  void *char_buffer, int bytes);
 //writes an amount of characters to terminal
 int32_t terminal_write(int fd, const void *char_buffer, int bytes);
+//POLLIN once the process's terminal has a line, output never blocks
+int32_t terminal_poll(int32_t fd);
@@ -1,21 +1,27 @@
 #include "../lib.h"
 
 #include "../i8259.h"
+#include "../interrupts/syscall_structs.h"
+#include "../scheduler/workqueue.h"
+#include "../scheduler/mutex.h"
+#include "../spinlock.h"
 
 #ifndef __TERMINAL_STRUCT_H
 #define __TERMINAL_STRUCT_H
 
 #define CHAR_BUFFER_SIZE 128
+// terminal_write lets interrupts back in after this many characters
+#define TERMINAL_WRITE_CHUNK 64
 
 #define NUM_COLS 80
 #define NUM_ROWS 25
 #define SCREEN_SIZE 2000
 #define MAX_COMMAND_STORE 20
 
-#define TERMINAL_1 0
-#define TERMINAL_2 1
-#define TERMINAL_3 2
-#define NUM_TERMINALS 3
+// one terminal per Alt+F1..F12
+#define MAX_TERMINALS 12
+// used when the boot command line doesn't ask for a count
+#define DEFAULT_NUM_TERMINALS 3
 
 // var for current displayed terminal
 int current_term;
@@ -42,10 +48,20 @@ typedef struct terminal {
     int screen_y;
 
     uint8_t read_in_progress;
+    // processes in terminal_read waiting for a line
+    wait_queue_t read_queue;
+    // rebuilds history_buffer from video memory after a scroll
+    work_t history_work;
+    // held for a whole terminal_write so two writers don't interleave their output
+    mutex_t write_mutex;
 } terminal_t;
 
-// array containing the 3 terminal structs
-terminal_t three_terminals[NUM_TERMINALS];
+// terminal structs, allocated at boot for the first num_terminals entries
+terminal_t* terminals[MAX_TERMINALS];
+// how many terminals were brought up at boot
+extern uint8_t num_terminals;
+// guards the terminal buffers and screens between terminal_read/write and the keyboard
+extern spinlock_t terminal_lock;
 
 
 #endif
@@ -23,10 +23,13 @@ int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes) {
  * Side Effects: Overwrites the given buffer.
  */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
-    file_array_t * fda = &PCB[current_process_pid]->file[fd];
+    file_array_t * fda = &current_files[fd];
 
     dentry_t dentry;
+    // create_new_file can be adding a dentry
+    mutex_lock(&fs_mutex);
     int status = read_dentry_by_index(fda->file_position, &dentry);
+    mutex_unlock(&fs_mutex);
     if(status != 0) {
         fda->file_position++;
         return 0;
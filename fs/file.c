@@ -13,9 +13,11 @@
  * Side Effects: Modifies the file system data contents.
  */
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
-    file_array_t * fda = PCB[current_process_pid]->file;
+    file_array_t * fda = current_files;
+    mutex_lock(&fs_mutex);
     int32_t bytes_written = write_data(fda[fd].inode, fda[fd].file_position, (uint8_t *) buf, nbytes);
     fda[fd].file_position += bytes_written;
+    mutex_unlock(&fs_mutex);
     return bytes_written;
 }
 
@@ -29,10 +31,13 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
  */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
     // get right file descriptor array
-    file_array_t * fda = PCB[current_process_pid]->file;
+    file_array_t * fda = current_files;
+    // a writer can be growing the same file
+    mutex_lock(&fs_mutex);
     int32_t bytes_read = read_data(fda[fd].inode, fda[fd].file_position, (uint8_t *) buf, nbytes);
     // update file pos data
     fda[fd].file_position += bytes_read;
+    mutex_unlock(&fs_mutex);
     return bytes_read;
 }
 
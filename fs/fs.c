@@ -8,6 +8,7 @@
 
 // Global variables
 boot_block_t *fs_boot_block;
+mutex_t fs_mutex = MUTEX_INIT;
 
 /*
  * init_fs
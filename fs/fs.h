@@ -1,5 +1,6 @@
 #include "../types.h"
 #include "../lib.h"
+#include "../scheduler/mutex.h"
 
 #ifndef _FS_H
 #define _FS_H
@@ -141,4 +142,7 @@ int32_t claim_free_inode_block();
  */
 dentry_t * create_new_file(const uint8_t * fname);
 
+// guards the dentries, inodes and block bitmaps, and every open/close of a file descriptor
+extern mutex_t fs_mutex;
+
 #endif  /* _FS_H */
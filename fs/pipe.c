@@ -0,0 +1,324 @@
+#include "pipe.h"
+#include "../lib.h"
+#include "../paging/page_pool.h"
+#include "../scheduler/scheduler.h"
+#include "poll.h"
+
+static pipe_t pipes[MAX_PIPES];
+// guards used, the rest of a pipe is guarded by its own lock
+static spinlock_t pipe_table_lock = SPINLOCK_INIT;
+
+/*
+ * pipe_alloc
+ * Inputs: pages - ring buffer size in 4kB pages, a power of two
+ * Return Value: index of a new pipe with one reader and one writer, -1 if
+ *               the pipe table or the page pool ran out
+ * Side Effects: None
+ */
+int32_t pipe_alloc(uint32_t pages) {
+    uint8_t* buffer;
+    uint32_t flags;
+    int32_t idx;
+
+    // head and tail wrap around at 2^32, which only lines up with a power of two size
+    if(pages == 0 || (pages & (pages - 1)))
+        return -1;
+    buffer = (uint8_t *) page_pool_alloc(pages);
+    if(buffer == NULL)
+        return -1;
+
+    spin_lock_irqsave(&pipe_table_lock, flags);
+    for(idx = 0; idx < MAX_PIPES; idx++) {
+        if(!pipes[idx].used)
+            break;
+    }
+    if(idx == MAX_PIPES) {
+        spin_unlock_irqrestore(&pipe_table_lock, flags);
+        page_pool_free(buffer, pages);
+        return -1;
+    }
+    pipes[idx].used = 1;
+    spin_unlock_irqrestore(&pipe_table_lock, flags);
+
+    pipes[idx].buffer = buffer;
+    pipes[idx].size = pages * PG_BASE_SIZE;
+    pipes[idx].head = 0;
+    pipes[idx].tail = 0;
+    pipes[idx].readers = 1;
+    pipes[idx].writers = 1;
+    wait_queue_init(&pipes[idx].read_wait);
+    wait_queue_init(&pipes[idx].write_wait);
+    spin_lock_init(&pipes[idx].lock);
+    return idx;
+}
+
+/*
+ * pipe_get
+ * Inputs: idx - index returned by pipe_alloc
+ * Return Value: the pipe
+ */
+pipe_t* pipe_get(int32_t idx) {
+    return &pipes[idx];
+}
+
+/*
+ * pipe_release
+ * Inputs: pipe - pipe with both ends closed
+ * Return Value: None
+ * Side Effects: gives the buffer back to the page pool
+ */
+void pipe_release(pipe_t* pipe) {
+    uint32_t flags;
+
+    page_pool_free(pipe->buffer, pipe->size / PG_BASE_SIZE);
+    pipe->buffer = NULL;
+
+    spin_lock_irqsave(&pipe_table_lock, flags);
+    pipe->used = 0;
+    spin_unlock_irqrestore(&pipe_table_lock, flags);
+}
+
+/*
+ * pipe_add_end
+ * Inputs: idx - index of the pipe
+ *         writer - 1 for another write end, 0 for another read end
+ * Return Value: None
+ * Side Effects: the pipe needs one more close on that end before it goes away
+ */
+void pipe_add_end(int32_t idx, uint8_t writer) {
+    pipe_t* pipe = pipe_get(idx);
+    uint32_t flags;
+
+    spin_lock_irqsave(&pipe->lock, flags);
+    if(writer)
+        pipe->writers++;
+    else
+        pipe->readers++;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+}
+
+/*
+ * pipe_copy_in
+ * Inputs: pipe - pipe to fill
+ *         buf - bytes to append
+ *         nbytes - how many of them
+ * Return Value: bytes actually copied, at most the free space
+ * Side Effects: None, never blocks
+ */
+uint32_t pipe_copy_in(pipe_t* pipe, const uint8_t* buf, uint32_t nbytes) {
+    uint32_t space, offset, first;
+    uint32_t flags;
+
+    spin_lock_irqsave(&pipe->lock, flags);
+    space = pipe->size - (pipe->tail - pipe->head);
+    if(nbytes > space)
+        nbytes = space;
+
+    // at most two copies, up to the end of the buffer and then from its start
+    offset = pipe->tail & (pipe->size - 1);
+    first = pipe->size - offset;
+    if(first > nbytes)
+        first = nbytes;
+    memcpy(pipe->buffer + offset, buf, first);
+    memcpy(pipe->buffer, buf + first, nbytes - first);
+
+    pipe->tail += nbytes;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+    return nbytes;
+}
+
+/*
+ * pipe_copy_out
+ * Inputs: pipe - pipe to drain
+ *         buf - where to copy the oldest bytes
+ *         nbytes - most bytes to take
+ * Return Value: bytes actually copied, at most what was waiting
+ * Side Effects: None, never blocks
+ */
+uint32_t pipe_copy_out(pipe_t* pipe, uint8_t* buf, uint32_t nbytes) {
+    uint32_t waiting, offset, first;
+    uint32_t flags;
+
+    spin_lock_irqsave(&pipe->lock, flags);
+    waiting = pipe->tail - pipe->head;
+    if(nbytes > waiting)
+        nbytes = waiting;
+
+    offset = pipe->head & (pipe->size - 1);
+    first = pipe->size - offset;
+    if(first > nbytes)
+        first = nbytes;
+    memcpy(buf, pipe->buffer + offset, first);
+    memcpy(buf + first, pipe->buffer, nbytes - first);
+
+    pipe->head += nbytes;
+    spin_unlock_irqrestore(&pipe->lock, flags);
+    return nbytes;
+}
+
+/*
+ * pipe_read
+ * Inputs: fd - read end of a pipe
+ *         buf - where to put the data
+ *         nbytes - size of buf
+ * Return Value: bytes read, 0 once the pipe is empty and every write end is closed,
+ *               -1 if the fd is nonblocking and the pipe is empty
+ * Side Effects: blocks while the pipe is empty, unless the fd is nonblocking
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+    uint32_t copied;
+    uint32_t flags;
+
+    if(nbytes <= 0)
+        return 0;
+
+    do {
+        // writers wake us under sched_lock after moving tail or dropping writers
+        spin_lock_irqsave(&sched_lock, flags);
+        while(pipe->tail == pipe->head && pipe->writers > 0) {
+            // checked here and not before, another reader may drain it in between
+            if(current_files[fd].flags & FILE_NONBLOCK_FLAG) {
+                spin_unlock_irqrestore(&sched_lock, flags);
+                return -1;
+            }
+            sleep_on(&pipe->read_wait);
+        }
+        spin_unlock_irqrestore(&sched_lock, flags);
+
+        // another reader of a forked fd may have emptied it first, that isn't EOF
+        copied = pipe_copy_out(pipe, (uint8_t *) buf, nbytes);
+    } while(copied == 0 && pipe->writers > 0);
+
+    if(copied > 0) {
+        wake_up(&pipe->write_wait);
+        poll_wake();
+    }
+    return copied;
+}
+
+/*
+ * pipe_write
+ * Inputs: fd - write end of a pipe
+ *         buf - data to write
+ *         nbytes - size of buf
+ * Return Value: nbytes, or the bytes written before every read end was closed,
+ *               -1 if none could be written
+ * Side Effects: blocks while the pipe is full, unless the fd is nonblocking
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+    const uint8_t* data = (const uint8_t *) buf;
+    int32_t written = 0;
+    uint32_t flags;
+
+    while(written < nbytes) {
+        spin_lock_irqsave(&sched_lock, flags);
+        while(pipe->tail - pipe->head == pipe->size && pipe->readers > 0) {
+            // a nonblocking writer takes what fit so far rather than wait for room
+            if(current_files[fd].flags & FILE_NONBLOCK_FLAG) {
+                spin_unlock_irqrestore(&sched_lock, flags);
+                return (written > 0) ? written : -1;
+            }
+            sleep_on(&pipe->write_wait);
+        }
+        spin_unlock_irqrestore(&sched_lock, flags);
+
+        if(pipe->readers == 0)
+            return (written > 0) ? written : -1;
+
+        written += pipe_copy_in(pipe, data + written, nbytes - written);
+        wake_up(&pipe->read_wait);
+        poll_wake();
+    }
+    return written;
+}
+
+/*
+ * pipe_read_fail / pipe_write_fail
+ * The end of a pipe that isn't opened for it, always returns -1
+ */
+int32_t pipe_read_fail(int32_t fd, void* buf, int32_t nbytes) {
+    return -1;
+}
+
+int32_t pipe_write_fail(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/*
+ * pipe_open
+ * Pipes are made by the pipe syscall, not opened by name.
+ * Return Value: Should always return -1 (failure).
+ */
+int32_t pipe_open(const uint8_t* filename) {
+    return -1;
+}
+
+/*
+ * pipe_close
+ * Inputs: pipe - pipe one end of which is being closed
+ *         count - readers or writers of it
+ *         other_side - who to tell, they may be waiting for an end that is gone now
+ * Return Value: 0
+ * Side Effects: frees the pipe once both ends are closed
+ */
+static int32_t pipe_close(pipe_t* pipe, volatile uint32_t* count, wait_queue_t* other_side) {
+    uint32_t last;
+    uint32_t flags;
+
+    spin_lock_irqsave(&pipe->lock, flags);
+    (*count)--;
+    last = (pipe->readers == 0 && pipe->writers == 0);
+    spin_unlock_irqrestore(&pipe->lock, flags);
+
+    wake_up(other_side);
+    poll_wake();
+    // nobody can be asleep on a pipe without an fd on it
+    if(last)
+        pipe_release(pipe);
+    return 0;
+}
+
+/*
+ * pipe_read_close / pipe_write_close
+ * Inputs: fd - end of a pipe being closed
+ * Return Value: 0
+ * Side Effects: wakes whoever waits on the other end, frees the pipe once
+ *               both ends are closed
+ */
+int32_t pipe_read_close(int32_t fd) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+    return pipe_close(pipe, &pipe->readers, &pipe->write_wait);
+}
+
+int32_t pipe_write_close(int32_t fd) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+    return pipe_close(pipe, &pipe->writers, &pipe->read_wait);
+}
+
+/*
+ * pipe_read_poll
+ * Inputs: fd - read end of a pipe
+ * Return Value: POLLIN if a read won't block, plus POLLHUP once every write end is closed
+ */
+int32_t pipe_read_poll(int32_t fd) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+
+    if(pipe->writers == 0)
+        return POLLIN | POLLHUP;
+    return (pipe->tail != pipe->head) ? POLLIN : 0;
+}
+
+/*
+ * pipe_write_poll
+ * Inputs: fd - write end of a pipe
+ * Return Value: POLLOUT while there is room, POLLERR once every read end is closed
+ */
+int32_t pipe_write_poll(int32_t fd) {
+    pipe_t* pipe = pipe_get(current_files[fd].inode);
+
+    if(pipe->readers == 0)
+        return POLLERR;
+    return (pipe->tail - pipe->head < pipe->size) ? POLLOUT : 0;
+}
@@ -0,0 +1,138 @@
+#include "../types.h"
+#include "../spinlock.h"
+#include "../interrupts/syscall_structs.h"
+
+#ifndef _FS_PIPE_H
+#define _FS_PIPE_H
+
+// pipes that can be open at once
+#define MAX_PIPES 16
+// ring buffer size of a pipe made by the pipe syscall, in 4kB pages
+#define PIPE_DEFAULT_PAGES 1
+
+typedef struct pipe {
+    // ring buffer, size bytes from the page pool, size is a power of two
+    uint8_t* buffer;
+    uint32_t size;
+    // free running byte counts, tail - head bytes are waiting to be read
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    // open fds on each end, the pipe goes away when both reach 0
+    volatile uint32_t readers;
+    volatile uint32_t writers;
+    // readers sleep here while it's empty, writers while it's full
+    wait_queue_t read_wait;
+    wait_queue_t write_wait;
+    // guards the buffer and counts, sleeping is done under sched_lock
+    spinlock_t lock;
+    uint8_t used;
+} pipe_t;
+
+/*
+ * pipe_alloc
+ * Inputs: pages - ring buffer size in 4kB pages, a power of two
+ * Return Value: index of a new pipe with one reader and one writer, -1 if
+ *               the pipe table or the page pool ran out
+ * Side Effects: None
+ */
+int32_t pipe_alloc(uint32_t pages);
+
+/*
+ * pipe_get
+ * Inputs: idx - index returned by pipe_alloc
+ * Return Value: the pipe
+ */
+pipe_t* pipe_get(int32_t idx);
+
+/*
+ * pipe_release
+ * Inputs: pipe - pipe with both ends closed
+ * Return Value: None
+ * Side Effects: gives the buffer back to the page pool
+ */
+void pipe_release(pipe_t* pipe);
+
+/*
+ * pipe_add_end
+ * Inputs: idx - index of the pipe
+ *         writer - 1 for another write end, 0 for another read end
+ * Return Value: None
+ * Side Effects: for an fd copied by fork, which gets closed on its own
+ */
+void pipe_add_end(int32_t idx, uint8_t writer);
+
+/*
+ * pipe_copy_in
+ * Inputs: pipe - pipe to fill
+ *         buf - bytes to append
+ *         nbytes - how many of them
+ * Return Value: bytes actually copied, at most the free space
+ * Side Effects: None, never blocks
+ */
+uint32_t pipe_copy_in(pipe_t* pipe, const uint8_t* buf, uint32_t nbytes);
+
+/*
+ * pipe_copy_out
+ * Inputs: pipe - pipe to drain
+ *         buf - where to copy the oldest bytes
+ *         nbytes - most bytes to take
+ * Return Value: bytes actually copied, at most what was waiting
+ * Side Effects: None, never blocks
+ */
+uint32_t pipe_copy_out(pipe_t* pipe, uint8_t* buf, uint32_t nbytes);
+
+/*
+ * pipe_read
+ * Inputs: fd - read end of a pipe
+ *         buf - where to put the data
+ *         nbytes - size of buf
+ * Return Value: bytes read, 0 once the pipe is empty and every write end is closed
+ * Side Effects: blocks while the pipe is empty
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * pipe_write
+ * Inputs: fd - write end of a pipe
+ *         buf - data to write
+ *         nbytes - size of buf
+ * Return Value: nbytes, or the bytes written before every read end was closed,
+ *               -1 if none could be written
+ * Side Effects: blocks while the pipe is full, unless the fd is nonblocking
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+
+/*
+ * pipe_read_fail / pipe_write_fail
+ * The end of a pipe that isn't opened for it, always returns -1
+ */
+int32_t pipe_read_fail(int32_t fd, void* buf, int32_t nbytes);
+int32_t pipe_write_fail(int32_t fd, const void* buf, int32_t nbytes);
+
+/*
+ * pipe_open
+ * Pipes are made by the pipe syscall, not opened by name.
+ * Return Value: Should always return -1 (failure).
+ */
+int32_t pipe_open(const uint8_t* filename);
+
+/*
+ * pipe_read_close / pipe_write_close
+ * Inputs: fd - end of a pipe being closed
+ * Return Value: 0
+ * Side Effects: wakes whoever waits on the other end, frees the pipe once
+ *               both ends are closed
+ */
+int32_t pipe_read_close(int32_t fd);
+int32_t pipe_write_close(int32_t fd);
+
+/*
+ * pipe_read_poll / pipe_write_poll
+ * Inputs: fd - end of a pipe
+ * Return Value: POLLIN once there is data or no writer is left, POLLOUT while
+ *               there is room, POLLHUP/POLLERR once the other end is gone
+ */
+int32_t pipe_read_poll(int32_t fd);
+int32_t pipe_write_poll(int32_t fd);
+
+#endif /* _FS_PIPE_H */
@@ -0,0 +1,149 @@
+#include "poll.h"
+#include "../lib.h"
+#include "../apic.h"
+#include "../scheduler/scheduler.h"
+
+#define MS_IN_SECOND 1000
+// longest wait in ticks, deadlines are compared by the sign of their difference
+#define POLL_MAX_TICKS 0x7FFFFFFF
+
+// every process in poll_files sleeps here, whatever it waits on
+static wait_queue_t poll_wait;
+// earliest tick one of them wants to be woken at, if any of them has a timeout,
+// both guarded by sched_lock
+static uint32_t poll_deadline;
+static uint8_t poll_deadline_set = 0;
+
+/*
+ * poll_ms_to_ticks
+ * Inputs: timeout_ms - positive timeout of a poll
+ * Return Value: ticks to wait, rounded up so we never come back early and
+ *               clamped to POLL_MAX_TICKS
+ */
+static uint32_t poll_ms_to_ticks(int32_t timeout_ms) {
+    uint32_t seconds = (uint32_t) timeout_ms / MS_IN_SECOND;
+    uint32_t rest = (uint32_t) timeout_ms % MS_IN_SECOND;
+
+    // whole seconds first, timeout_ms * LAPIC_TIMER_HZ alone overflows after about 6 hours
+    if(seconds >= POLL_MAX_TICKS / LAPIC_TIMER_HZ)
+        return POLL_MAX_TICKS;
+    return seconds * LAPIC_TIMER_HZ + (rest * LAPIC_TIMER_HZ + MS_IN_SECOND - 1) / MS_IN_SECOND;
+}
+
+/*
+ * poll_fd
+ * Inputs: pfd - one entry of a poll, sched_lock held
+ * Return Value: revents of the entry
+ * Driver callbacks run with sched_lock held and interrupts off, so they only
+ * look at their state and never sleep or take a lock
+ */
+static uint16_t poll_fd(pollfd_t* pfd) {
+    file_array_t* file;
+
+    if(pfd->fd < 0 || pfd->fd >= FILE_DESCRIPTOR_SIZE)
+        return POLLNVAL;
+    file = &current_files[pfd->fd];
+    if(!(file->flags & PRESENT_BITMASK) || file->operation_table.poll == NULL)
+        return POLLNVAL;
+    // errors and hang ups are reported whether they were asked for or not
+    return file->operation_table.poll(pfd->fd) & (pfd->events | POLLERR | POLLHUP);
+}
+
+/*
+ * poll_files
+ * Inputs: fds - kernel copy of the caller's pollfds, revents gets filled in
+ *         nfds - entries in fds, at most POLL_MAX_FDS
+ *         timeout_ms - how long to wait, 0 to just look, POLL_FOREVER for no limit
+ * Return Value: number of entries with revents set, 0 if the timeout ran out
+ * Side Effects: sleeps until a driver calls poll_wake or the timeout runs out.
+ * Drivers change their state before calling poll_wake, which takes sched_lock,
+ * so checking every fd under sched_lock right before sleeping can't miss one.
+ * Time is measured as ticks since the start, which keeps working when the
+ * tick count wraps
+ */
+int32_t poll_files(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms) {
+    uint32_t start;
+    uint32_t timeout = 0;
+    uint32_t ready;
+    uint32_t flags;
+    uint32_t i;
+
+    if(timeout_ms > 0)
+        timeout = poll_ms_to_ticks(timeout_ms);
+
+    spin_lock_irqsave(&sched_lock, flags);
+    start = cpus[0].ticks;
+
+    while(1) {
+        ready = 0;
+        for(i = 0; i < nfds; i++) {
+            fds[i].revents = poll_fd(&fds[i]);
+            if(fds[i].revents != 0)
+                ready++;
+        }
+        if(ready > 0 || timeout_ms == 0 || (timeout_ms > 0 && cpus[0].ticks - start >= timeout))
+            break;
+
+        if(timeout_ms > 0 && (!poll_deadline_set || (int32_t) (start + timeout - poll_deadline) < 0)) {
+            poll_deadline = start + timeout;
+            poll_deadline_set = 1;
+        }
+        sleep_on(&poll_wait);
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return ready;
+}
+
+/*
+ * poll_ready
+ * Inputs: fd - fd of the current process
+ *         events - events to look for
+ * Return Value: which of events the fd has right now, without waiting
+ */
+uint16_t poll_ready(int32_t fd, uint16_t events) {
+    pollfd_t pfd;
+    uint32_t flags;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    spin_lock_irqsave(&sched_lock, flags);
+    pfd.revents = poll_fd(&pfd);
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return pfd.revents;
+}
+
+/*
+ * poll_wake
+ * Wakes every process sleeping in poll_files so it looks at its fds again
+ * The queue is only looked at under sched_lock, a poller that has checked its
+ * fds but not yet gone to sleep would otherwise miss this wakeup
+ */
+void poll_wake() {
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    if(poll_wait.head != NULL)
+        wake_up_locked(&poll_wait);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * poll_tick_locked
+ * Inputs: ticks - the boot processor's tick count
+ * Whoever is still waiting puts its own deadline back before sleeping again
+ */
+void poll_tick_locked(uint32_t ticks) {
+    if(!poll_deadline_set || (int32_t) (ticks - poll_deadline) < 0)
+        return;
+    poll_deadline_set = 0;
+    if(poll_wait.head != NULL)
+        wake_up_locked(&poll_wait);
+}
+
+/*
+ * poll_always_ready
+ * Return Value: POLLIN | POLLOUT, files and directories are read from memory
+ */
+int32_t poll_always_ready(int32_t fd) {
+    return POLLIN | POLLOUT;
+}
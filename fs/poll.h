@@ -0,0 +1,72 @@
+#include "../types.h"
+#include "../interrupts/syscall_structs.h"
+
+#ifndef _FS_POLL_H
+#define _FS_POLL_H
+
+// events a pollfd asks for and gets back
+#define POLLIN   0x01   // read won't block
+#define POLLOUT  0x04   // write won't block
+#define POLLERR  0x08
+#define POLLHUP  0x10   // the other end of a pipe is gone
+#define POLLNVAL 0x20   // fd isn't open
+
+// most fds one poll call looks at
+#define POLL_MAX_FDS FILE_DESCRIPTOR_SIZE
+// a poll_files timeout that never runs out
+#define POLL_FOREVER -1
+
+// fcntl commands and the flag they get and set, per fd
+#define F_GETFL 3
+#define F_SETFL 4
+#define O_NONBLOCK 0x800
+// where O_NONBLOCK lives in file_array_t flags, bit 1 already marks rtc fds
+#define FILE_NONBLOCK_FLAG 0x4
+
+typedef struct pollfd {
+    int32_t fd;
+    uint16_t events;
+    uint16_t revents;
+} pollfd_t;
+
+/*
+ * poll_files
+ * Inputs: fds - kernel copy of the caller's pollfds, revents gets filled in
+ *         nfds - entries in fds, at most POLL_MAX_FDS
+ *         timeout_ms - how long to wait for any of them, 0 to just look,
+ *                      POLL_FOREVER to wait as long as it takes
+ * Return Value: number of entries with revents set, 0 if the timeout ran out
+ * Side Effects: sleeps until a driver calls poll_wake or the timeout runs out
+ */
+int32_t poll_files(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+
+/*
+ * poll_ready
+ * Inputs: fd - fd of the current process
+ *         events - events to look for
+ * Return Value: which of events (and POLLERR/POLLHUP/POLLNVAL) the fd has right now
+ */
+uint16_t poll_ready(int32_t fd, uint16_t events);
+
+/*
+ * poll_wake
+ * Drivers call this whenever one of their fds may have become ready, every
+ * process sleeping in poll_files then looks at its fds again. Cheap when
+ * nobody polls, so it is fine to call from interrupt handlers
+ */
+void poll_wake();
+
+/*
+ * poll_tick_locked
+ * Inputs: ticks - the boot processor's tick count
+ * Wakes the pollers once the earliest of their timeouts ran out, sched_lock held
+ */
+void poll_tick_locked(uint32_t ticks);
+
+/*
+ * poll_always_ready
+ * poll callback of regular files and directories, which never block
+ */
+int32_t poll_always_ready(int32_t fd);
+
+#endif /* _FS_POLL_H */
@@ -3,6 +3,7 @@
  */
 
 #include "i8259.h"
+#include "apic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask = FULL_MASK; /* IRQs 0-7  */
@@ -38,6 +39,11 @@ void i8259_init(void) {
 
 /* Enable (unmask) the specified IRQ */
 void enable_irq(uint32_t irq_num) {
+    // the PICs are masked for good once the I/O APIC takes over
+    if(apic_enabled) {
+        ioapic_set_irq(irq_num, 0);
+        return;
+    }
     if(irq_num < NUM_IRQS) {
         // set bit at index irq_num
         master_mask &= ~(1 << irq_num);
@@ -53,6 +59,10 @@ void enable_irq(uint32_t irq_num) {
 
 /* Disable (mask) the specified IRQ */
 void disable_irq(uint32_t irq_num) {
+    if(apic_enabled) {
+        ioapic_set_irq(irq_num, 1);
+        return;
+    }
     if(irq_num < NUM_IRQS) {
         // clear bit at index irq_num
         master_mask |= (1 << irq_num);
@@ -69,6 +79,10 @@ void disable_irq(uint32_t irq_num) {
 
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num) {
+    if(apic_enabled) {
+        lapic_eoi();
+        return;
+    }
     if(irq_num >= NUM_IRQS) {
         // OR EOI with irq, -8 to offset slave to index 0
         outb((EOI | (irq_num - NUM_IRQS)), SLAVE_8259_PORT_CMD);
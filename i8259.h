@@ -34,6 +34,10 @@
 #define SLAVE_IRQ 2
 #define NUM_IRQS 8
 
+/* Current masks, bit set = IRQ masked */
+extern uint8_t master_mask;
+extern uint8_t slave_mask;
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
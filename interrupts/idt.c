@@ -1,5 +1,7 @@
 #include "idt.h"
 #include "syscall_structs.h"
+#include "../paging/user_mem.h"
+#include "../scheduler/fpu.h"
 
 // The following functions are function pointers that are exceptions handlers 
 
@@ -95,7 +97,13 @@ void invalid_opcode_error(){
 }
 
 void device_not_available_error(){
-	
+
+	// CR0.TS was set on the last context switch, hand the FPU to whoever is running now
+	if(fpu_is_enabled()) {
+		fpu_device_not_available();
+		return;
+	}
+
 	// halt for kernel exceptions
 	uint32_t address = get_saved_eip_addr();
 	if(address >= KERNEL_MEM_START && address <= KERNEL_MEM_END) {
@@ -184,14 +192,19 @@ void gen_protection_error(){
 	sys_halt_wrapper(HALT_EXCEPTION); 
 }
 
-void page_fault_error(){
-	
+void page_fault_error(page_fault_frame_t* frame){
+	uint32_t addr = get_page_fault_addr();
+
+	// user pages are mapped on first touch, by the process or by the kernel on its behalf
+	if(current_process_pid != NO_PID && PCB[current_process_pid]->leader->page_directory != NULL &&
+	   user_mem_fault(PCB[current_process_pid]->leader, addr, frame->error_code) == 0)
+		return;
+
 	// halt for kernel exceptions
-	uint32_t address = get_saved_eip_addr();
+	uint32_t address = frame->eip;
 	if(address >= KERNEL_MEM_START && address <= KERNEL_MEM_END) {
         cli();
 		printf("14: Page Fault Error\n");
-		uint32_t addr = get_page_fault_addr();
 		printf("at address: %x", addr);
 		while(1);
 	}
@@ -269,6 +282,8 @@ void init_idt() { //for IDT look at "x86_desc.h"
 		idt[idx].reserved2 = 1;
 		if(idx >= PIC_INTERRUPT_START && idx <= PIC_INTERRUPT_END) 
 			idt[idx].reserved3 = 0; 
+		else if(idx == LAPIC_TIMER_VECTOR || idx == RESCHED_VECTOR || idx == SPURIOUS_VECTOR)
+			idt[idx].reserved3 = 0; 
 		else 
 			idt[idx].reserved3 = 1;
 
@@ -312,6 +327,9 @@ void init_idt() { //for IDT look at "x86_desc.h"
 	SET_IDT_ENTRY(idt[KEYBOARD], irq_keyboard);
 	SET_IDT_ENTRY(idt[RTC], irq_rtc); 
 	SET_IDT_ENTRY(idt[MOUSE], irq_mouse); 
+	SET_IDT_ENTRY(idt[LAPIC_TIMER_VECTOR], irq_lapic_timer);
+	SET_IDT_ENTRY(idt[RESCHED_VECTOR], irq_resched);
+	SET_IDT_ENTRY(idt[SPURIOUS_VECTOR], irq_spurious);
 	SET_IDT_ENTRY(idt[SYSCALL], irq_syscall); 
     lidt(idt_desc_ptr); //load IDT table into description pointer 
 }
@@ -68,9 +68,26 @@ void stack_segment_fault_error();
  
 void gen_protection_error(); 
 
+//what page_fault_error_wrapper leaves on the stack: pushal, then what the processor pushed
+
+typedef struct page_fault_frame {
+	uint32_t edi;
+	uint32_t esi;
+	uint32_t ebp;
+	uint32_t esp;
+	uint32_t ebx;
+	uint32_t edx;
+	uint32_t ecx;
+	uint32_t eax;
+	uint32_t error_code;
+	uint32_t eip;
+	uint32_t cs;
+	uint32_t eflags;
+} page_fault_frame_t;
+
 //any memory reference issue with accessing invalid page in memory  
 
-void page_fault_error(); 
+void page_fault_error(page_fault_frame_t* frame); 
 
 //x87 FPU floating point calculation issue 
 
@@ -5,6 +5,7 @@
 #include "../devices/rtc.h" 
 #include "../devices/pit.h"
 #include "../devices/mouse.h"
+#include "../apic.h"
 
 extern void irq_keyboard();
 
@@ -14,4 +15,10 @@ extern void irq_pit();
 
 extern void irq_mouse();
 
+extern void irq_lapic_timer();
+
+extern void irq_resched();
+
+extern void irq_spurious();
+
 #endif
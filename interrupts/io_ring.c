@@ -0,0 +1,55 @@
+#include "io_ring.h"
+#include "syscalls.h"
+
+/* int32_t io_ring_run(const io_sqe_t* sqe)
+ * Inputs: sqe - our own copy of the submission
+ * Return Value: what the matching syscall returned, -1 for an unknown op */
+static int32_t io_ring_run(const io_sqe_t* sqe) {
+    switch(sqe->op) {
+        case IO_OP_NOP:
+            return 0;
+        case IO_OP_READ:
+            return sys_read(sqe->fd, (void *) sqe->buf, sqe->nbytes);
+        case IO_OP_WRITE:
+            return sys_write(sqe->fd, (const void *) sqe->buf, sqe->nbytes);
+        case IO_OP_OPEN:
+            return sys_open((const uint8_t *) sqe->buf);
+        case IO_OP_CLOSE:
+            return sys_close(sqe->fd);
+        default:
+            return -1;
+    }
+}
+
+/* int32_t io_ring_drain(io_ring_t* ring, uint32_t to_submit)
+ * Inputs: ring - a ring the caller can read and write
+ *         to_submit - most operations to run
+ * Return Value: number of submissions consumed
+ * Stops early when sq runs dry or cq has no room left for another completion.
+ * Each submission is copied out before it runs, so the process rewriting it
+ * behind our back can't make us act on half of one and half of another */
+int32_t io_ring_drain(io_ring_t* ring, uint32_t to_submit) {
+    io_sqe_t sqe;
+    io_cqe_t* cqe;
+    uint32_t head = ring->sq_head;
+    uint32_t tail = ring->sq_tail;
+    uint32_t done = 0;
+
+    // don't look at entries before we have seen the tail that covers them
+    asm volatile ("" : : : "memory");
+
+    while(done < to_submit && head != tail && ring->cq_tail - ring->cq_head < IO_RING_ENTRIES) {
+        sqe = ring->sq[head & IO_RING_MASK];
+        head++;
+        // the slot is free for the process again once sq_head moved past it
+        ring->sq_head = head;
+
+        cqe = &ring->cq[ring->cq_tail & IO_RING_MASK];
+        cqe->user_data = sqe.user_data;
+        cqe->result = io_ring_run(&sqe);
+        asm volatile ("" : : : "memory");
+        ring->cq_tail++;
+        done++;
+    }
+    return done;
+}
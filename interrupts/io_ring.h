@@ -0,0 +1,62 @@
+/** io_ring.h - batched read/write/open/close through shared rings
+ *
+ *  A process lays out an io_ring_t anywhere in its own memory and registers
+ *  it with ring_setup. From then on it queues operations by filling sq[]
+ *  and moving sq_tail, and one ring_enter runs everything queued so far,
+ *  posting a completion with the operation's user_data and return value for
+ *  each one in cq[]. The process consumes completions by moving cq_head.
+ *  Head and tail only ever grow, an index into a ring is taken mod
+ *  IO_RING_ENTRIES. Every operation behaves exactly like its syscall, so a
+ *  read from the keyboard still blocks ring_enter until a line comes in.
+ */
+
+#ifndef _IO_RING_H
+#define _IO_RING_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// entries in each ring, a power of two
+#define IO_RING_ENTRIES 64
+#define IO_RING_MASK (IO_RING_ENTRIES - 1)
+
+// operations a submission can ask for
+#define IO_OP_NOP   0
+#define IO_OP_READ  1
+#define IO_OP_WRITE 2
+#define IO_OP_OPEN  3   // buf is the file name, fd and nbytes are unused
+#define IO_OP_CLOSE 4   // buf and nbytes are unused
+
+typedef struct io_sqe {
+    uint32_t op;
+    int32_t fd;
+    uint32_t buf;
+    int32_t nbytes;
+    // handed back untouched in the completion
+    uint32_t user_data;
+} io_sqe_t;
+
+typedef struct io_cqe {
+    uint32_t user_data;
+    // what the syscall would have returned
+    int32_t result;
+} io_cqe_t;
+
+typedef struct io_ring {
+    // the process moves sq_tail as it queues, the kernel sq_head as it runs them
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    // the kernel moves cq_tail as it completes, the process cq_head as it reads them
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    io_sqe_t sq[IO_RING_ENTRIES];
+    io_cqe_t cq[IO_RING_ENTRIES];
+} io_ring_t;
+
+/* runs up to to_submit queued operations, returns how many were taken off sq */
+extern int32_t io_ring_drain(io_ring_t* ring, uint32_t to_submit);
+
+#endif /* ASM */
+
+#endif /* _IO_RING_H */
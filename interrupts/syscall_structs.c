@@ -1,8 +1,102 @@
 #include "syscall_structs.h"
+#include "../spinlock.h"
 
 // initialize global variables
-uint8_t current_process_pid = 0;
 PCB_BLOCK_t* PCB[MAX_PROCESSES];
+uint8_t process_table_size = 0;
+
+// free pids form a singly linked list threaded through this array
+static uint8_t pid_free_next[MAX_PROCESSES];
+static uint8_t pid_free_head = NO_PID;
+// pids are handed out on every processor
+static spinlock_t pid_lock = SPINLOCK_INIT;
+
+/*
+ * pid_allocator_init
+ * Description: Puts pids 0..num_pids-1 on the free list, lowest pid first so the
+ *              terminals' root shells still come up as pids 0, 1, 2
+ * Inputs: num_pids -- size of the process table
+ * Return Value: None
+ */
+void pid_allocator_init(uint8_t num_pids) {
+	int idx;
+	if(num_pids > MAX_PROCESSES)
+		num_pids = MAX_PROCESSES;
+	process_table_size = num_pids;
+	for(idx = 0; idx < num_pids; idx++) {
+		pid_free_next[idx] = (idx + 1 < num_pids) ? idx + 1 : NO_PID;
+		PCB[idx] = NULL;
+	}
+	pid_free_head = (num_pids > 0) ? 0 : NO_PID;
+}
+
+/*
+ * pid_alloc
+ * Description: Takes the pid at the head of the free list
+ * Inputs: None
+ * Return Value: a free pid, or NO_PID if every slot is taken
+ */
+uint8_t pid_alloc() {
+	uint8_t pid;
+	uint32_t flags;
+	spin_lock_irqsave(&pid_lock, flags);
+	pid = pid_free_head;
+	if(pid != NO_PID)
+		pid_free_head = pid_free_next[pid];
+	spin_unlock_irqrestore(&pid_lock, flags);
+	return pid;
+}
+
+/*
+ * pid_release
+ * Description: Returns pid to the head of the free list
+ * Inputs: pid -- pid to free
+ * Return Value: None
+ */
+void pid_release(uint8_t pid) {
+	uint32_t flags;
+	if(pid >= process_table_size)
+		return;
+	spin_lock_irqsave(&pid_lock, flags);
+	pid_free_next[pid] = pid_free_head;
+	pid_free_head = pid;
+	spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/*
+ * process_link_child
+ * Description: Adds child to the front of parent's list of children
+ * Inputs: parent, child -- PCBs to link
+ * Return Value: None
+ */
+void process_link_child(PCB_BLOCK_t* parent, PCB_BLOCK_t* child) {
+	child->parent = parent;
+	child->first_child = NULL;
+	child->next_sibling = NULL;
+	if(parent == NULL)
+		return;
+	child->next_sibling = parent->first_child;
+	parent->first_child = child;
+}
+
+/*
+ * process_unlink_child
+ * Description: Removes child from its parent's list of children
+ * Inputs: child -- PCB to unlink
+ * Return Value: None
+ */
+void process_unlink_child(PCB_BLOCK_t* child) {
+	PCB_BLOCK_t** link;
+	if(child->parent == NULL)
+		return;
+	for(link = &child->parent->first_child; *link != NULL; link = &(*link)->next_sibling) {
+		if(*link == child) {
+			*link = child->next_sibling;
+			break;
+		}
+	}
+	child->next_sibling = NULL;
+}
 
 /*
  * get_current_ebp
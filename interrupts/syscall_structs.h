@@ -1,9 +1,14 @@
 #include "../types.h"
+#include "../scheduler/smp.h"
+#include "../scheduler/fpu.h"
+#include "../spinlock.h"
 
 #ifndef __SYSCALL_STRUCT_H
 #define __SYSCALL_STRUCT_H
 
-#define MAX_PROCESSES 6
+// upper bound on the process table, the real size depends on how much memory we have
+#define MAX_PROCESSES 64
+#define NO_PID 0xFF
 #define DISABLE_LAST_BIT_MASK 0xFFFFFFFE
 
 // Number of characters the terminal supports + null-terminator 
@@ -26,6 +31,8 @@ typedef struct {
     int32_t (*close) (int32_t); 
     int32_t (*read) (int, void*, int); 
     int32_t (*write) (int, const void*, int);
+    // POLLIN/POLLOUT/... for the fd right now, see fs/poll.h
+    int32_t (*poll) (int32_t);
 } driver_t; 
 
 // struct for file descriptor entry
@@ -37,23 +44,144 @@ typedef struct {
     int32_t flags;
 } file_array_t; 
 
+// process states
+#define PROCESS_UNUSED   0
+#define PROCESS_RUNNABLE 1
+#define PROCESS_BLOCKED  2
+#define PROCESS_ZOMBIE   3
+
+// PCB flags
+#define PROCESS_FLAG_ROOT    0x1   // terminal's root shell, respawned when it halts
+#define PROCESS_FLAG_KTHREAD 0x2   // kernel thread, has no user page or files
+#define PROCESS_FLAG_THREAD  0x4   // user thread, runs in its leader's user page with its files
+
+struct PCB_BLOCK_t;
+
+// processes sleeping on some event, linked through wait_next
+typedef struct {
+    struct PCB_BLOCK_t* head;
+    struct PCB_BLOCK_t* tail;
+} wait_queue_t;
+
+// per processor counters handed out by the sched_stats syscall
+typedef struct sched_stats {
+    uint32_t online;
+    uint32_t ticks;
+    uint32_t idle_ticks;
+    uint32_t run_queue_length;
+    uint32_t steals;
+    uint32_t migrations_in;
+    uint32_t migrations_out;
+} sched_stats_t;
+
+// what irq_syscall leaves at the top of the kernel stack, lowest address first
+typedef struct syscall_frame {
+    uint32_t ds;
+    uint32_t es;
+    uint32_t eflags;
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t ecx;
+    uint32_t ebp;
+    // pushed by the processor on int $0x80
+    uint32_t user_eip;
+    uint32_t user_cs;
+    uint32_t user_eflags;
+    uint32_t user_esp;
+    uint32_t user_ss;
+} syscall_frame_t;
+
 // struct for PCB block
 typedef struct PCB_BLOCK_t{
-    file_array_t file[8];
-    uint8_t running;  
-    uint32_t esp; 
-    uint32_t ebp;
+    // FILE_DESCRIPTOR_SIZE entries from file_table_cache, threads use their leader's
+    file_array_t* file;
+    uint8_t state;
     uint8_t pid; 
     uint8_t flags;
+    // status handed to the parent by waitpid
+    int32_t exit_status;
+    // kernel esp saved by context_switch while the process isn't running
+    uint32_t context_esp;
     uint8_t args[ARG_BUF_SIZE]; 
     uint8_t cmd_name[ARG_BUF_SIZE];
 
+    // PCB_KERNEL_STACK_PAGES pages from the page pool, and where esp starts in them
+    void* kernel_stack;
+    uint32_t kernel_stack_top;
+    // terminal this process (and all of its children) run on
+    uint8_t terminal_idx;
+    // process whose user page and file table we use, ourselves unless we are a thread
+    struct PCB_BLOCK_t* leader;
+    // threads still running in our user page, only counted on the leader
+    uint32_t thread_count;
+    // end of the heap, see paging/user_mem.h. Only kept on the leader
+    uint32_t brk;
+    // 4kB frames mapped in the user page tables, only counted on the leader
+    uint32_t resident_pages;
+    // bit i set while shared memory segment i is attached, only kept on the leader
+    uint32_t shm_attached;
+    // guards the leader's user page tables, brk and resident_pages
+    spinlock_t mm_lock;
+    // address space of the leader and its threads, NULL for kernel threads
+    uint32_t* page_directory;
+    // page table behind the vidmap page, its entry follows whether our terminal is on screen
+    uint32_t* page_table_vid;
+
+    // processor whose run queue this process is on, NO_CPU until it is first queued
+    uint8_t cpu;
+    // that processor's tick count when we were last switched out, for cache affinity
+    uint32_t last_ran;
+
     struct PCB_BLOCK_t* parent;
+    struct PCB_BLOCK_t* first_child;
+    struct PCB_BLOCK_t* next_sibling;
+
+    // next process in the run queue or in the wait queue we sleep on
+    struct PCB_BLOCK_t* run_next;
+    struct PCB_BLOCK_t* wait_next;
+    // where the parent sleeps in waitpid
+    wait_queue_t child_wait;
+    // word we sleep on in futex_wait: our leader and its user address, or no
+    // owner and its physical address for a shared memory word
+    struct PCB_BLOCK_t* futex_owner;
+    uint32_t futex_key;
+    // rings registered with ring_setup, in our user memory, NULL for none
+    struct io_ring* io_ring;
+
+    // has this process touched the FPU since it was created
+    uint8_t fpu_used;
+    // saved x87/SSE registers, only valid while another process owns the FPU
+    uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
 } PCB_BLOCK_t; 
 
+// process we are running in, NO_PID on an idle processor. Syscalls run with interrupts
+// on and may move to another processor at any point, so this_cpu()->current_pid is
+// only safe to read with interrupts off
+#define current_process_pid (this_cpu_pid())
+// file table of the running process, shared by all of its threads
+#define current_files (PCB[current_process_pid]->leader->file)
+
 // global variables
-extern uint8_t current_process_pid;
 extern PCB_BLOCK_t* PCB[MAX_PROCESSES];
+// how many entries of PCB[] can actually be used
+extern uint8_t process_table_size;
+
+// sets up the pid free list for num_pids processes
+extern void pid_allocator_init(uint8_t num_pids);
+
+// pops a free pid in O(1), NO_PID if the table is full
+extern uint8_t pid_alloc();
+
+// pushes pid back on the free list in O(1)
+extern void pid_release(uint8_t pid);
+
+// links child under parent's children
+extern void process_link_child(PCB_BLOCK_t* parent, PCB_BLOCK_t* child);
+
+// removes child from its parent's children
+extern void process_unlink_child(PCB_BLOCK_t* child);
 
 // func for getting ebp
 extern uint32_t get_current_ebp();
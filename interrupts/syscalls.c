@@ -3,365 +3,1080 @@
 // .ELF header
 int8_t executable_magic_numbers[FILE_HEADER_SIZE] = {0x7F, 0x45, 0x4C, 0x46};
 
-static int32_t error_return_value = FLAG_UNSET;
-
 // file op tables
 driver_t terminal;
 driver_t rtc;
 driver_t files;
 driver_t directories;
 driver_t mouse;
+driver_t pipe_reader;
+driver_t pipe_writer;
+
+// PCBs and the file tables of leaders
+static kmem_cache_t pcb_cache;
+static kmem_cache_t file_table_cache;
 
 /* init_PCBs
  * 
- * Description: initializes PCBs, creates one at the top of each possible processes kernel stack, 
- * and stores pointers in an array. It also setups the file operation tables
+ * Description: sets up the pid allocator, the PCB and file table caches and the file operation
+ * tables. PCBs and file tables come from their caches, kernel stacks from the page pool and
+ * user pages from the frame allocator as processes are created, so how many can run is only
+ * limited by memory
  * Inputs: None
  * Outputs: None
- * Side Effects: writes to kernel memory
+ * Side Effects: None
  */
 void init_PCBs() {
-    int idx;
-    for(idx = 0; idx < MAX_PROCESSES; idx++) {
-        PCB[idx] = (PCB_BLOCK_t *) (PCB_KERNEL_PHYSICAL_ADDRESS - PCB_KERNEL_PHYSICAL_OFFSET - (idx * PCB_KERNEL_PHYSICAL_OFFSET));
-		PCB[idx]->running = 0;
-    }
+	pid_allocator_init(MAX_PROCESSES);
+	kmem_cache_init(&pcb_cache, "pcb", sizeof(PCB_BLOCK_t));
+	kmem_cache_init(&file_table_cache, "file_table", FILE_DESCRIPTOR_SIZE * sizeof(file_array_t));
 
 	terminal.read = &terminal_read;
 	terminal.write = &terminal_write;
+	terminal.poll = &terminal_poll;
 
 	rtc.open = &rtc_open;
 	rtc.close = &rtc_close;
 	rtc.read = &rtc_read;
 	rtc.write = &rtc_write;
+	rtc.poll = &rtc_poll;
 
 	files.open = &file_open;
 	files.close = &file_close;
 	files.read = &file_read;
 	files.write = &file_write;
+	files.poll = &poll_always_ready;
 
 	directories.open = &dir_open;
 	directories.close = &dir_close;
 	directories.read = &dir_read;
 	directories.write = &dir_write;
+	directories.poll = &poll_always_ready;
 
 	mouse.open = &mouse_open;
 	mouse.close = &mouse_close;
 	mouse.read = &mouse_read;
 	mouse.write = &mouse_write;
+	mouse.poll = &mouse_poll;
+
+	pipe_reader.open = &pipe_open;
+	pipe_reader.close = &pipe_read_close;
+	pipe_reader.read = &pipe_read;
+	pipe_reader.write = &pipe_write_fail;
+	pipe_reader.poll = &pipe_read_poll;
+
+	pipe_writer.open = &pipe_open;
+	pipe_writer.close = &pipe_write_close;
+	pipe_writer.read = &pipe_read_fail;
+	pipe_writer.write = &pipe_write;
+	pipe_writer.poll = &pipe_write_poll;
 }
 
-/* sys_halt_wrapper
+/* parse_command
  * 
- * Description: wrapper for halt syscall, takes in a 32-bit status and checks if 
- * an exception was caused and based on that, modifies a flag, and calls halt syscall with 8-bit status
- * Inputs: uint32_t status -- 32 bit status
- * Outputs: return value from halt syscall
+ * Description: splits a command into the program name and its arguments
+ * Inputs: const uint8_t* command -- command line
+ *		   uint8_t* command_name -- ARG_BUF_SIZE buffer for the program name
+ *		   uint8_t* argument_name -- ARG_BUF_SIZE buffer for the arguments
+ * Outputs: -1 if the command is empty, 0 otherwise
  * Side Effects: None
  */
-int sys_halt_wrapper(uint32_t status) {
-	if(status == HALT_EXCEPTION) {
-		error_return_value = HALT_EXCEPTION;
-		return sys_halt(0);
+static int32_t parse_command(const uint8_t* command, uint8_t* command_name, uint8_t* argument_name) {
+	if(command == NULL || command[0] == '\0') {
+		return RETURN_FAIL;
 	}
-	return sys_halt((uint8_t) status & 0xFF);
+
+	memset(command_name, '\0', ARG_BUF_SIZE);
+	memset(argument_name, '\0', ARG_BUF_SIZE);
+
+	uint8_t * trimmed_command = (uint8_t *) strtrimlead((int8_t *) command);
+	if(!trimmed_command) {
+		return RETURN_FAIL;
+	}
+
+	// Find end of first word
+	uint8_t * command_end = (uint8_t *) strchr((int8_t *) trimmed_command, ' ');
+	// command has stuff added on to end
+	if(command_end) {
+		// Copy command name to name buf
+		memcpy(command_name, trimmed_command, (uint32_t) (command_end - trimmed_command));
+		uint8_t * args = (uint8_t *) strtrimlead((int8_t *) command_end);
+		// command has arguments
+		if(args) {
+			// Copy arguments into argument buf
+			memcpy(argument_name, args, strlen((int8_t *) args));
+		}
+	} else {
+		memcpy(command_name, trimmed_command, strlen((int8_t *)trimmed_command));
+	}
+	return RETURN_PASS;
 }
 
-/* sys_halt
+/* process_alloc
  * 
- * Description: System call for halt, takes in status code, clears PCB for current process,
- * sets up parent process PCB, and makes call to execute
- * Inputs: uint8_t status -- 8 bit status
- * Outputs: return value from halt syscall
- * Side Effects: Jumps to execute system call
+ * Description: takes a pid, a PCB, a kernel stack and, unless it is a thread, a file table
+ * for a new process. Each of them has a lock of its own, and nobody looks at the PCB
+ * before it is runnable, so interrupts can stay on
+ * Inputs: uint8_t terminal_idx -- terminal the process reads and writes
+ *		   uint8_t process_flags -- PCB flags
+ * Outputs: zeroed PCB with its pid, stack, files and terminal filled in, NULL if we ran out
+ * Side Effects: None
  */
-int sys_halt(uint8_t status) {
-	// get pointer to current PCB
-	// printf("Halting from pid: %d", current_process_pid);
-	PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+PCB_BLOCK_t* process_alloc(uint8_t terminal_idx, uint8_t process_flags) {
+	uint8_t pid = pid_alloc();
+	if(pid == NO_PID) {
+		return NULL;
+	}
+
+	PCB_BLOCK_t* process = (PCB_BLOCK_t *) kmem_cache_alloc(&pcb_cache);
+	void* stack = page_pool_alloc(PCB_KERNEL_STACK_PAGES);
+	file_array_t* file = NULL;
+	if(!(process_flags & PROCESS_FLAG_THREAD))
+		file = (file_array_t *) kmem_cache_alloc(&file_table_cache);
+	if(process == NULL || stack == NULL || (file == NULL && !(process_flags & PROCESS_FLAG_THREAD))) {
+		if(process != NULL)
+			kmem_cache_free(&pcb_cache, process);
+		if(stack != NULL)
+			page_pool_free(stack, PCB_KERNEL_STACK_PAGES);
+		if(file != NULL)
+			kmem_cache_free(&file_table_cache, file);
+		pid_release(pid);
+		return NULL;
+	}
+	memset(process, 0, sizeof(PCB_BLOCK_t));
+	if(file != NULL)
+		memset(file, 0, FILE_DESCRIPTOR_SIZE * sizeof(file_array_t));
+	process->file = file;
+	process->kernel_stack = stack;
+	// subtracting 4 b/c we want the address right above the bottom of kernel stack
+	process->kernel_stack_top = (uint32_t) stack + PCB_KERNEL_PHYSICAL_OFFSET - sizeof(int);
+	process->pid = pid;
+	process->flags = process_flags;
+	process->terminal_idx = terminal_idx;
+	process->leader = process;
+	process->cpu = NO_CPU;
+	process->fpu_used = FLAG_UNSET;
+	wait_queue_init(&process->child_wait);
+	kstack_paint(process);
+	PCB[pid] = process;
+	return process;
+}
+
+/* process_setup_first_run
+ * 
+ * Description: builds the kernel stack of a new process or thread so the first switch
+ * to it irets straight into user space
+ * Inputs: PCB_BLOCK_t* process -- process that hasn't run yet
+ *		   uint32_t entry_address -- user eip to start at
+ *		   uint32_t user_esp -- user stack pointer to start with
+ * Outputs: None
+ * Side Effects: None
+ */
+void process_setup_first_run(PCB_BLOCK_t* process, uint32_t entry_address, uint32_t user_esp) {
+	// IRET context (user ds, esp, eflags, cs, eip), then what context_switch pops:
+	// the return address and ebp, ebx, esi, edi
+	uint32_t* stack = (uint32_t *) process->kernel_stack_top;
+	*(--stack) = USER_DS;
+	*(--stack) = user_esp;
+	*(--stack) = USER_EFLAGS;
+	*(--stack) = USER_CS;
+	*(--stack) = entry_address;
+	*(--stack) = (uint32_t) process_first_run;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	process->context_esp = (uint32_t) stack;
+}
+
+/* process_address_space_create
+ * 
+ * Description: gives a new leader its own page directory, with the kernel's entries, an
+ * empty page table for the program region at 0x8000000 and one for the vidmap page at 0x8400000,
+ * which also maps the read only vdata page
+ * Inputs: PCB_BLOCK_t* process -- new leader
+ * Outputs: RETURN_PASS, RETURN_FAIL if the page pool ran out. process_free cleans up either way
+ * Side Effects: None
+ */
+int32_t process_address_space_create(PCB_BLOCK_t* process) {
+	process->page_directory = page_dir_create();
+	process->page_table_vid = (uint32_t *) page_pool_alloc(1);
+	if(process->page_directory == NULL || process->page_table_vid == NULL)
+		return RETURN_FAIL;
+
+	// vidmap entry is filled in by scheduler_map_process once we know which terminal is on screen
+	memset(process->page_table_vid, 0, PG_BASE_SIZE);
+	if(vdata != NULL)
+		process->page_table_vid[VDATA_VID_ENTRY] = (uint32_t) vdata | USER_READ_ONLY_PRESENT_ENABLE;
+
+	process->page_directory[PROGRAM_IMAGE_END_ADDRESS >> BITSHIFT_PAGE_OFFSET] = (uint32_t) process->page_table_vid | USER_READ_WRITE_PRESENT_ENABLE;
+	return (user_mem_init(process) == 0) ? RETURN_PASS : RETURN_FAIL;
+}
+
+/* process_create
+ * 
+ * Description: creates a process running command and puts it on the run queue. The program
+ * is read a page at a time and copied into the new process's frames through the frame windows,
+ * so interrupts stay on while it loads and no page directory has to be switched. Its kernel stack
+ * is set up so the first switch to it irets straight into the program's entry point
+ * Inputs: const uint8_t* command -- program name and arguments
+ *		   uint8_t terminal_idx -- terminal the process reads and writes
+ *		   PCB_BLOCK_t* parent -- who can wait on it, NULL for none
+ *		   uint8_t process_flags -- PCB flags, e.g. PROCESS_FLAG_ROOT
+ * Outputs: pid of the new process, -1 on failure
+ * Side Effects: None
+ */
+int32_t process_create(const uint8_t* command, uint8_t terminal_idx, PCB_BLOCK_t* parent, uint8_t process_flags) {
+	uint8_t command_name[ARG_BUF_SIZE];
+	uint8_t argument_name[ARG_BUF_SIZE];
+
+	if(parse_command(command, command_name, argument_name) == RETURN_FAIL) {
+		return RETURN_FAIL;
+	}
 	
-	// check to see if we are halting root process
-	if(current_PCB == current_PCB->parent || !current_PCB->parent) {
-		// 31 is size of error msg
-    	sys_write(1, (void*) "Cannot halt from root process!\n", 31);
+	// held until the whole program is loaded
+	mutex_lock(&fs_mutex);
 
-		current_PCB->running = FLAG_UNSET;
-		int i;
-		for(i = FIRST_READABLE_FILE; i < FILE_DESCRIPTOR_SIZE; i++) {
-			if(current_PCB->file[i].flags & PRESENT_BITMASK) {
-				current_PCB->file[i].flags &= DISABLE_LAST_BIT_MASK;
-				current_PCB->file[i].operation_table.close(i);
-			}
+	// make sure file is executable
+	dentry_t ret;
+	int32_t status;
+	status = read_dentry_by_name((uint8_t *) command_name, &ret);
+	
+	// file exist check
+	if(status == RETURN_FAIL) {
+		mutex_unlock(&fs_mutex);
+		return RETURN_FAIL;
+	}
+
+	uint32_t file_size = get_file_size(&ret);
+	uint8_t buf[FILE_HEADER_SIZE];
+	memset(buf, '\0', FILE_HEADER_SIZE);
+	read_data(ret.inode_num, 0, buf, FILE_HEADER_SIZE);
+
+	// file executable check
+	if(strncmp(executable_magic_numbers, (int8_t* ) buf, FILE_HEADER_SIZE) != 0) {
+		mutex_unlock(&fs_mutex);
+		return RETURN_FAIL;
+	}
+
+	uint32_t flags;
+	uint32_t offset, length;
+	uint32_t entry_address = 0;
+	// the program goes through here a page at a time on its way into the child's frames
+	uint8_t* chunk = (uint8_t *) page_pool_alloc(1);
+	PCB_BLOCK_t* child = NULL;
+
+	if(chunk != NULL)
+		child = process_alloc(terminal_idx, process_flags);
+	if(child != NULL) {
+		// the image is mapped up front, bss, stack and heap come in as they are touched
+		status = RETURN_FAIL;
+		if(process_address_space_create(child) == RETURN_PASS &&
+		   user_mem_populate(child, PROGRAM_VIRTUAL_ADDRESS_START, PROGRAM_VIRTUAL_ADDRESS_START + file_size) == 0)
+			status = RETURN_PASS;
+
+		// load program into memory
+		for(offset = 0; offset < file_size && status == RETURN_PASS; offset += PG_BASE_SIZE) {
+			length = (file_size - offset < PG_BASE_SIZE) ? file_size - offset : PG_BASE_SIZE;
+			read_data(ret.inode_num, offset, chunk, length);
+			if(user_mem_write(child, PROGRAM_VIRTUAL_ADDRESS_START + offset, chunk, length) != 0)
+				status = RETURN_FAIL;
+
+			// get programs entry address stored in bytes 24-27 of executable
+			if(offset == 0)
+				entry_address = (uint32_t) chunk[ENTRY_ADDRESS_BYTE_4] << BITSHIFT_3_BYTES | (uint32_t) chunk[ENTRY_ADDRESS_BYTE_3] << BITSHIFT_2_BYTES | (uint32_t) chunk[ENTRY_ADDRESS_BYTE_2] << BITSHIFT_1_BYTES | (uint32_t) chunk[ENTRY_ADDRESS_BYTE_1];
 		}
 
-		current_process_pid = 0;
+		if(status != RETURN_PASS) {
+			spin_lock_irqsave(&sched_lock, flags);
+			process_free(child);
+			spin_unlock_irqrestore(&sched_lock, flags);
+			child = NULL;
+		}
+	}
+	mutex_unlock(&fs_mutex);
+	if(child == NULL) {
+		if(chunk != NULL)
+			page_pool_free(chunk, 1);
+		// 27 is size of error msg
+		sys_write(1, (void*)"Cannot create new process!\n", 27);
+		return RETURN_FAIL;
+	}
+	page_pool_free(chunk, 1);
+	uint8_t pid = child->pid;
+
+	// setup arguments for PCB
+	strcpy((int8_t *) child->args, (int8_t *) argument_name);
+	strcpy((int8_t *) child->cmd_name, (int8_t *) command_name);
 
-		error_return_value = status;
+	// setup file descriptor array for PCB, slots 0 and 1 are terminal driver functions
+	child->file[0].operation_table = terminal;
+	child->file[1].operation_table = terminal;
 
-		// spawn a new shell
-		sys_execute((uint8_t *) "shell");
+	child->file[0].flags |= FLAG_SET;
+	child->file[1].flags |= FLAG_SET;
+
+	uint32_t user_stack_base_ptr = PROCESS_VIRTUAL_ADDRESS_START + PROCESS_USER_PHYSICAL_OFFSET;
+	process_setup_first_run(child, entry_address, user_stack_base_ptr);
+
+	spin_lock_irqsave(&sched_lock, flags);
+	process_link_child(parent, child);
+	if(process_flags & PROCESS_FLAG_ROOT)
+		terminal_foreground_pid[terminal_idx] = pid;
+
+	child->state = PROCESS_RUNNABLE;
+	scheduler_enqueue_locked(child);
+	spin_unlock_irqrestore(&sched_lock, flags);
+	return pid;
+}
+
+/* thread_create
+ * 
+ * Description: starts a thread of the current process at entry with arg as its only
+ * argument. The thread gets its own pid, kernel stack and registers but runs in the
+ * leader's user page with the leader's files
+ * Inputs: uint32_t entry_address -- user function to run
+ *		   uint32_t stack_top -- top of the user stack the caller set aside for it
+ *		   uint32_t arg -- handed to entry
+ * Outputs: pid of the thread, -1 on failure
+ * Side Effects: writes arg and a null return address below stack_top
+ */
+int32_t thread_create(uint32_t entry_address, uint32_t stack_top, uint32_t arg) {
+	PCB_BLOCK_t* caller = PCB[current_process_pid];
+	PCB_BLOCK_t* leader = caller->leader;
+	PCB_BLOCK_t* thread;
+	// entry returning pops the null address and faults, threads end with thread_exit
+	uint32_t user_stack[THREAD_STACK_FRAME_SIZE / sizeof(uint32_t)] = {0, arg};
+	uint32_t user_esp = stack_top - THREAD_STACK_FRAME_SIZE;
+	uint32_t addr;
+	uint32_t flags;
+
+	// the stack may be lazy, swapped out or copy on write. Bring it in here, where
+	// running out of frames is an error, a fault from the kernel later would hang it
+	for(addr = user_esp; addr < stack_top; addr += sizeof(uint32_t)) {
+		if(user_mem_phys(leader, addr) == FRAME_NONE && user_mem_fault(leader, addr, PAGE_FAULT_WRITE) != 0)
+			return RETURN_FAIL;
+		if(user_mem_fault(leader, addr, PAGE_FAULT_PRESENT | PAGE_FAULT_WRITE) != 0)
+			return RETURN_FAIL;
 	}
 
-	// get link to parent PCB, shouldn't be null at this point
-	PCB_BLOCK_t* parent_PCB = current_PCB->parent;
-	// clear current PCB and close all fd
-	current_PCB->running = FLAG_UNSET;
-	int i;
-	for(i = FIRST_READABLE_FILE; i < FILE_DESCRIPTOR_SIZE; i++) {
-		if(current_PCB->file[i].flags & PRESENT_BITMASK) {
-			current_PCB->file[i].flags &= DISABLE_LAST_BIT_MASK;
-			current_PCB->file[i].operation_table.close(i);
-		}
+	thread = process_alloc(caller->terminal_idx, PROCESS_FLAG_THREAD);
+	if(thread == NULL)
+		return RETURN_FAIL;
+	thread->leader = leader;
+	strcpy((int8_t *) thread->cmd_name, (int8_t *) leader->cmd_name);
+
+	// another thread could have shrunk the heap since, that fails rather than faults
+	if(user_mem_write(leader, user_esp, (uint8_t *) user_stack, THREAD_STACK_FRAME_SIZE) != 0) {
+		spin_lock_irqsave(&sched_lock, flags);
+		process_free(thread);
+		spin_unlock_irqrestore(&sched_lock, flags);
+		return RETURN_FAIL;
 	}
+	process_setup_first_run(thread, entry_address, user_esp);
+
+	spin_lock_irqsave(&sched_lock, flags);
+	leader->thread_count++;
+	process_link_child(caller, thread);
+	thread->state = PROCESS_RUNNABLE;
+	scheduler_enqueue_locked(thread);
+	spin_unlock_irqrestore(&sched_lock, flags);
+	return thread->pid;
+}
+
+/* process_setup_fork_return
+ * 
+ * Description: builds the kernel stack of a forked child so the first switch to it
+ * returns from the parent's syscall with 0
+ * Inputs: PCB_BLOCK_t* child -- child that hasn't run yet
+ *		   PCB_BLOCK_t* parent -- process in the middle of the fork syscall
+ * Outputs: None
+ * Side Effects: None
+ */
+static void process_setup_fork_return(PCB_BLOCK_t* child, PCB_BLOCK_t* parent) {
+	// the parent came in through int $0x80, so its syscall frame sits right at the top of its stack
+	syscall_frame_t* parent_frame = (syscall_frame_t *) (parent->kernel_stack_top - sizeof(syscall_frame_t));
+	uint32_t* stack = (uint32_t *) (child->kernel_stack_top - sizeof(syscall_frame_t));
+
+	memcpy(stack, parent_frame, sizeof(syscall_frame_t));
+	*(--stack) = (uint32_t) fork_child_return;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	child->context_esp = (uint32_t) stack;
+}
+
+/* process_files_dup
+ * 
+ * Description: gives a forked child the parent's open files, the child closes its copies on its own
+ * Inputs: PCB_BLOCK_t* child -- new leader
+ *		   PCB_BLOCK_t* parent -- leader being forked
+ * Outputs: None
+ * Side Effects: pipe ends get one more fd each
+ */
+static void process_files_dup(PCB_BLOCK_t* child, PCB_BLOCK_t* parent) {
+	int32_t i;
 
+	memcpy(child->file, parent->file, FILE_DESCRIPTOR_SIZE * sizeof(file_array_t));
+	for(i = FIRST_READABLE_FILE; i < FILE_DESCRIPTOR_SIZE; i++) {
+		if(!(child->file[i].flags & PRESENT_BITMASK))
+			continue;
+		if(child->file[i].operation_table.close == pipe_reader.close)
+			pipe_add_end(child->file[i].inode, 0);
+		else if(child->file[i].operation_table.close == pipe_writer.close)
+			pipe_add_end(child->file[i].inode, 1);
+	}
+}
 
-	// we want to replace the old process_t with its parent process_t
-	// we want to avoid synchronization issues so cli, sti
+/* process_fork
+ * 
+ * Description: copies the current process. The child gets the parent's memory, files and
+ * registers, with every user page shared copy on write, so only pages one of them writes
+ * to ever get copied
+ * Inputs: None
+ * Outputs: pid of the child, -1 on failure
+ * Side Effects: write protects the parent's user pages
+ */
+int32_t process_fork() {
+	PCB_BLOCK_t* parent = PCB[current_process_pid];
+	PCB_BLOCK_t* child;
 	uint32_t flags;
+
+	// other threads could keep writing through stale TLB entries on other processors
+	if(parent->leader != parent || parent->thread_count > 0 || parent->page_directory == NULL)
+		return RETURN_FAIL;
+
 	cli_and_save(flags);
 
-	// swap paging back to parent's paging
-	uint32_t four_mb_page_start = PCB_KERNEL_PHYSICAL_ADDRESS + parent_PCB->pid * PROCESS_USER_PHYSICAL_OFFSET;
-	// page is 4MB aligned
-	uint32_t page_dir_entry = four_mb_page_start | RW_USER_PRESENT_4MB_MASK;
-	page_directory[PROCESS_VIRTUAL_ADDRESS_START >> BITSHIFT_PAGE_OFFSET] = page_dir_entry;
+	child = process_alloc(parent->terminal_idx, 0);
+	if(child != NULL) {
+		if(process_address_space_create(child) != RETURN_PASS || user_mem_fork(child, parent) != 0) {
+			spin_lock(&sched_lock);
+			process_free(child);
+			spin_unlock(&sched_lock);
+			child = NULL;
+		}
+	}
+	if(child == NULL) {
+		restore_flags(flags);
+		return RETURN_FAIL;
+	}
+
+	strcpy((int8_t *) child->args, (int8_t *) parent->args);
+	strcpy((int8_t *) child->cmd_name, (int8_t *) parent->cmd_name);
+	process_files_dup(child, parent);
+	process_setup_fork_return(child, parent);
+
+	spin_lock(&sched_lock);
+	process_link_child(parent, child);
+	child->state = PROCESS_RUNNABLE;
+	scheduler_enqueue_locked(child);
+	spin_unlock(&sched_lock);
+
+	restore_flags(flags);
+	return child->pid;
+}
+
+/* process_free
+ * 
+ * Description: gives back a zombie's pid, PCB, kernel stack and file table
+ * Inputs: PCB_BLOCK_t* process -- process to free, must not be the one running
+ * Outputs: None
+ * Side Effects: sched_lock must be held
+ */
+void process_free(PCB_BLOCK_t* process) {
+	// threads only borrow their leader's pages and page directory
+	if(process->leader == process) {
+		if(process->page_directory != NULL) {
+			shm_detach_all(process);
+			user_mem_free(process);
+			page_dir_destroy(process->page_directory);
+		}
+		if(process->page_table_vid != NULL)
+			page_pool_free(process->page_table_vid, 1);
+	}
+	process_unlink_child(process);
+	kstack_retire(process);
+	process->state = PROCESS_UNUSED;
+	PCB[process->pid] = NULL;
+	pid_release(process->pid);
+	if(process->file != NULL)
+		kmem_cache_free(&file_table_cache, process->file);
+	page_pool_free(process->kernel_stack, PCB_KERNEL_STACK_PAGES);
+	kmem_cache_free(&pcb_cache, process);
+}
 
-	// flush TLB
-	asm volatile ("movl %cr3,%eax; movl %eax,%cr3");
+/* process_exit
+ * 
+ * Description: turns the current process into a zombie for its parent to collect and
+ * switches away for good. A root shell that exits gets replaced by a fresh shell
+ * Inputs: int32_t status -- status handed to waitpid
+ * Outputs: None, never returns
+ * Side Effects: closes all files
+ */
+void process_exit(int32_t status) {
+	PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+	PCB_BLOCK_t* leader = current_PCB->leader;
+	PCB_BLOCK_t* child;
+	PCB_BLOCK_t* next;
+	uint32_t flags;
 
-	// get parents kernel stack base address
-	uint32_t parent_kernel_stack_base_address = PCB_KERNEL_PHYSICAL_ADDRESS - sizeof(int) - (parent_PCB->pid * PCB_KERNEL_PHYSICAL_OFFSET);
-	tss.esp0 = parent_kernel_stack_base_address;
+	if(current_PCB == leader) {
+		// the user page and files have to outlive every thread running in them
+		spin_lock_irqsave(&sched_lock, flags);
+		while(leader->thread_count > 0)
+			sleep_on(&leader->child_wait);
+		spin_unlock_irqrestore(&sched_lock, flags);
 
-	// modify the multiprocessing structs
-	if(current_process_pid >= MAX_MULTIPROCESS_NUM) {
-		// iterate through multi_process_idx to find the child idx and replace with parent idx
+		// close all fd
 		int i;
-		for(i = 0; i < MAX_MULTIPROCESS_NUM; i++) {
-			if(multi_process_idx[i] == current_process_pid) {
-				multi_process_idx[i] = parent_PCB->pid;
-				break;
+		for(i = FIRST_READABLE_FILE; i < FILE_DESCRIPTOR_SIZE; i++) {
+			if(current_PCB->file[i].flags & PRESENT_BITMASK) {
+				current_PCB->file[i].flags &= DISABLE_LAST_BIT_MASK;
+				current_PCB->file[i].operation_table.close(i);
 			}
 		}
 	}
 
+	// check to see if we are halting root process
+	if(current_PCB->flags & PROCESS_FLAG_ROOT) {
+		// 31 is size of error msg
+    	sys_write(1, (void*) "Cannot halt from root process!\n", 31);
+
+		// spawn a new shell on the same terminal
+		process_create((uint8_t *) "shell", current_PCB->terminal_idx, NULL, PROCESS_FLAG_ROOT);
+	}
+
 	draw_status_bar();
 
-	// set current pid to parent's pid
-	current_process_pid = parent_PCB->pid;
+	spin_lock_irqsave(&sched_lock, flags);
+
+	fpu_release(current_PCB->pid);
 
-	// jump to return in sys_execute
-	if(error_return_value != HALT_EXCEPTION) {
-		error_return_value = status;
+	if(current_PCB != leader) {
+		leader->thread_count--;
+		wake_up_locked(&leader->child_wait);
 	}
 
-	// restore our esp, ebp
-	asm ("movl %0, %%esp;\n"
-		 "movl %1, %%ebp;\n"
-		  :
-		  : "g"(current_PCB->esp), "g"(current_PCB->ebp)
-		  : "memory", "cc"
-		);
+	// our children keep running, but nobody is going to wait on them anymore
+	for(child = current_PCB->first_child; child != NULL; child = next) {
+		next = child->next_sibling;
+		child->parent = NULL;
+		child->next_sibling = NULL;
+		if(child->state == PROCESS_ZOMBIE)
+			process_free(child);
+	}
+	current_PCB->first_child = NULL;
+
+	current_PCB->exit_status = status;
+	current_PCB->state = PROCESS_ZOMBIE;
+	if(current_PCB->parent != NULL)
+		wake_up_locked(&current_PCB->parent->child_wait);
+	else
+		scheduler_reap_after_switch(current_PCB);
+
+	// zombies never get picked again
+	schedule_locked();
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
 
-	restore_flags(flags);
+/* process_wait
+ * 
+ * Description: collects a zombie child of the current process
+ * Inputs: int32_t pid -- child to wait for, WAIT_ANY for any child
+ *		   int32_t* status -- where to put its exit status, can be NULL
+ *		   int32_t options -- WNOHANG to return right away if it is still running
+ * Outputs: pid of the collected child, 0 if WNOHANG and nothing exited, -1 if no such child
+ * Side Effects: may block
+ */
+int32_t process_wait(int32_t pid, int32_t* status, int32_t options) {
+	PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+	PCB_BLOCK_t* child;
+	uint8_t found;
+	int32_t child_pid;
 
-	asm ("jmp return_from_halt");
+	uint32_t flags;
+	spin_lock_irqsave(&sched_lock, flags);
+
+	while(1) {
+		found = FLAG_UNSET;
+		for(child = current_PCB->first_child; child != NULL; child = child->next_sibling) {
+			if(pid != WAIT_ANY && child->pid != pid)
+				continue;
+			found = FLAG_SET;
+			if(child->state == PROCESS_ZOMBIE) {
+				child_pid = child->pid;
+				if(status != NULL)
+					*status = child->exit_status;
+				process_free(child);
+				spin_unlock_irqrestore(&sched_lock, flags);
+				return child_pid;
+			}
+		}
+
+		if(!found) {
+			spin_unlock_irqrestore(&sched_lock, flags);
+			return RETURN_FAIL;
+		}
+		if(options & WNOHANG) {
+			spin_unlock_irqrestore(&sched_lock, flags);
+			return RETURN_PASS;
+		}
+		sleep_on(&current_PCB->child_wait);
+	}
+}
+
+/* sys_halt_wrapper
+ * 
+ * Description: wrapper for halt syscall, takes in a 32-bit status and checks if 
+ * an exception was caused and based on that, hands the parent the full status
+ * Inputs: uint32_t status -- 32 bit status
+ * Outputs: None, never returns
+ * Side Effects: None
+ */
+int sys_halt_wrapper(uint32_t status) {
+	if(status == HALT_EXCEPTION) {
+		process_exit(HALT_EXCEPTION);
+		return RETURN_PASS;
+	}
+	return sys_halt((uint8_t) status & 0xFF);
+}
+
+/* sys_halt
+ * 
+ * Description: System call for halt, takes in status code and ends the current process.
+ * Its parent picks up the status from waitpid
+ * Inputs: uint8_t status -- 8 bit status
+ * Outputs: None, never returns
+ * Side Effects: switches to another process
+ */
+int sys_halt(uint8_t status) {
+	process_exit(status);
 	return RETURN_PASS;
 }
 
 /* sys_execute
  * 
- * Description: System call for execute, takes in char buffer for command, sets up PCB for process,
- * setups up TSS, stores registers, sets up IRET context and calls IRET
+ * Description: System call for execute, runs command in the foreground of the caller's
+ * terminal and waits for it to halt
  * Inputs: uint8_t* command - a char buffer for the command
- * Outputs: return value from halt syscall
- * Side Effects: Modifies paging, flushes TLB, calls IRET, modifies esp/ebp
+ * Outputs: status the program halted with, 256 if it died to an exception, -1 if it
+ * couldn't be started
+ * Side Effects: blocks until the child halts
  */
 int32_t sys_execute(const uint8_t* command) {
-	
-	// Reenable interrupts, as user programs should always be interruptable.
-	sti();
+	PCB_BLOCK_t* parent = PCB[current_process_pid];
+	int32_t status;
+	int32_t pid;
 
-	if(command[0] == '\0') {
+	pid = process_create(command, parent->terminal_idx, parent, 0);
+	if(pid == RETURN_FAIL) {
 		return RETURN_FAIL;
 	}
 
-	uint8_t command_name[ARG_BUF_SIZE];
-	uint8_t argument_name[ARG_BUF_SIZE];
-	memset(command_name, '\0', ARG_BUF_SIZE);
-	memset(argument_name, '\0', ARG_BUF_SIZE);
+	terminal_foreground_pid[parent->terminal_idx] = pid;
+	draw_status_bar();
 
-	uint8_t * trimmed_command = (uint8_t *) strtrimlead((int8_t *) command);
-	if(!trimmed_command) {
+	process_wait(pid, &status, 0);
+
+	terminal_foreground_pid[parent->terminal_idx] = parent->pid;
+	draw_status_bar();
+
+	return status;
+}
+
+/* sys_spawn
+ * 
+ * Description: System call for spawn, starts command in the background on the caller's
+ * terminal without waiting for it
+ * Inputs: uint8_t* command - a char buffer for the command
+ * Outputs: pid of the new process, -1 if it couldn't be started
+ * Side Effects: None
+ */
+int32_t sys_spawn(const uint8_t* command) {
+	PCB_BLOCK_t* parent = PCB[current_process_pid];
+	return process_create(command, parent->terminal_idx, parent, 0);
+}
+
+/* sys_waitpid
+ * 
+ * Description: System call for waitpid, collects a child that halted
+ * Inputs: int32_t pid -- child to wait for, -1 for any child
+ *		   int32_t* status -- where to store the child's status, can be NULL
+ *		   int32_t options -- WNOHANG to not block
+ * Outputs: pid of the child, 0 if WNOHANG and no child halted yet, -1 on failure
+ * Side Effects: may block
+ */
+int32_t sys_waitpid(int32_t pid, int32_t* status, int32_t options) {
+	int32_t child_status = 0;
+	int32_t ret;
+	uint32_t status_address = (uint32_t) status;
+
+	if(status != NULL && (status_address < PROGRAM_IMAGE_START_ADDRESS || status_address + sizeof(int32_t) > PROGRAM_IMAGE_END_ADDRESS))
 		return RETURN_FAIL;
-	}
 
-	// Find end of first word
-	uint8_t * command_end = (uint8_t *) strchr((int8_t *) trimmed_command, ' ');
-	// command has stuff added on to end
-	if(command_end) {
-		// Copy command name to name buf
-		memcpy(command_name, trimmed_command, (uint32_t) (command_end - trimmed_command));
-		uint8_t * args = (uint8_t *) strtrimlead((int8_t *) command_end);
-		// command has arguments
-		if(args) {
-			// Copy arguments into argument buf
-			memcpy(argument_name, args, strlen((int8_t *) args));
-		}
-	} else {
-		memcpy(command_name, trimmed_command, strlen((int8_t *)trimmed_command));
-	}
-	
-	// make sure file is executable
-	dentry_t ret;
-	int32_t status;
-	status = read_dentry_by_name((uint8_t *) command_name, &ret);
-	
-	// file exist check
-	if(status == RETURN_FAIL) {
+	ret = process_wait(pid, &child_status, options);
+	if(ret > 0 && status != NULL)
+		*status = child_status;
+	return ret;
+}
+
+/* sys_thread_create
+ * 
+ * Description: System call for thread_create, starts a thread sharing the caller's memory and files
+ * Inputs: void* entry -- function the thread runs, called with arg
+ *		   void* stack_top -- top of a user stack the caller set aside for the thread
+ *		   void* arg -- handed to entry
+ * Outputs: pid of the thread, -1 on failure
+ * Side Effects: None
+ */
+int32_t sys_thread_create(void* entry, void* stack_top, void* arg) {
+	uint32_t entry_address = (uint32_t) entry;
+	uint32_t stack_address = (uint32_t) stack_top;
+
+	if(entry_address < PROGRAM_IMAGE_START_ADDRESS || entry_address >= PROGRAM_IMAGE_END_ADDRESS)
+		return RETURN_FAIL;
+	// room for arg and the return address right below the top
+	if(stack_address < PROGRAM_IMAGE_START_ADDRESS + THREAD_STACK_FRAME_SIZE || stack_address > PROGRAM_IMAGE_END_ADDRESS)
 		return RETURN_FAIL;
-	}
 
-	uint32_t file_size = get_file_size(&ret);
-	uint8_t buf[FILE_HEADER_SIZE];
-	memset(buf, '\0', FILE_HEADER_SIZE);
-	read_data(ret.inode_num, 0, buf, FILE_HEADER_SIZE);
+	return thread_create(entry_address, stack_address, (uint32_t) arg);
+}
 
-	// file executable check
-	if(strncmp(executable_magic_numbers, (int8_t* ) buf, FILE_HEADER_SIZE) != 0) {
+/* sys_thread_exit
+ * 
+ * Description: System call for thread_exit, ends the calling thread. Called from the
+ * process's first thread it waits for all other threads and ends the process like halt
+ * Inputs: int32_t status -- status handed to thread_join
+ * Outputs: None, never returns
+ * Side Effects: switches to another process
+ */
+int32_t sys_thread_exit(int32_t status) {
+	process_exit(status);
+	return RETURN_PASS;
+}
+
+/* sys_thread_join
+ * 
+ * Description: System call for thread_join, waits for a thread the caller created to exit
+ * Inputs: int32_t tid -- thread to wait for
+ *		   int32_t* status -- where to store its exit status, can be NULL
+ * Outputs: tid, -1 if it isn't a thread the caller created
+ * Side Effects: may block
+ */
+int32_t sys_thread_join(int32_t tid, int32_t* status) {
+	PCB_BLOCK_t* caller = PCB[current_process_pid];
+	PCB_BLOCK_t* thread;
+	int32_t is_thread;
+	uint32_t flags;
+
+	if(tid < 0 || tid >= MAX_PROCESSES)
 		return RETURN_FAIL;
-	}
 
-	// get a pointer to parent PCB
-	PCB_BLOCK_t* parent = PCB[current_process_pid];
+	// only we reap our children, so once it checks out it stays ours until the wait
+	spin_lock_irqsave(&sched_lock, flags);
+	thread = PCB[tid];
+	is_thread = thread != NULL && (thread->flags & PROCESS_FLAG_THREAD) &&
+				thread->leader == caller->leader && thread->parent == caller;
+	spin_unlock_irqrestore(&sched_lock, flags);
+	if(!is_thread)
+		return RETURN_FAIL;
+	return sys_waitpid(tid, status, 0);
+}
 
-	// create a multiprocess struct as well
-	// we need to find the ultimate root to determine which shell the process is coming from
-	PCB_BLOCK_t* root = parent;
-	while(root->parent != NULL) 
-		root = root->parent;
-	// the terminal will be of idx root->pid
-	// TODO: map process to terminal here
-
-
-	uint8_t found_pid = FLAG_UNSET;
-	int idx = 0;
-	for(idx = 0; idx < MAX_PROCESSES; idx++) {
-		if(!PCB[idx]->running) {
-			found_pid = FLAG_SET;
-			current_process_pid = idx;
-			PCB[idx]->running = FLAG_SET;
-			PCB[idx]->pid = idx;
-			
-			// TODO: this should work fine after we get interrupts working... i think
-			// the first 3 processes are supposed to be the root shells which have no parent
-			if(idx < MAX_MULTIPROCESS_NUM) {
-				PCB[idx]->parent = NULL;
-			} else {
-				PCB[idx]->parent = parent;
-			}
+/* sys_futex
+ * 
+ * Description: System call for futex, sleeps on or wakes sleepers on a word of user memory
+ * Inputs: uint32_t* uaddr -- 4 byte aligned word in the caller's user page, heap or shared memory
+ *		   int32_t op -- FUTEX_WAIT or FUTEX_WAKE
+ *		   uint32_t val -- FUTEX_WAIT: value *uaddr must still hold to sleep,
+ *						   FUTEX_WAKE: most sleepers to wake
+ * Outputs: FUTEX_WAIT: 0 once woken, -1 if *uaddr != val. FUTEX_WAKE: number woken.
+ * -1 on a bad address or op
+ * Side Effects: FUTEX_WAIT may block
+ */
+int32_t sys_futex(uint32_t* uaddr, int32_t op, uint32_t val) {
+	uint32_t address = (uint32_t) uaddr;
 
-			// setup arguments for PCB
-			strcpy((int8_t *) PCB[idx]->args, (int8_t *) argument_name);
-			strcpy((int8_t *) PCB[idx]->cmd_name, (int8_t *) command_name);
+	if(address & (sizeof(uint32_t) - 1))
+		return RETURN_FAIL;
+	// the program region, the heap or a shared memory segment, futex_wait checks it is mapped
+	if(!(address >= PROGRAM_IMAGE_START_ADDRESS && address < PROGRAM_IMAGE_END_ADDRESS) &&
+	   !(address >= USER_HEAP_START && address < USER_SHM_END))
+		return RETURN_FAIL;
 
-			// setup file descriptor array for PCB, slots 0 and 1 are terminal driver functions
-			PCB[idx]->file[0].operation_table = terminal;
-			PCB[idx]->file[1].operation_table = terminal;
+	switch(op) {
+		case FUTEX_WAIT:
+			return futex_wait(uaddr, val);
+		case FUTEX_WAKE:
+			return futex_wake(uaddr, val);
+		default:
+			return RETURN_FAIL;
+	}
+}
 
-			PCB[idx]->file[0].flags |= FLAG_SET;
-			PCB[idx]->file[1].flags |= FLAG_SET;
+/* sys_pipe
+ * 
+ * Description: System call for pipe, makes a pipe and opens both of its ends
+ * Inputs: int32_t* fds -- fds[0] gets the read end, fds[1] the write end
+ * Outputs: return -1 for fail, 0 for success
+ * Side Effects: takes two file descriptors
+ */
+int32_t sys_pipe(int32_t* fds) {
+	uint32_t fds_address = (uint32_t) fds;
+	int32_t ends[2];
+	int32_t found = 0;
+	int32_t pipe_idx;
+	int32_t idx;
+
+	if(fds_address < PROGRAM_IMAGE_START_ADDRESS || fds_address + sizeof(ends) > PROGRAM_IMAGE_END_ADDRESS)
+		return RETURN_FAIL;
 
-			break;
-		}
+	mutex_lock(&fs_mutex);
+	for(idx = FIRST_READABLE_FILE; idx < FILE_DESCRIPTOR_SIZE && found < 2; idx++) {
+		if((current_files[idx].flags & PRESENT_BITMASK) == FLAG_UNSET)
+			ends[found++] = idx;
+	}
+	pipe_idx = (found == 2) ? pipe_alloc(PIPE_DEFAULT_PAGES) : RETURN_FAIL;
+	if(pipe_idx == RETURN_FAIL) {
+		mutex_unlock(&fs_mutex);
+		return RETURN_FAIL;
 	}
 
-	if(!found_pid) {
-		// 51 is size of error msg
-		sys_write(1, (void*)"Cannot create new process, reached maximum amount!\n", 51);
-		return RETURN_PASS;
+	for(idx = 0; idx < 2; idx++) {
+		current_files[ends[idx]].inode = pipe_idx;
+		current_files[ends[idx]].file_position = 0;
+		current_files[ends[idx]].operation_table = (idx == 0) ? pipe_reader : pipe_writer;
+		current_files[ends[idx]].flags |= FLAG_SET;  // Set present bit
 	}
+	mutex_unlock(&fs_mutex);
+	fds[0] = ends[0];
+	fds[1] = ends[1];
+	return RETURN_PASS;
+}
 
-	uint32_t flags;
-	cli_and_save(flags);
+/* sys_sbrk
+ * 
+ * Description: System call for sbrk, grows or shrinks the heap of the calling process. Threads
+ * share their leader's heap
+ * Inputs: int32_t increment -- bytes to add to the heap, negative to give some back
+ * Outputs: old end of the heap, which is where the added memory starts, -1 for fail
+ * Side Effects: added pages are zeroed and mapped the first time they are touched
+ */
+int32_t sys_sbrk(int32_t increment) {
+	return user_mem_sbrk(PCB[current_process_pid]->leader, increment);
+}
 
-	// setup paging with the process pid, mapped at virtual address 0x800000
-	uint32_t four_mb_page_start = PCB_KERNEL_PHYSICAL_ADDRESS + current_process_pid * PROCESS_USER_PHYSICAL_OFFSET;
-	// page is 4MB aligned
-	uint32_t page_dir_entry = four_mb_page_start | RW_USER_PRESENT_4MB_MASK;
-	page_directory[PROCESS_VIRTUAL_ADDRESS_START >> BITSHIFT_PAGE_OFFSET] = page_dir_entry;
+/* sys_fork
+ * 
+ * Description: System call for fork, copies the calling process
+ * Inputs: None
+ * Outputs: pid of the child in the parent, 0 in the child, -1 for fail. Processes with
+ * threads can't fork
+ * Side Effects: the child starts with its FPU registers reset
+ */
+int32_t sys_fork(void) {
+	return process_fork();
+}
 
-	// flush tlb
-	asm volatile ("movl %cr3,%eax; movl %eax,%cr3");
+/* sys_shm_get
+ * 
+ * Description: System call for shm_get, looks up the shared memory segment with key and makes
+ * it if there is none yet
+ * Inputs: int32_t key -- name the processes sharing it agree on
+ *		   uint32_t size -- bytes the segment needs, at most SHM_SEGMENT_MAX_SIZE
+ * Outputs: id of the segment, -1 for fail
+ * Side Effects: a new segment is zeroed
+ */
+int32_t sys_shm_get(int32_t key, uint32_t size) {
+	return shm_get(key, size);
+}
 
-	// load program into memory
-	uint8_t* ptr = (uint8_t * ) PROGRAM_VIRTUAL_ADDRESS_START;
-	read_data(ret.inode_num, 0, ptr, file_size);
+/* sys_shm_attach
+ * 
+ * Description: System call for shm_attach, maps a shared memory segment into the caller. Threads
+ * share their leader's attachments
+ * Inputs: int32_t id -- from shm_get
+ * Outputs: address of the segment, the same in every process, -1 for fail
+ * Side Effects: None
+ */
+int32_t sys_shm_attach(int32_t id) {
+	return shm_attach(PCB[current_process_pid]->leader, id);
+}
 
-	// get programs entry address stored in bytes 24-27 of executable
-	uint32_t entry_address = (uint32_t) ptr[ENTRY_ADDRESS_BYTE_4] << BITSHIFT_3_BYTES | (uint32_t) ptr[ENTRY_ADDRESS_BYTE_3] << BITSHIFT_2_BYTES | (uint32_t) ptr[ENTRY_ADDRESS_BYTE_2] << BITSHIFT_1_BYTES | (uint32_t) ptr[ENTRY_ADDRESS_BYTE_1];
+/* sys_shm_detach
+ * 
+ * Description: System call for shm_detach, unmaps a segment shm_attach returned
+ * Inputs: void* addr -- address shm_attach returned
+ * Outputs: return -1 for fail, 0 for success. Processes with threads can't detach,
+ * their segments stay until they exit
+ * Side Effects: frees the segment if nobody else has it attached
+ */
+int32_t sys_shm_detach(void* addr) {
+	PCB_BLOCK_t* leader = PCB[current_process_pid]->leader;
+	uint32_t address = (uint32_t) addr;
 
-	// subtracting 4 b/c we want the address right above the bottom of kernel stack
-	uint32_t kernel_stack_base_ptr = PCB_KERNEL_PHYSICAL_ADDRESS - sizeof(int) - (current_process_pid * PCB_KERNEL_PHYSICAL_OFFSET);
-	uint32_t user_stack_base_ptr = PROCESS_VIRTUAL_ADDRESS_START + PROCESS_USER_PHYSICAL_OFFSET;
+	if(address < USER_SHM_START || address >= USER_SHM_END || (address - USER_SHM_START) % SHM_SEGMENT_MAX_SIZE != 0)
+		return RETURN_FAIL;
+	// other threads could keep using the pages through stale TLB entries on other processors
+	if(leader->thread_count > 0)
+		return RETURN_FAIL;
+	return shm_detach(leader, (address - USER_SHM_START) / SHM_SEGMENT_MAX_SIZE);
+}
 
-	tss.esp0 = kernel_stack_base_ptr;
+/* sys_sched_stats
+ * 
+ * Description: System call for sched_stats, copies one processor's steal and migration counters
+ * Inputs: uint32_t cpu_idx -- index of the processor
+ *		   sched_stats_t* stats -- where to copy its counters
+ * Outputs: number of processors, -1 on failure
+ * Side Effects: None
+ */
+int32_t sys_sched_stats(uint32_t cpu_idx, sched_stats_t* stats) {
+	uint32_t stats_address = (uint32_t) stats;
 
-	// save our current esp, ebp into the PCB
-	asm ("movl %%esp, %0;\n"
-		 "movl %%ebp, %1;\n"
-		  : "=g"(PCB[current_process_pid]->esp), "=g"(PCB[current_process_pid]->ebp)
-		  :
-		  : "memory", "cc"
-		);
+	if(stats_address < PROGRAM_IMAGE_START_ADDRESS || stats_address + sizeof(sched_stats_t) > PROGRAM_IMAGE_END_ADDRESS)
+		return RETURN_FAIL;
 
-	// we only want to create new process_t for non-root shell
-	// we want to avoid synchronization issues so cli, sti
-	
-	if(current_process_pid >= MAX_MULTIPROCESS_NUM) {
-		process_t process;
-		process.PCB = PCB[current_process_pid];
-		process.active_terminal_idx = root->pid;
+	if(scheduler_get_stats(cpu_idx, stats) != 0)
+		return RETURN_FAIL;
+	return num_cpus;
+}
 
-		// iterate through multi_process_idx to find the parent idx and replace with child idx
-		int i;
-		for(i = 0; i < MAX_MULTIPROCESS_NUM; i++) {
-			if(multi_process_idx[i] == parent->pid) {
-				multi_process_idx[i] = current_process_pid;
-				break;
-			}
-		}
-		all_process[current_process_pid] = process;
+/* sys_kstack_stats
+ * 
+ * Description: System call for kstack_stats, reports how deep kernel stacks have gone
+ * Inputs: int32_t pid -- process to report on, -1 for just the boot-wide numbers
+ *		   kstack_stats_t* stats -- where to copy them
+ * Outputs: 0 on success, -1 on failure
+ * Side Effects: None
+ */
+int32_t sys_kstack_stats(int32_t pid, kstack_stats_t* stats) {
+	uint32_t stats_address = (uint32_t) stats;
+
+	if(stats_address < PROGRAM_IMAGE_START_ADDRESS || stats_address + sizeof(kstack_stats_t) > PROGRAM_IMAGE_END_ADDRESS)
+		return RETURN_FAIL;
+	if(pid < -1 || pid >= MAX_PROCESSES)
+		return RETURN_FAIL;
+
+	if(kstack_get_stats((pid == -1) ? NO_PID : (uint8_t) pid, stats) != 0)
+		return RETURN_FAIL;
+	return RETURN_PASS;
+}
+
+/* io_ring_address_ok
+ * 
+ * Description: checks that a ring lies where touching it can't fault in the kernel: in the
+ * program region, or in the heap below the current brk
+ * Inputs: PCB_BLOCK_t* leader -- leader of the calling process
+ *		   uint32_t address -- start of the ring
+ * Outputs: 1 if it does, 0 if not
+ * Side Effects: None
+ */
+static int32_t io_ring_address_ok(PCB_BLOCK_t* leader, uint32_t address) {
+	if(address >= PROGRAM_IMAGE_START_ADDRESS && address + sizeof(io_ring_t) <= PROGRAM_IMAGE_END_ADDRESS)
+		return 1;
+	return address >= USER_HEAP_START && address + sizeof(io_ring_t) <= leader->brk;
+}
+
+/* sys_ring_setup
+ * 
+ * Description: System call for ring_setup, registers the submission and completion rings
+ * ring_enter runs, see interrupts/io_ring.h. Every thread has rings of its own
+ * Inputs: io_ring_t* ring -- rings in the caller's memory, NULL to drop the current ones
+ * Outputs: 0 on success, -1 on failure
+ * Side Effects: empties both rings
+ */
+int32_t sys_ring_setup(io_ring_t* ring) {
+	PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+
+	if(ring != NULL && !io_ring_address_ok(current_PCB->leader, (uint32_t) ring))
+		return RETURN_FAIL;
+
+	current_PCB->io_ring = ring;
+	if(ring != NULL) {
+		ring->sq_head = 0;
+		ring->sq_tail = 0;
+		ring->cq_head = 0;
+		ring->cq_tail = 0;
 	}
+	return RETURN_PASS;
+}
 
-	draw_status_bar();
+/* sys_ring_enter
+ * 
+ * Description: System call for ring_enter, runs the operations queued on the caller's
+ * submission ring and posts their results on its completion ring
+ * Inputs: uint32_t to_submit -- most operations to run
+ * Outputs: number of operations run, -1 if no rings are set up
+ * Side Effects: whatever the queued operations do, may block like they would
+ */
+int32_t sys_ring_enter(uint32_t to_submit) {
+	PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+	io_ring_t* ring = current_PCB->io_ring;
 
-	restore_flags(flags);
+	// sbrk may have given back the pages the rings were in since setup
+	if(ring == NULL || !io_ring_address_ok(current_PCB->leader, (uint32_t) ring))
+		return RETURN_FAIL;
+	return io_ring_drain(ring, to_submit);
+}
 
-	// push user ds, esp, eflags, cs, eip using inline ASM and call IRET
-	asm ("pushl %2;\n"
-		 "pushl %3;\n"
-		//  "sti     ;\n"
-		 "pushf   ;\n"
-		 "pushl %1;\n"
-		 "pushl %0;\n"
-		  :        				/* no output */
-          : "g"(entry_address), "g"(USER_CS), "g"(USER_DS), "g"(user_stack_base_ptr)
-          : "memory", "cc"
-        );
-
-	// iret
-	asm ("iret;");
-
-	// label for halt to return back to
-	asm ("return_from_halt:");
-	
-	// save return value
-	int ret_value = error_return_value;
-	// reset return flag
-	error_return_value = FLAG_UNSET;
-	
-	return ret_value;
+/* sys_poll
+ * 
+ * Description: System call for poll, waits until one of the given fds can be read or
+ * written without blocking, see fs/poll.h
+ * Inputs: pollfd_t* fds -- fds and the events to wait for, revents gets filled in
+ *		   uint32_t nfds -- number of entries in fds
+ *		   int32_t timeout_ms -- how long to wait, 0 to just look, -1 for no limit
+ * Outputs: number of fds with revents set, 0 on timeout, -1 on failure
+ * Side Effects: may sleep
+ */
+int32_t sys_poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms) {
+	uint32_t fds_address = (uint32_t) fds;
+	pollfd_t local_fds[POLL_MAX_FDS];
+	int32_t ready;
+
+	if(nfds > POLL_MAX_FDS || timeout_ms < POLL_FOREVER)
+		return RETURN_FAIL;
+	if(fds_address < PROGRAM_IMAGE_START_ADDRESS || fds_address + nfds * sizeof(pollfd_t) > PROGRAM_IMAGE_END_ADDRESS)
+		return RETURN_FAIL;
+
+	// work on a copy, a thread sharing the memory can't change fds under the drivers
+	memcpy(local_fds, fds, nfds * sizeof(pollfd_t));
+	ready = poll_files(local_fds, nfds, timeout_ms);
+	memcpy(fds, local_fds, nfds * sizeof(pollfd_t));
+	return ready;
+}
+
+/* sys_fcntl
+ * 
+ * Description: System call for fcntl, gets or sets the O_NONBLOCK flag of a file descriptor
+ * Inputs: int32_t fd -- the file descriptor
+ *		   int32_t cmd -- F_GETFL or F_SETFL
+ *		   int32_t arg -- for F_SETFL, O_NONBLOCK or 0
+ * Outputs: the flags for F_GETFL, 0 for F_SETFL, -1 on failure
+ * Side Effects: read and write on a nonblocking fd fail instead of blocking
+ */
+int32_t sys_fcntl(int32_t fd, int32_t cmd, int32_t arg) {
+	int32_t ret = RETURN_FAIL;
+
+	if(fd < 0 || fd >= FILE_DESCRIPTOR_SIZE)
+		return RETURN_FAIL;
+	mutex_lock(&fs_mutex);
+	if((current_files[fd].flags & PRESENT_BITMASK) == FLAG_SET) {
+		if(cmd == F_GETFL) {
+			ret = (current_files[fd].flags & FILE_NONBLOCK_FLAG) ? O_NONBLOCK : 0;
+		} else if(cmd == F_SETFL) {
+			if(arg & O_NONBLOCK)
+				current_files[fd].flags |= FILE_NONBLOCK_FLAG;
+			else
+				current_files[fd].flags &= ~FILE_NONBLOCK_FLAG;
+			ret = RETURN_PASS;
+		}
+	}
+	mutex_unlock(&fs_mutex);
+	return ret;
 }
 
 /* sys_read
@@ -370,16 +1085,17 @@ int32_t sys_execute(const uint8_t* command) {
  * Inputs: int32_t fd -- file descriptor index
  *		   void* buf -- pointer to char buffer to store result in
  * 		   int32_t nbytes -- how many bytes to read
- * Outputs: return -1 for fail, 0 for success
- * Side Effects: Calls from file operations table
+ * Outputs: return -1 for fail, 0 for success, -1 if the fd is nonblocking and the read would block
+ * Side Effects: Calls from file operations table, drivers that can block check the nonblocking
+ * flag where they would sleep, checking it here first would race with other readers
  */
 int sys_read(int32_t fd, void* buf, int32_t nbytes) {
 	if(fd >= FILE_DESCRIPTOR_SIZE || fd < 0 || fd == STDOUT_FD) {
 		return RETURN_FAIL;
-	} else if((PCB[current_process_pid]->file[fd].flags & PRESENT_BITMASK) == FLAG_UNSET) {
+	} else if((current_files[fd].flags & PRESENT_BITMASK) == FLAG_UNSET) {
 		return RETURN_FAIL;
 	} else {
-		return PCB[current_process_pid]->file[fd].operation_table.read(fd, buf, nbytes);
+		return current_files[fd].operation_table.read(fd, buf, nbytes);
 	}
 	return RETURN_PASS;
 }
@@ -390,29 +1106,29 @@ int sys_read(int32_t fd, void* buf, int32_t nbytes) {
  * Inputs: int32_t fd -- file descriptor index
  *		   void* buf -- pointer to char buffer with the data to write
  * 		   int32_t nbytes -- how many bytes to write
- * Outputs: return -1 for fail, 0 for success
- * Side Effects: Calls from file operations table
+ * Outputs: return -1 for fail, 0 for success, -1 if the fd is nonblocking and the write would block
+ * Side Effects: Calls from file operations table, see sys_read for the nonblocking flag
  */
 int sys_write(int32_t fd, const void* buf, int32_t nbytes) {
 	if(fd >= FILE_DESCRIPTOR_SIZE || fd < 0 || fd == STDIN_FD) {
 		return RETURN_FAIL;
-	} else if((PCB[current_process_pid]->file[fd].flags & PRESENT_BITMASK) == FLAG_UNSET) {
+	} else if((current_files[fd].flags & PRESENT_BITMASK) == FLAG_UNSET) {
 		return RETURN_FAIL;
 	} else {
-		return PCB[current_process_pid]->file[fd].operation_table.write(fd, buf, nbytes);
+		return current_files[fd].operation_table.write(fd, buf, nbytes);
 	}
 	return RETURN_PASS;
 }
 
-/* sys_open
+/* open_locked
  * 
- * Description: System call for open, based on the filename, figure out whether to use predefined 
+ * Description: based on the filename, figure out whether to use predefined 
  * 				file descriptor entry, or to setup new entry, and returns the right fd
  * Inputs: uint8_t* filename -- filename for file to open
  * Outputs: return the fd
- * Side Effects: Creates an entry in the file descriptor array
+ * Side Effects: Creates an entry in the file descriptor array, fs_mutex must be held
  */
-int sys_open(const uint8_t* filename) {
+static int32_t open_locked(const uint8_t* filename) {
 	// set the file descript entry flag bit 0 to be 1, in the first unused file desc entry
 	if(filename[0] == '\0') {
 		return RETURN_FAIL;
@@ -439,33 +1155,52 @@ int sys_open(const uint8_t* filename) {
 	uint32_t dir_file_type = entry.file_type;
 	uint32_t idx;
 	for(idx = FIRST_READABLE_FILE; idx < FILE_DESCRIPTOR_SIZE; idx++) {
-		if((PCB[current_process_pid]->file[idx].flags & PRESENT_BITMASK) == FLAG_UNSET) {
-			PCB[current_process_pid]->file[idx].inode = entry.inode_num;
-			PCB[current_process_pid]->file[idx].file_position = 0;
-			PCB[current_process_pid]->file[idx].flags |= FLAG_SET;  // Set present bit
+		if((current_files[idx].flags & PRESENT_BITMASK) == FLAG_UNSET) {
+			current_files[idx].inode = entry.inode_num;
+			current_files[idx].file_position = 0;
+			current_files[idx].flags |= FLAG_SET;  // Set present bit
 			if(is_mouse_entry_flag) {
 				// we need to create a mouse op table
-				PCB[current_process_pid]->file[idx].operation_table = mouse;
+				current_files[idx].operation_table = mouse;
 			}
 			else if(dir_file_type == FS_TYPE_RTC) {
-				PCB[current_process_pid]->file[idx].flags |= 0x2; // Set this bit to indicate rtc fd
+				current_files[idx].flags |= 0x2; // Set this bit to indicate rtc fd
 				// Set RTC to default freq
-				PCB[current_process_pid]->file[idx].file_position = RTC_MAX_FREQ / DEFAULT_RTC_FREQ;
-				PCB[current_process_pid]->file[idx].operation_table = rtc;
+				current_files[idx].file_position = RTC_MAX_FREQ / DEFAULT_RTC_FREQ;
+				// periods are counted from the last read, see rtc_read
+				current_files[idx].inode = global_count;
+				current_files[idx].operation_table = rtc;
 			}
 			else if(dir_file_type == FS_TYPE_DIR) {
-				PCB[current_process_pid]->file[idx].operation_table = directories;
+				current_files[idx].operation_table = directories;
 			}
 			else if(dir_file_type == FS_TYPE_FILE) {
-				PCB[current_process_pid]->file[idx].operation_table = files;
+				current_files[idx].operation_table = files;
 			}
-			PCB[current_process_pid]->file[idx].operation_table.open(filename);
+			current_files[idx].operation_table.open(filename);
 			return idx;
 		}
 	}
 	return RETURN_FAIL;
 }
 
+/* sys_open
+ * 
+ * Description: System call for open, looks the file up and takes a file descriptor for it
+ * under fs_mutex, so threads sharing the file table can't grab the same slot
+ * Inputs: uint8_t* filename -- filename for file to open
+ * Outputs: return the fd
+ * Side Effects: Creates an entry in the file descriptor array
+ */
+int sys_open(const uint8_t* filename) {
+	int32_t fd;
+
+	mutex_lock(&fs_mutex);
+	fd = open_locked(filename);
+	mutex_unlock(&fs_mutex);
+	return fd;
+}
+
 /* sys_close
  * 
  * Description: System call for close, based on the fd, calls close from file operations table
@@ -474,16 +1209,21 @@ int sys_open(const uint8_t* filename) {
  * Side Effects: Calls 
  */
 int sys_close(int32_t fd) {
+	int32_t ret = RETURN_FAIL;
+
 	if(fd < FIRST_READABLE_FILE || fd >= FILE_DESCRIPTOR_SIZE) {
 		return RETURN_FAIL;
-	} else if((PCB[current_process_pid]->file[fd].flags & PRESENT_BITMASK) == FLAG_SET) {
-		PCB[current_process_pid]->file[fd].operation_table.close(fd);
-		PCB[current_process_pid]->file[fd].flags &= FLAG_UNSET;  // Clear present bit and flags
-		PCB[current_process_pid]->file[fd].inode = 0;
-		PCB[current_process_pid]->file[fd].file_position = 0;
-		return RETURN_PASS;
 	}
-	return RETURN_FAIL;
+	mutex_lock(&fs_mutex);
+	if((current_files[fd].flags & PRESENT_BITMASK) == FLAG_SET) {
+		current_files[fd].operation_table.close(fd);
+		current_files[fd].flags &= FLAG_UNSET;  // Clear present bit and flags
+		current_files[fd].inode = 0;
+		current_files[fd].file_position = 0;
+		ret = RETURN_PASS;
+	}
+	mutex_unlock(&fs_mutex);
+	return ret;
 }
 
 /* sys_getargs
@@ -495,7 +1235,7 @@ int sys_close(int32_t fd) {
  * Side Effects: Copies from kernel space to user space
  */
 int32_t sys_getargs(uint8_t* buf, int32_t nbytes) {
-	int8_t * args = (int8_t *) PCB[current_process_pid]->args;
+	int8_t * args = (int8_t *) PCB[current_process_pid]->leader->args;
 
 	// Must fit args and null terminator; args must not be empty
 
@@ -544,16 +1284,11 @@ int32_t sys_vidmap(uint8_t** screen_start) {
 	
 	*screen_start = (uint8_t *) PROGRAM_IMAGE_END_ADDRESS;											
 
-	// map virtual 0x8400000 -> physical 0xB8000
-	page_table_vid[0] = (VIDEO_MEM_FULL_ADDR) | USER_READ_WRITE_PRESENT_ENABLE;			
-	unsigned int page_dir = (unsigned int)*screen_start >> BITSHIFT_PAGE_OFFSET;
-
-	// modify page dir
-	page_directory[page_dir] = (unsigned int)(page_table_vid);
-	page_directory[page_dir] |= USER_READ_WRITE_PRESENT_ENABLE;
-
-	// flush TLB
-	asm volatile ("movl %cr3,%eax; movl %eax,%cr3");
+	// map virtual 0x8400000 -> physical 0xB8000, or our terminal's backup if it's not on screen
+	uint32_t flags;
+	cli_and_save(flags);
+	scheduler_map_process(PCB[current_process_pid]);
+	restore_flags(flags);
 
 	return RETURN_PASS; 
 }
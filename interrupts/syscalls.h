@@ -9,17 +9,28 @@
 #include "../fs/fs.h"
 #include "../fs/file.h"
 #include "../fs/directory.h"
+#include "../fs/pipe.h"
+#include "../fs/poll.h"
 #include "../scheduler/scheduler.h"
+#include "../scheduler/fpu.h"
+#include "../scheduler/futex.h"
+#include "../scheduler/kstack.h"
+#include "../paging/page_pool.h"
+#include "../paging/frame_alloc.h"
+#include "../paging/kmalloc.h"
+#include "../paging/user_mem.h"
+#include "../paging/shm.h"
+#include "../paging/vdata.h"
 #include "syscall_structs.h"
+#include "io_ring.h"
 
 #ifndef _SYSCALLS_H
 #define _SYSCALLS_H
 
-// end of kernel
-#define PCB_KERNEL_PHYSICAL_ADDRESS 0x800000
-// size of PCB
+// size of a kernel stack
 #define PCB_KERNEL_PHYSICAL_OFFSET 0x2000
-// start of user programs in physical mem
+#define PCB_KERNEL_STACK_PAGES (PCB_KERNEL_PHYSICAL_OFFSET / PG_BASE_SIZE)
+// size of a process's user page
 #define PROCESS_USER_PHYSICAL_OFFSET 0x400000
 // start of user program in virtual mem
 #define PROCESS_VIRTUAL_ADDRESS_START 0x08000000
@@ -49,8 +60,32 @@
 // end of user program in virtual mem
 #define PROGRAM_IMAGE_END_ADDRESS 0x8400000
 
+// waitpid
+#define WAIT_ANY -1
+#define WNOHANG 1
+
+// arg and return address thread_create puts on a new thread's user stack
+#define THREAD_STACK_FRAME_SIZE 8
+
 void init_PCBs();
 
+extern PCB_BLOCK_t* process_alloc(uint8_t terminal_idx, uint8_t process_flags);
+
+extern int32_t process_address_space_create(PCB_BLOCK_t* process);
+
+extern void process_setup_first_run(PCB_BLOCK_t* process, uint32_t entry_address, uint32_t user_esp);
+
+extern int32_t process_create(const uint8_t* command, uint8_t terminal_idx, PCB_BLOCK_t* parent, uint8_t process_flags);
+
+extern int32_t thread_create(uint32_t entry_address, uint32_t stack_top, uint32_t arg);
+
+extern int32_t process_fork();
+extern void process_exit(int32_t status);
+
+extern int32_t process_wait(int32_t pid, int32_t* status, int32_t options);
+
+extern void process_free(PCB_BLOCK_t* process);
+
 extern int sys_halt_wrapper(uint32_t status);
 
 extern int32_t sys_halt(uint8_t status);
@@ -73,4 +108,34 @@ extern int32_t sys_set_handler(int32_t signum, void* handler_address);
 
 extern int32_t sys_sigreturn(void);
 
+extern int32_t sys_spawn(const uint8_t* command);
+
+extern int32_t sys_waitpid(int32_t pid, int32_t* status, int32_t options);
+
+extern int32_t sys_sched_stats(uint32_t cpu_idx, sched_stats_t* stats);
+
+extern int32_t sys_thread_create(void* entry, void* stack_top, void* arg);
+
+extern int32_t sys_thread_exit(int32_t status);
+
+extern int32_t sys_thread_join(int32_t tid, int32_t* status);
+
+extern int32_t sys_futex(uint32_t* uaddr, int32_t op, uint32_t val);
+
+extern int32_t sys_pipe(int32_t* fds);
+
+extern int32_t sys_sbrk(int32_t increment);
+extern int32_t sys_fork(void);
+extern int32_t sys_shm_get(int32_t key, uint32_t size);
+extern int32_t sys_shm_attach(int32_t id);
+extern int32_t sys_shm_detach(void* addr);
+extern int32_t sys_kstack_stats(int32_t pid, kstack_stats_t* stats);
+extern int32_t sys_ring_setup(io_ring_t* ring);
+extern int32_t sys_ring_enter(uint32_t to_submit);
+extern int32_t sys_poll(pollfd_t* fds, uint32_t nfds, int32_t timeout_ms);
+extern int32_t sys_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+
+// where a forked child's first context_switch returns to, see syscalls_linkage.S
+extern void fork_child_return();
+
 #endif
@@ -0,0 +1,38 @@
+#include "sysenter.h"
+#include "../x86_desc.h"
+
+uint8_t sysenter_enabled = 0;
+
+/* Writes a 64 bit model specific register */
+static inline void wrmsr(uint32_t msr, uint32_t low, uint32_t high) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"(low), "d"(high) : "memory");
+}
+
+/* void sysenter_init_cpu(cpu_t* cpu)
+ * Inputs: cpu - processor we are running on, its TSS already loaded
+ * Return Value: None
+ * sysenter takes its esp from an MSR, but the kernel stack changes with
+ * every process. So the MSR points at this processor's tss.esp0, which the
+ * scheduler keeps up to date anyway, and sysenter_entry loads esp from there.
+ * SYSEXIT derives the user selectors from MSR_SYSENTER_CS, which works out
+ * because our GDT has kernel code, kernel data, user code and user data in
+ * that order */
+void sysenter_init_cpu(cpu_t* cpu) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t signature;
+
+    asm volatile ("cpuid"
+                  : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                  : "a"(1)
+                  );
+    signature = eax & 0xFFF;
+    if(!(edx & CPUID_SEP_FLAG))
+        return;
+    if((signature >> 8) == CPUID_FAMILY_P6 && signature < SEP_MIN_P6_SIGNATURE)
+        return;
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t) &cpu->tss.esp0, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t) sysenter_entry, 0);
+    sysenter_enabled = 1;
+}
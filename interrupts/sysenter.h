@@ -0,0 +1,46 @@
+/** sysenter.h - fast system call entry through SYSENTER/SYSEXIT
+ *
+ *  int 0x80 stays the way in for every program. Programs that want to skip
+ *  the gate and the iret can instead load the same registers as for int 0x80
+ *  (eax number, ebx/ecx/edx arguments), put the address to come back to in
+ *  esi and their esp in ebp, and execute sysenter. They get the return value
+ *  in eax and find esi, edi, ebx and ebp the way they left them, but ecx,
+ *  edx and the arithmetic flags are gone, since sysexit returns through them.
+ *
+ *  The kernel stack looks the same either way, so fork works from both.
+ */
+
+#ifndef _SYSENTER_H
+#define _SYSENTER_H
+
+// eflags recorded for a sysenter caller, which leaves with sysexit, not popfl
+#define SYSENTER_USER_EFLAGS 0x202
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../scheduler/smp.h"
+
+// SYSENTER model specific registers
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+// CPUID.1:EDX, SYSENTER/SYSEXIT present
+#define CPUID_SEP_FLAG 0x00000800
+// the Pentium Pro sets CPUID_SEP_FLAG without having the instructions
+#define CPUID_FAMILY_P6 6
+#define SEP_MIN_P6_SIGNATURE 0x633
+
+/* set once the processors were set up for sysenter */
+extern uint8_t sysenter_enabled;
+
+/* points the SYSENTER MSRs of the processor we run on at sysenter_entry */
+extern void sysenter_init_cpu(cpu_t* cpu);
+
+/* where sysenter lands, see syscalls_linkage.S */
+extern void sysenter_entry();
+
+#endif /* ASM */
+
+#endif /* _SYSENTER_H */
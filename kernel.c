@@ -21,9 +21,22 @@
 #include "interrupts/syscalls.h"
 #include "paging/multi_terminals.h"
 #include "scheduler/scheduler.h"
+#include "scheduler/fpu.h"
+#include "scheduler/workqueue.h"
+#include "scheduler/futex.h"
+#include "scheduler/smp.h"
+#include "apic.h"
+#include "paging/page_pool.h"
+#include "paging/frame_alloc.h"
+#include "paging/kmalloc.h"
+#include "paging/swap.h"
+#include "paging/vdata.h"
 
 #define RUN_TESTS
 
+/* First address after the kernel image, provided by the linker. */
+extern uint8_t _end;
+
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
@@ -61,7 +74,17 @@ void entry(unsigned long magic, unsigned long addr) {
     if (CHECK_FLAG(mbi->flags, 2))
         printf("cmdline = %s\n", (char *)mbi->cmdline);
 
+    uint8_t terminal_count = DEFAULT_NUM_TERMINALS;
+    if (CHECK_FLAG(mbi->flags, 2))
+        terminal_count = multi_term_parse_cmdline((int8_t *) mbi->cmdline);
+
+    uint32_t mem_upper = 0;
+    if (CHECK_FLAG(mbi->flags, 0))
+        mem_upper = mbi->mem_upper;
+
     uint32_t boot_block_addr;
+    /* the page pool must not hand out the kernel image or the filesystem module */
+    uint32_t kernel_reserved_end = (uint32_t) &_end;
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
         int i;
@@ -75,6 +98,8 @@ void entry(unsigned long magic, unsigned long addr) {
                 printf("0x%x ", *((char*)(mod->mod_start+i)));
             }
             printf("\n");
+            if (mod->mod_end > kernel_reserved_end)
+                kernel_reserved_end = mod->mod_end;
             mod_count++;
             mod++;
         }
@@ -152,6 +177,7 @@ void entry(unsigned long magic, unsigned long addr) {
     }
 
     init_idt();
+    fpu_init();
 
     /* Init the PIC */
     i8259_init();
@@ -167,14 +193,40 @@ void entry(unsigned long magic, unsigned long addr) {
     
     paging_init(page_directory);
 
+    page_pool_init(kernel_reserved_end);
+    kmalloc_init();
+    /* All RAM above the kernel's 4MB page goes to user pages and page tables */
+    if (CHECK_FLAG(mbi->flags, 6))
+        frame_init((memory_map_t *) mbi->mmap_addr, mbi->mmap_length, mem_upper, kernel_reserved_end);
+    else
+        frame_init(NULL, 0, mem_upper, kernel_reserved_end);
     init_PCBs();
     fs_init(boot_block_addr);  
       
     // clear video memory
     clear();
-    three_term_init();
+    multi_term_init(terminal_count);
     scheduler_init();
-    pit_init();
+    futex_init();
+    /* The page of clock and load figures every process gets mapped read only */
+    vdata_init();
+    /* Start the other processors, if any. Interrupts move over to the APICs then */
+    smp_init();
+
+    /* Start a root shell on every terminal, they run from the first PIT tick on */
+    {
+        int term;
+        for (term = 0; term < num_terminals; term++)
+            process_create((uint8_t *) "shell", term, NULL, PROCESS_FLAG_ROOT);
+        draw_status_bar();
+    }
+    /* Interrupt handlers hand their slow work to the kworker thread from here on */
+    workqueue_init();
+    /* Idle processes get paged out to the swap disk, if there is one */
+    swap_init();
+    /* With the APICs up every processor ticks off its own local APIC timer instead */
+    if (!apic_enabled)
+        pit_init();
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -188,6 +240,8 @@ void entry(unsigned long magic, unsigned long addr) {
 
 #endif
 
-    /* Spin (nicely, so we don't chew up cycles) */
-    asm volatile (".1: hlt; jmp .1;");
+    /* Spin (nicely, so we don't chew up cycles), zeroing frames while there
+     * is nothing else to do. This is also where the scheduler parks the CPU
+     * whenever no process is runnable. */
+    scheduler_idle();
 }
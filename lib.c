@@ -5,11 +5,23 @@
 #include "devices/terminal_structs.h"
 #include "scheduler/scheduler.h"
 #include "interrupts/syscall_structs.h"
+#include "scheduler/workqueue.h"
+#include "paging/multi_terminals.h"
 
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
-static int status_bar_colors[3] = {4,2,1};
+// cycled through when there are more terminals than colors
+#define NUM_STATUS_BAR_COLORS 6
+static int status_bar_colors[NUM_STATUS_BAR_COLORS] = {4,2,1,5,3,6};
+
+// status bar redraws are queued from interrupt handlers and drawn by the kworker
+static void status_bar_redraw_work(uint32_t data);
+static void status_bar_time_work(uint32_t data);
+static work_t status_bar_redraw = WORK_INIT(status_bar_redraw_work, 0);
+static work_t status_bar_time = WORK_INIT(status_bar_time_work, 0);
+// latest time from the CMOS, packed as hours << 16 | minutes << 8 | seconds
+static volatile uint32_t status_bar_clock;
 
 /* void clear(void);
  * Inputs: void
@@ -36,8 +48,8 @@ void clear_multi(uint8_t* ptr_vid, uint32_t terminal_idx){
         *(uint8_t *)(ptr_vid + (i << 1)) = ' ';
         *(uint8_t *)(ptr_vid + (i << 1) + 1) = ATTRIB;
     }
-    three_terminals[terminal_idx].screen_x = 0; 
-    three_terminals[terminal_idx].screen_y = 0; 
+    terminals[terminal_idx]->screen_x = 0; 
+    terminals[terminal_idx]->screen_y = 0; 
 }
 
 /* void set_screen_position(void);
@@ -82,7 +94,10 @@ void update_status_bar_time(uint8_t h, uint8_t m, uint8_t s) {
     uint8_t col;
     uint8_t idx = 0;
     uint32_t vid_mem;
-    for(vid_mem = 0xB8000; vid_mem <= 0xBB000; vid_mem += 0x1000) {
+    int32_t term;
+    // the screen, then every terminal's backup page so switching keeps the time
+    for(term = -1; term < (int32_t) num_terminals; term++) {
+        vid_mem = (term < 0) ? VISUAL_VIRTUAL_ADDR : virtual_terminal_addresses[term];
         idx = 0;
         for(col = NUM_COLS - TIME_BAR_WIDTH; col < NUM_COLS; col++) {
             if(col > NUM_COLS - TIME_BAR_WIDTH && col < NUM_COLS - 1) {
@@ -94,9 +109,35 @@ void update_status_bar_time(uint8_t h, uint8_t m, uint8_t s) {
     }
 }
 
+/* void queue_status_bar_time(uint8_t h, uint8_t m, uint8_t s);
+ * Inputs: h, m, s -- current time
+ * Return Value: none
+ * Function: Stores the time and lets the kworker draw it, safe from interrupt handlers */
+void queue_status_bar_time(uint8_t h, uint8_t m, uint8_t s) {
+    status_bar_clock = ((uint32_t) h << 16) | ((uint32_t) m << 8) | s;
+    queue_work(&status_bar_time);
+}
+
+/* void queue_status_bar_redraw(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Lets the kworker redraw the status bar, safe from interrupt handlers */
+void queue_status_bar_redraw(void) {
+    queue_work(&status_bar_redraw);
+}
+
+static void status_bar_time_work(uint32_t data) {
+    uint32_t clock = status_bar_clock;
+    update_status_bar_time((clock >> 16) & 0xFF, (clock >> 8) & 0xFF, clock & 0xFF);
+}
+
+static void status_bar_redraw_work(uint32_t data) {
+    draw_status_bar();
+}
+
 void draw_status_bar(void) {
-    uint8_t num_processes = MAX_MULTIPROCESS_NUM;
-    uint8_t dist_per_column = (NUM_COLS - TIME_BAR_WIDTH) / num_processes;
+    uint8_t num_processes = num_terminals;
+    uint8_t dist_per_column;
     uint8_t i;
     uint8_t row;
     uint8_t col;
@@ -106,12 +147,26 @@ void draw_status_bar(void) {
     uint8_t cmd_len;
     uint8_t arg_len;
     uint8_t starting_text_pt;
+    uint8_t base_color;
+    uint32_t flags;
+
+    if(num_processes == 0)
+        return;
+    dist_per_column = (NUM_COLS - TIME_BAR_WIDTH) / num_processes;
     for(i = 0; i < num_processes; i++) {
         memset((void *) p_name, 0, 128);
         total_idx = 0;
-        pid = multi_process_idx[i];
-        cmd_len = strlen((int8_t *) PCB[pid]->cmd_name);
-        arg_len = strlen((int8_t *) PCB[pid]->args);
+        // the foreground process can exit under us while we copy its name
+        spin_lock_irqsave(&sched_lock, flags);
+        pid = terminal_foreground_pid[i];
+        // terminal hasn't started its shell yet
+        if(pid >= process_table_size || PCB[pid] == NULL) {
+            cmd_len = 0;
+            arg_len = 0;
+        } else {
+            cmd_len = strlen((int8_t *) PCB[pid]->cmd_name);
+            arg_len = strlen((int8_t *) PCB[pid]->args);
+        }
         for(col = 0; col < cmd_len; col++) {
             p_name[total_idx] = PCB[pid]->cmd_name[col];
             total_idx++;
@@ -125,10 +180,16 @@ void draw_status_bar(void) {
             }
         }
         p_name[total_idx] = '\0';
-        starting_text_pt = ((i * dist_per_column) + (dist_per_column / 2) - (cmd_len + arg_len + 2) / 2) + 1;
+        spin_unlock_irqrestore(&sched_lock, flags);
+        // names that don't fit get cut off at the end of the column
+        if(cmd_len + arg_len + 2 >= dist_per_column)
+            starting_text_pt = i * dist_per_column + 1;
+        else
+            starting_text_pt = ((i * dist_per_column) + (dist_per_column / 2) - (cmd_len + arg_len + 2) / 2) + 1;
+        base_color = status_bar_colors[i % NUM_STATUS_BAR_COLORS];
         for(col = i * dist_per_column; col < (i + 1) * dist_per_column; col++) {
             for(row = STATUS_BAR_HEIGHT; row > 0; row--) {
-                uint8_t color = (current_term == i) ? status_bar_colors[i] + 8 : status_bar_colors[i];
+                uint8_t color = (current_term == i) ? base_color + 8 : base_color;
                 if(col >= starting_text_pt && col < starting_text_pt + (cmd_len + arg_len + 2)) {
                     *(uint8_t *)(video_mem + ((NUM_COLS * (NUM_ROWS - row) + col) << 1)) = p_name[col - starting_text_pt];
                     *(uint8_t *)(video_mem + ((NUM_COLS * (NUM_ROWS - row) + col) << 1) + 1) = color << 4 | 0x0F;
@@ -305,15 +366,15 @@ void putc(uint8_t c) {
  *  Function: Output a character to the console */
 void putc_multi(uint8_t c, uint8_t* ptr_vid, uint32_t terminal_idx){
     if(c == '\n' || c == '\r') {
-        three_terminals[terminal_idx].screen_y++;
-        three_terminals[terminal_idx].screen_x = 0; 
+        terminals[terminal_idx]->screen_y++;
+        terminals[terminal_idx]->screen_x = 0; 
     } else {
-        *(uint8_t *)(ptr_vid + ((NUM_COLS * three_terminals[terminal_idx].screen_y + three_terminals[terminal_idx].screen_x) << 1)) = c; 
-        *(uint8_t *)(ptr_vid + ((NUM_COLS * three_terminals[terminal_idx].screen_y + three_terminals[terminal_idx].screen_x) << 1) + 1) = ATTRIB;
-        three_terminals[terminal_idx].screen_x++;
+        *(uint8_t *)(ptr_vid + ((NUM_COLS * terminals[terminal_idx]->screen_y + terminals[terminal_idx]->screen_x) << 1)) = c; 
+        *(uint8_t *)(ptr_vid + ((NUM_COLS * terminals[terminal_idx]->screen_y + terminals[terminal_idx]->screen_x) << 1) + 1) = ATTRIB;
+        terminals[terminal_idx]->screen_x++;
     }
-    three_terminals[terminal_idx].screen_y = (three_terminals[terminal_idx].screen_y + (three_terminals[terminal_idx].screen_x / NUM_COLS)) % (NUM_ROWS - STATUS_BAR_HEIGHT); 
-    three_terminals[terminal_idx].screen_x %= NUM_COLS; 
+    terminals[terminal_idx]->screen_y = (terminals[terminal_idx]->screen_y + (terminals[terminal_idx]->screen_x / NUM_COLS)) % (NUM_ROWS - STATUS_BAR_HEIGHT); 
+    terminals[terminal_idx]->screen_x %= NUM_COLS; 
 }
 
 /* void setc_multi(int x, int y, uint8_t c, uint8_t* ptr_vid);
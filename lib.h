@@ -29,6 +29,8 @@ void clear_multi(uint8_t* ptr_vid, uint32_t terminal_idx);
 void set_screen_position(int x, int y);
 void draw_status_bar(void);
 void update_status_bar_time(uint8_t h, uint8_t m, uint8_t s);
+void queue_status_bar_time(uint8_t h, uint8_t m, uint8_t s);
+void queue_status_bar_redraw(void);
 
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
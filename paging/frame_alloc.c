@@ -0,0 +1,414 @@
+#include "frame_alloc.h"
+#include "../spinlock.h"
+#include "../lib.h"
+#include "tlb.h"
+#include "../scheduler/smp.h"
+
+// one bit per 4kB frame of physical memory, set = in use or not RAM
+static uint32_t frame_bitmap[FRAME_BITMAP_WORDS];
+// free 4kB frames in each 4MB frame, FRAMES_PER_LARGE means it is whole
+static uint16_t large_free[NUM_LARGE_FRAMES];
+static uint32_t frames_available;
+// address spaces each 4kB frame is mapped in, more than one once fork shares it copy on write
+static uint8_t frame_refs[FRAME_BITMAP_WORDS * 32];
+// frames the idle loop has already zeroed, in use as far as the bitmap is concerned
+static uint32_t zero_pool[FRAME_ZERO_POOL_SIZE];
+static uint32_t zero_pool_depth;
+static frame_zero_stats_t zero_pool_stats;
+// every processor takes frames for its processes
+static spinlock_t frame_lock = SPINLOCK_INIT;
+
+#define FRAME_IDX(addr) ((addr) / FRAME_SIZE)
+#define FRAME_ADDR(idx) ((idx) * FRAME_SIZE)
+#define LARGE_IDX(idx)  ((idx) / FRAMES_PER_LARGE)
+#define FRAME_USED(idx) (frame_bitmap[(idx) >> 5] & (1 << ((idx) & 0x1F)))
+// bitmap words covering one 4MB frame
+#define WORDS_PER_LARGE (FRAMES_PER_LARGE / 32)
+
+/*
+ * frame_mark_free
+ * Inputs: start - first byte of usable RAM
+ *         end - first byte after it
+ * Return Value: None
+ * Side Effects: only frames that lie completely inside the range become free
+ */
+static void frame_mark_free(uint32_t start, uint32_t end) {
+    uint32_t idx;
+
+    if(start < FRAME_MANAGED_START)
+        start = FRAME_MANAGED_START;
+    if(end > FRAME_MAX_PHYS)
+        end = FRAME_MAX_PHYS;
+    if(end <= start)
+        return;
+
+    for(idx = FRAME_IDX(start + FRAME_SIZE - 1); idx < FRAME_IDX(end); idx++) {
+        if(!FRAME_USED(idx))
+            continue;
+        frame_bitmap[idx >> 5] &= ~(1 << (idx & 0x1F));
+        large_free[LARGE_IDX(idx)]++;
+        frames_available++;
+    }
+}
+
+/*
+ * frame_init
+ * Inputs: mmap - multiboot memory map, NULL if the bootloader gave us none
+ *         mmap_length - its size in bytes
+ *         mem_upper - kB of memory above 1MB, 0 if unknown
+ *         reserved_end - first address after the kernel image and boot modules
+ * Return Value: None
+ * Side Effects: only RAM between FRAME_MANAGED_START and FRAME_MAX_PHYS is handed out
+ */
+void frame_init(memory_map_t* mmap, uint32_t mmap_length, uint32_t mem_upper, uint32_t reserved_end) {
+    uint32_t mmap_end = (uint32_t) mmap + mmap_length;
+    uint32_t idx, end;
+
+    for(idx = 0; idx < FRAME_BITMAP_WORDS; idx++)
+        frame_bitmap[idx] = 0xFFFFFFFF;
+    for(idx = 0; idx < NUM_LARGE_FRAMES; idx++)
+        large_free[idx] = 0;
+    frames_available = 0;
+
+    if(mmap != NULL) {
+        for(; (uint32_t) mmap < mmap_end; mmap = (memory_map_t *) ((uint32_t) mmap + mmap->size + sizeof(mmap->size))) {
+            // nothing above 4GB is reachable without PAE
+            if(mmap->type != MMAP_TYPE_AVAILABLE || mmap->base_addr_high != 0)
+                continue;
+            end = mmap->base_addr_low + mmap->length_low;
+            // a region running past 4GB wraps around
+            if(mmap->length_high != 0 || end < mmap->base_addr_low)
+                end = FRAME_MAX_PHYS;
+            frame_mark_free(mmap->base_addr_low, end);
+        }
+    } else if(mem_upper) {
+        frame_mark_free(LOWER_MEM_SIZE, LOWER_MEM_SIZE + mem_upper * 1024);
+    } else {
+        frame_mark_free(FRAME_MANAGED_START, FRAME_DEFAULT_MEM_END);
+    }
+
+    // boot modules can sit above the kernel's 4MB page
+    for(idx = FRAME_IDX(FRAME_MANAGED_START); idx < FRAME_IDX(reserved_end + FRAME_SIZE - 1) && idx < FRAME_BITMAP_WORDS * 32; idx++) {
+        if(FRAME_USED(idx))
+            continue;
+        frame_bitmap[idx >> 5] |= (1 << (idx & 0x1F));
+        large_free[LARGE_IDX(idx)]--;
+        frames_available--;
+    }
+}
+
+/*
+ * frame_take_locked
+ * Inputs: None
+ * Return Value: physical address of a 4kB frame from the bitmap, FRAME_NONE if it is full
+ * Side Effects: frame_lock must be held. Takes from a 4MB frame that is already
+ *               broken up before breaking up a whole one
+ */
+static uint32_t frame_take_locked() {
+    uint32_t large, word, bit, idx;
+    uint32_t best = NUM_LARGE_FRAMES;
+
+    for(large = 0; large < NUM_LARGE_FRAMES; large++) {
+        if(large_free[large] == 0)
+            continue;
+        if(large_free[large] < FRAMES_PER_LARGE) {
+            best = large;
+            break;
+        }
+        if(best == NUM_LARGE_FRAMES)
+            best = large;
+    }
+    if(best == NUM_LARGE_FRAMES)
+        return FRAME_NONE;
+
+    for(word = best * WORDS_PER_LARGE; frame_bitmap[word] == 0xFFFFFFFF; word++);
+    for(bit = 0; frame_bitmap[word] & (1 << bit); bit++);
+    idx = word * 32 + bit;
+
+    frame_bitmap[word] |= (1 << bit);
+    frame_refs[idx] = 1;
+    large_free[best]--;
+    frames_available--;
+    return FRAME_ADDR(idx);
+}
+
+/*
+ * frame_alloc
+ * Inputs: None
+ * Return Value: physical address of a 4kB frame, FRAME_NONE if memory is full
+ * Side Effects: the zeroed pool is only dipped into once the bitmap runs dry
+ */
+uint32_t frame_alloc() {
+    uint32_t frame;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    frame = frame_take_locked();
+    if(frame == FRAME_NONE && zero_pool_depth > 0)
+        frame = zero_pool[--zero_pool_depth];
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return frame;
+}
+
+/*
+ * frame_alloc_zeroed
+ * Inputs: None
+ * Return Value: physical address of a 4kB frame full of zeros, FRAME_NONE if memory is full
+ * Side Effects: takes one the idle loop zeroed if there is any, otherwise zeroes
+ *               one on the spot
+ */
+uint32_t frame_alloc_zeroed() {
+    uint32_t frame = FRAME_NONE;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    if(zero_pool_depth > 0) {
+        frame = zero_pool[--zero_pool_depth];
+        zero_pool_stats.hits++;
+    } else {
+        zero_pool_stats.misses++;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    if(frame != FRAME_NONE)
+        return frame;
+
+    frame = frame_alloc();
+    if(frame != FRAME_NONE)
+        frame_zero(frame);
+    return frame;
+}
+
+/*
+ * frame_zero_pool_refill
+ * Inputs: None
+ * Return Value: 1 if a frame was zeroed and added to the pool, 0 if it is full
+ *               or memory is
+ * Side Effects: meant for the idle loop, the frame is zeroed with interrupts on
+ *               apart from the moment its window is in use
+ */
+int32_t frame_zero_pool_refill() {
+    uint32_t frame;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    frame = (zero_pool_depth < FRAME_ZERO_POOL_SIZE) ? frame_take_locked() : FRAME_NONE;
+    spin_unlock_irqrestore(&frame_lock, flags);
+    if(frame == FRAME_NONE)
+        return 0;
+
+    frame_zero(frame);
+
+    spin_lock_irqsave(&frame_lock, flags);
+    // another processor may have filled it up in the meantime
+    if(zero_pool_depth < FRAME_ZERO_POOL_SIZE) {
+        zero_pool[zero_pool_depth++] = frame;
+        zero_pool_stats.refills++;
+        frame = FRAME_NONE;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    if(frame != FRAME_NONE)
+        frame_free(frame);
+    return 1;
+}
+
+/*
+ * frame_zero_pool_get_stats
+ * Inputs: stats - where to copy the counters
+ * Return Value: None
+ */
+void frame_zero_pool_get_stats(frame_zero_stats_t* stats) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    *stats = zero_pool_stats;
+    stats->depth = zero_pool_depth;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_free
+ * Inputs: addr - frame returned by frame_alloc
+ * Return Value: None
+ * Side Effects: only drops one reference, the frame is free once the last is gone
+ */
+void frame_free(uint32_t addr) {
+    uint32_t idx = FRAME_IDX(addr);
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    if(FRAME_USED(idx) && frame_refs[idx] > 1) {
+        frame_refs[idx]--;
+    } else if(FRAME_USED(idx)) {
+        frame_refs[idx] = 0;
+        frame_bitmap[idx >> 5] &= ~(1 << (idx & 0x1F));
+        large_free[LARGE_IDX(idx)]++;
+        frames_available++;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_ref
+ * Inputs: addr - frame returned by frame_alloc
+ * Return Value: 0, -1 if the frame isn't in use or its count is full
+ * Side Effects: the frame now needs one more frame_free before it is free
+ */
+int32_t frame_ref(uint32_t addr) {
+    uint32_t idx = FRAME_IDX(addr);
+    int32_t ret = -1;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    if(FRAME_USED(idx) && frame_refs[idx] != 0 && frame_refs[idx] != FRAME_MAX_REFS) {
+        frame_refs[idx]++;
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return ret;
+}
+
+/*
+ * frame_refcount
+ * Inputs: addr - frame returned by frame_alloc
+ * Return Value: how many references the frame has, 0 if it is free
+ */
+uint32_t frame_refcount(uint32_t addr) {
+    return frame_refs[FRAME_IDX(addr)];
+}
+
+/*
+ * frame_alloc_large
+ * Inputs: None
+ * Return Value: physical address of a whole 4MB frame, FRAME_NONE if none is left
+ * Side Effects: None
+ */
+uint32_t frame_alloc_large() {
+    uint32_t large, word;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    for(large = 0; large < NUM_LARGE_FRAMES; large++) {
+        if(large_free[large] == FRAMES_PER_LARGE)
+            break;
+    }
+    if(large == NUM_LARGE_FRAMES) {
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return FRAME_NONE;
+    }
+
+    for(word = large * WORDS_PER_LARGE; word < (large + 1) * WORDS_PER_LARGE; word++)
+        frame_bitmap[word] = 0xFFFFFFFF;
+    large_free[large] = 0;
+    frames_available -= FRAMES_PER_LARGE;
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return large * LARGE_FRAME_SIZE;
+}
+
+/*
+ * frame_free_large
+ * Inputs: addr - frame returned by frame_alloc_large
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_free_large(uint32_t addr) {
+    uint32_t large = addr / LARGE_FRAME_SIZE;
+    uint32_t word;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    for(word = large * WORDS_PER_LARGE; word < (large + 1) * WORDS_PER_LARGE; word++)
+        frame_bitmap[word] = 0;
+    frames_available += FRAMES_PER_LARGE - large_free[large];
+    large_free[large] = FRAMES_PER_LARGE;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_free_count
+ * Inputs: None
+ * Return Value: number of free 4kB frames
+ */
+uint32_t frame_free_count() {
+    return frames_available + zero_pool_depth;
+}
+
+/*
+ * frame_free_large_count
+ * Inputs: None
+ * Return Value: number of whole 4MB frames
+ */
+uint32_t frame_free_large_count() {
+    uint32_t large;
+    uint32_t count = 0;
+    uint32_t flags;
+
+    spin_lock_irqsave(&frame_lock, flags);
+    for(large = 0; large < NUM_LARGE_FRAMES; large++) {
+        if(large_free[large] == FRAMES_PER_LARGE)
+            count++;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return count;
+}
+
+/*
+ * frame_window
+ * Inputs: addr - frame to reach
+ *         window - which of this processor's windows to use
+ * Return Value: kernel address the frame can be reached at
+ * Side Effects: interrupts must be off until the caller is done with it, the
+ *               window belongs to this processor and stays pointed at addr
+ */
+static uint8_t* frame_window(uint32_t addr, uint32_t window) {
+    uint32_t virt = FRAME_WINDOW_BASE + (this_cpu()->id * FRAME_WINDOWS_PER_CPU + window) * FRAME_SIZE;
+
+    page_table[virt / FRAME_SIZE] = addr | RW_SUPERVISOR_PRESENT_MASK;
+    tlb_flush_page(virt, TLB_REASON_WINDOW);
+    return (uint8_t *) virt;
+}
+
+/*
+ * frame_zero
+ * Inputs: addr - frame to clear
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_zero(uint32_t addr) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memset(frame_window(addr, 0), 0, FRAME_SIZE);
+    restore_flags(flags);
+}
+
+/*
+ * frame_copy
+ * Inputs: dst - frame to overwrite
+ *         src - frame to copy
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_copy(uint32_t dst, uint32_t src) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(frame_window(dst, 0), frame_window(src, 1), FRAME_SIZE);
+    restore_flags(flags);
+}
+
+/*
+ * frame_write
+ * Inputs: addr - frame to write into
+ *         offset - where in it to start
+ *         buf - bytes to copy
+ *         nbytes - how many, offset + nbytes must fit in the frame
+ * Return Value: None
+ * Side Effects: None
+ */
+void frame_write(uint32_t addr, uint32_t offset, const uint8_t* buf, uint32_t nbytes) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    memcpy(frame_window(addr, 0) + offset, buf, nbytes);
+    restore_flags(flags);
+}
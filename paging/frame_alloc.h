@@ -0,0 +1,109 @@
+/** frame_alloc.h - allocator for physical memory outside the kernel's 4MB page
+ *
+ *  Built from the multiboot memory map, so every usable frame the machine
+ *  has can be handed out. Frames come in 4kB for page tables and single user
+ *  pages and 4MB for large user pages. A 4kB frame is taken out of a 4MB frame
+ *  that's already broken up whenever possible, so whole 4MB frames stay around
+ *  for as long as they can. Frames aren't mapped in the kernel, whoever gets
+ *  one maps it where it's needed, or clears and copies it through one of the
+ *  per processor frame windows. 4kB frames are reference counted, so fork can
+ *  share them between address spaces until one side writes. Idle processors
+ *  keep a small pool of frames zeroed, so page faults don't have to.
+ */
+
+#ifndef _FRAME_ALLOC_H
+#define _FRAME_ALLOC_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../multiboot.h"
+#include "page_structs.h"
+
+#define FRAME_SIZE          PG_BASE_SIZE
+#define LARGE_FRAME_SIZE    0x400000
+#define FRAMES_PER_LARGE    (LARGE_FRAME_SIZE / FRAME_SIZE)
+// physical memory we keep track of, anything above it is left alone
+#define FRAME_MAX_PHYS      0x40000000
+#define NUM_LARGE_FRAMES    (FRAME_MAX_PHYS / LARGE_FRAME_SIZE)
+#define FRAME_BITMAP_WORDS  (FRAME_MAX_PHYS / FRAME_SIZE / 32)
+// everything below belongs to the kernel image and the page pool
+#define FRAME_MANAGED_START KERNEL_MEM_END
+// how much memory we assume when the bootloader gives us neither a map nor mem_upper
+#define FRAME_DEFAULT_MEM_END (KERNEL_MEM_END + 6 * LARGE_FRAME_SIZE)
+// memory below 1MB that mem_upper doesn't count
+#define LOWER_MEM_SIZE      0x100000
+// multiboot memory map type of RAM we can use
+#define MMAP_TYPE_AVAILABLE 1
+
+// frame_alloc and frame_alloc_large return this when they run out
+#define FRAME_NONE 0
+// most address spaces one 4kB frame can be shared between
+#define FRAME_MAX_REFS 0xFF
+
+// frames the idle loop keeps zeroed ahead of page faults
+#define FRAME_ZERO_POOL_SIZE 64
+
+typedef struct frame_zero_stats {
+    // frames waiting in the pool right now
+    uint32_t depth;
+    // frame_alloc_zeroed calls the pool served, and ones that had to zero on the spot
+    uint32_t hits;
+    uint32_t misses;
+    // frames the idle loop zeroed
+    uint32_t refills;
+} frame_zero_stats_t;
+
+// windows in the kernel's first 4MB for touching frames nothing else maps, two per processor
+#define FRAME_WINDOW_BASE    0x00200000
+#define FRAME_WINDOWS_PER_CPU 2
+
+/* builds the free frames from the memory map, or from mem_upper if mmap is NULL,
+ * skipping everything below reserved_end */
+extern void frame_init(memory_map_t* mmap, uint32_t mmap_length, uint32_t mem_upper, uint32_t reserved_end);
+
+/* physical address of a free 4kB frame, FRAME_NONE if there is none */
+extern uint32_t frame_alloc();
+
+/* same as frame_alloc, but the frame is all zeros */
+extern uint32_t frame_alloc_zeroed();
+
+/* zeroes one more frame for the pool, 1 if it did, 0 if there is nothing to do */
+extern int32_t frame_zero_pool_refill();
+
+/* copies the zeroed pool's counters */
+extern void frame_zero_pool_get_stats(frame_zero_stats_t* stats);
+
+/* drops a reference to a frame from frame_alloc, it is free once none are left */
+extern void frame_free(uint32_t addr);
+
+/* takes another reference to a frame from frame_alloc, 0 or -1 if it can't be shared further */
+extern int32_t frame_ref(uint32_t addr);
+
+/* number of references to a frame from frame_alloc */
+extern uint32_t frame_refcount(uint32_t addr);
+
+/* physical address of a free 4MB aligned 4MB frame, FRAME_NONE if there is none */
+extern uint32_t frame_alloc_large();
+
+/* gives back a frame from frame_alloc_large */
+extern void frame_free_large(uint32_t addr);
+
+/* number of free 4kB frames, counting the zeroed pool */
+extern uint32_t frame_free_count();
+
+/* number of 4MB frames frame_alloc_large could still hand out */
+extern uint32_t frame_free_large_count();
+
+/* fills a 4kB frame with zeros */
+extern void frame_zero(uint32_t addr);
+
+/* copies the 4kB frame at src over the one at dst */
+extern void frame_copy(uint32_t dst, uint32_t src);
+
+/* copies nbytes from buf into the frame at addr, starting offset bytes in */
+extern void frame_write(uint32_t addr, uint32_t offset, const uint8_t* buf, uint32_t nbytes);
+
+#endif /* ASM */
+
+#endif /* _FRAME_ALLOC_H */
@@ -0,0 +1,322 @@
+#include "kmalloc.h"
+#include "page_pool.h"
+#include "../lib.h"
+
+// sits at the start of every slab, the objects follow it
+typedef struct slab {
+    kmem_cache_t* cache;
+    struct slab* prev;
+    struct slab* next;
+    // free objects, each one holds a pointer to the next
+    void* free_list;
+    uint32_t in_use;
+} slab_t;
+
+#define SLAB_HEADER_SIZE ((sizeof(slab_t) + KMEM_ALIGN - 1) & ~(KMEM_ALIGN - 1))
+#define POOL_PAGE_IDX(addr) (((uint32_t) (addr) - KERNEL_MEM_START) / PG_BASE_SIZE)
+
+static const int8_t* kmalloc_names[KMALLOC_NUM_CACHES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+static kmem_cache_t kmalloc_caches[KMALLOC_NUM_CACHES];
+
+// for each page pool page, the slab it belongs to, so frees can find it
+static slab_t* page_slab[PAGE_POOL_NUM_PAGES];
+// for each page pool page starting a kmalloc too big for the caches, its length in pages
+static uint16_t page_run[PAGE_POOL_NUM_PAGES];
+
+static kmem_cache_t* kmem_caches;
+static spinlock_t kmem_caches_lock = SPINLOCK_INIT;
+
+/*
+ * slab_list_add
+ * Inputs: head - list to put slab on
+ *         slab - slab on no list
+ * Return Value: None
+ */
+static void slab_list_add(slab_t** head, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if(*head != NULL)
+        (*head)->prev = slab;
+    *head = slab;
+}
+
+/*
+ * slab_list_remove
+ * Inputs: head - list slab is on
+ *         slab - slab to take off it
+ * Return Value: None
+ */
+static void slab_list_remove(slab_t** head, slab_t* slab) {
+    if(slab->prev != NULL)
+        slab->prev->next = slab->next;
+    else
+        *head = slab->next;
+    if(slab->next != NULL)
+        slab->next->prev = slab->prev;
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+/*
+ * slab_create
+ * Inputs: cache - cache the slab is for, its lock held
+ * Return Value: new slab with every object free, or NULL if the page pool is out
+ */
+static slab_t* slab_create(kmem_cache_t* cache) {
+    slab_t* slab = (slab_t *) page_pool_alloc(cache->slab_pages);
+    uint8_t* obj;
+    uint32_t i;
+
+    if(slab == NULL)
+        return NULL;
+
+    slab->cache = cache;
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->in_use = 0;
+    slab->free_list = NULL;
+    // thread the free list backwards so the first allocation is the lowest address
+    obj = (uint8_t *) slab + SLAB_HEADER_SIZE + (cache->objects_per_slab - 1) * cache->object_size;
+    for(i = 0; i < cache->objects_per_slab; i++, obj -= cache->object_size) {
+        *((void **) obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    for(i = 0; i < cache->slab_pages; i++)
+        page_slab[POOL_PAGE_IDX(slab) + i] = slab;
+    cache->slabs++;
+    return slab;
+}
+
+/*
+ * slab_destroy
+ * Inputs: slab - slab with nothing allocated from it, on no list, its cache's lock held
+ * Return Value: None
+ */
+static void slab_destroy(slab_t* slab) {
+    kmem_cache_t* cache = slab->cache;
+    uint32_t i;
+
+    for(i = 0; i < cache->slab_pages; i++)
+        page_slab[POOL_PAGE_IDX(slab) + i] = NULL;
+    cache->slabs--;
+    page_pool_free(slab, cache->slab_pages);
+}
+
+/*
+ * slab_pages_for
+ * Inputs: object_size - aligned object size
+ * Return Value: pages per slab, the fewest that waste at most 1/SLAB_WASTE_FRACTION
+ * of the slab, or the fewest that fit one object if no slab up to SLAB_MAX_PAGES does
+ */
+static uint32_t slab_pages_for(uint32_t object_size) {
+    uint32_t pages, objects, waste;
+
+    for(pages = 1; pages <= SLAB_MAX_PAGES; pages++) {
+        objects = (pages * PG_BASE_SIZE - SLAB_HEADER_SIZE) / object_size;
+        if(objects == 0)
+            continue;
+        waste = pages * PG_BASE_SIZE - SLAB_HEADER_SIZE - objects * object_size;
+        if(waste * SLAB_WASTE_FRACTION <= pages * PG_BASE_SIZE)
+            return pages;
+    }
+    return (SLAB_HEADER_SIZE + object_size + PG_BASE_SIZE - 1) / PG_BASE_SIZE;
+}
+
+/*
+ * kmem_cache_init
+ * Inputs: cache - cache to set up
+ *         name - shows up in the stats
+ *         object_size - bytes per object, rounded up to KMEM_ALIGN
+ * Return Value: None
+ * Side Effects: no memory is taken until the first allocation
+ */
+void kmem_cache_init(kmem_cache_t* cache, const int8_t* name, uint32_t object_size) {
+    uint32_t flags;
+
+    if(object_size < sizeof(void *))
+        object_size = sizeof(void *);
+    object_size = (object_size + KMEM_ALIGN - 1) & ~(KMEM_ALIGN - 1);
+
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+    cache->object_size = object_size;
+    cache->slab_pages = slab_pages_for(object_size);
+    cache->objects_per_slab = (cache->slab_pages * PG_BASE_SIZE - SLAB_HEADER_SIZE) / object_size;
+    spin_lock_init(&cache->lock);
+
+    spin_lock_irqsave(&kmem_caches_lock, flags);
+    cache->next = kmem_caches;
+    kmem_caches = cache;
+    spin_unlock_irqrestore(&kmem_caches_lock, flags);
+}
+
+/*
+ * kmem_cache_alloc
+ * Inputs: cache - cache to take an object from
+ * Return Value: the object, or NULL if a new slab was needed and the page pool is out
+ * Side Effects: partially used slabs are filled before the empty one is touched
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    slab_t* slab;
+    void* obj;
+    uint32_t flags;
+
+    spin_lock_irqsave(&cache->lock, flags);
+    slab = cache->partial;
+    if(slab == NULL) {
+        slab = cache->empty;
+        if(slab != NULL)
+            cache->empty = NULL;
+        else
+            slab = slab_create(cache);
+        if(slab == NULL) {
+            spin_unlock_irqrestore(&cache->lock, flags);
+            return NULL;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    obj = slab->free_list;
+    slab->free_list = *((void **) obj);
+    if(++slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    cache->objects_in_use++;
+    cache->allocs++;
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+/*
+ * kmem_cache_free
+ * Inputs: cache - cache obj came from
+ *         obj - object to give back
+ * Return Value: None
+ * Side Effects: a slab that becomes empty is kept if the cache has no empty slab,
+ *               otherwise its pages go back to the page pool
+ */
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    slab_t* slab = page_slab[POOL_PAGE_IDX(obj)];
+    uint32_t flags;
+
+    spin_lock_irqsave(&cache->lock, flags);
+    if(slab->in_use == cache->objects_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+    *((void **) obj) = slab->free_list;
+    slab->free_list = obj;
+    slab->in_use--;
+    cache->objects_in_use--;
+    cache->frees++;
+
+    if(slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if(cache->empty == NULL)
+            cache->empty = slab;
+        else
+            slab_destroy(slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/*
+ * kmalloc_init
+ * Inputs: None
+ * Return Value: None
+ * Side Effects: must run after page_pool_init and before anything allocates
+ */
+void kmalloc_init() {
+    uint32_t i;
+
+    for(i = 0; i < KMALLOC_NUM_CACHES; i++)
+        kmem_cache_init(&kmalloc_caches[i], kmalloc_names[i], KMALLOC_MIN_SIZE << i);
+}
+
+/*
+ * kmalloc
+ * Inputs: size - bytes needed
+ * Return Value: memory aligned to KMEM_ALIGN, NULL if size is 0 or we are out
+ * Side Effects: sizes above KMALLOC_MAX_SIZE take whole pages
+ */
+void* kmalloc(uint32_t size) {
+    uint32_t i, pages;
+    void* ptr;
+
+    if(size == 0)
+        return NULL;
+    for(i = 0; i < KMALLOC_NUM_CACHES; i++) {
+        if(size <= (KMALLOC_MIN_SIZE << i))
+            return kmem_cache_alloc(&kmalloc_caches[i]);
+    }
+
+    pages = (size + PG_BASE_SIZE - 1) / PG_BASE_SIZE;
+    ptr = page_pool_alloc(pages);
+    if(ptr != NULL)
+        page_run[POOL_PAGE_IDX(ptr)] = pages;
+    return ptr;
+}
+
+/*
+ * kfree
+ * Inputs: ptr - memory from kmalloc, or NULL
+ * Return Value: None
+ * Side Effects: also takes objects from kmem_cache_alloc, the slab knows its cache
+ */
+void kfree(void* ptr) {
+    uint32_t idx, pages;
+    slab_t* slab;
+
+    if(ptr == NULL || (uint32_t) ptr < KERNEL_MEM_START || (uint32_t) ptr >= KERNEL_MEM_END)
+        return;
+
+    idx = POOL_PAGE_IDX(ptr);
+    slab = page_slab[idx];
+    if(slab != NULL) {
+        kmem_cache_free(slab->cache, ptr);
+        return;
+    }
+    pages = page_run[idx];
+    if(pages != 0) {
+        page_run[idx] = 0;
+        page_pool_free(ptr, pages);
+    }
+}
+
+/*
+ * kmem_cache_get_stats
+ * Inputs: idx - which cache, counting from the most recently set up one
+ *         stats - filled in
+ * Return Value: 0, or -1 if there are not that many caches
+ */
+int32_t kmem_cache_get_stats(uint32_t idx, kmem_cache_stats_t* stats) {
+    kmem_cache_t* cache;
+    uint32_t flags, cache_flags;
+
+    spin_lock_irqsave(&kmem_caches_lock, flags);
+    for(cache = kmem_caches; cache != NULL && idx > 0; cache = cache->next)
+        idx--;
+    if(cache == NULL) {
+        spin_unlock_irqrestore(&kmem_caches_lock, flags);
+        return -1;
+    }
+
+    spin_lock_irqsave(&cache->lock, cache_flags);
+    stats->name = cache->name;
+    stats->object_size = cache->object_size;
+    stats->objects_in_use = cache->objects_in_use;
+    stats->objects_total = cache->slabs * cache->objects_per_slab;
+    stats->slabs = cache->slabs;
+    stats->pages = cache->slabs * cache->slab_pages;
+    stats->allocs = cache->allocs;
+    stats->frees = cache->frees;
+    spin_unlock_irqrestore(&cache->lock, cache_flags);
+
+    spin_unlock_irqrestore(&kmem_caches_lock, flags);
+    return 0;
+}
@@ -0,0 +1,86 @@
+/** kmalloc.h - kernel heap on top of the page pool
+ *
+ *  Fixed size objects come out of slab caches. A slab is a run of page pool
+ *  pages cut into objects of one size, and its cache keeps it on a partial,
+ *  full or empty list. One empty slab per cache is kept around and any others
+ *  go back to the page pool. kmalloc is a set of power of two caches, and
+ *  anything bigger than the largest one gets whole pages.
+ */
+
+#ifndef _KMALLOC_H
+#define _KMALLOC_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../spinlock.h"
+#include "page_structs.h"
+
+// every object is aligned this much, enough for fxsave areas in PCBs
+#define KMEM_ALIGN 16
+// size classes of kmalloc, KMALLOC_MIN_SIZE << i for each cache
+#define KMALLOC_MIN_SIZE 16
+#define KMALLOC_MAX_SIZE 2048
+#define KMALLOC_NUM_CACHES 8
+// slabs grow up to this many pages while they waste more than 1/SLAB_WASTE_FRACTION
+#define SLAB_MAX_PAGES 8
+#define SLAB_WASTE_FRACTION 8
+
+struct slab;
+
+typedef struct kmem_cache {
+    const int8_t* name;
+    uint32_t object_size;
+    uint32_t slab_pages;
+    uint32_t objects_per_slab;
+    struct slab* partial;
+    struct slab* full;
+    // at most one slab with nothing allocated from it
+    struct slab* empty;
+
+    // usage, all guarded by lock
+    uint32_t objects_in_use;
+    uint32_t slabs;
+    uint32_t allocs;
+    uint32_t frees;
+
+    spinlock_t lock;
+    // every cache that was ever set up, for the stats
+    struct kmem_cache* next;
+} kmem_cache_t;
+
+typedef struct kmem_cache_stats {
+    const int8_t* name;
+    uint32_t object_size;
+    uint32_t objects_in_use;
+    uint32_t objects_total;
+    uint32_t slabs;
+    uint32_t pages;
+    uint32_t allocs;
+    uint32_t frees;
+} kmem_cache_stats_t;
+
+/* sets up the kmalloc size classes, needs the page pool */
+extern void kmalloc_init(void);
+
+/* sets up a cache of objects of object_size bytes, name has to stay around */
+extern void kmem_cache_init(kmem_cache_t* cache, const int8_t* name, uint32_t object_size);
+
+/* returns an uninitialized object from cache, or NULL */
+extern void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/* gives back an object from kmem_cache_alloc on the same cache */
+extern void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/* returns size bytes aligned to KMEM_ALIGN, or NULL */
+extern void* kmalloc(uint32_t size);
+
+/* gives back memory from kmalloc, NULL is ignored */
+extern void kfree(void* ptr);
+
+/* fills in stats for the idx-th cache, returns -1 past the last one */
+extern int32_t kmem_cache_get_stats(uint32_t idx, kmem_cache_stats_t* stats);
+
+#endif /* ASM */
+
+#endif /* _KMALLOC_H */
@@ -1,15 +1,75 @@
 #include "multi_terminals.h"
 
-uint32_t virtual_terminal_addresses[3] = {TERM_1_VIRTUAL_BACKUP, TERM_2_VIRTUAL_BACKUP, TERM_3_VIRTUAL_BACKUP};
-uint32_t physical_terminal_addresses[3] = {TERM_1_PHYSICAL_BACKUP, TERM_2_PHYSICAL_BACKUP, TERM_3_PHYSICAL_BACKUP};
+// backups live in the page pool, which is identity mapped, so both addresses match
+uint32_t virtual_terminal_addresses[MAX_TERMINALS];
+uint32_t physical_terminal_addresses[MAX_TERMINALS];
+uint8_t num_terminals = 0;
 
-void three_term_init() {
-    // for each term, call terminal init
+// terminal_ts are a couple of pages each, so a slab only holds a few
+static kmem_cache_t terminal_cache;
+
+/* uint8_t multi_term_parse_cmdline(const int8_t* cmdline)
+ * Inputs: cmdline - multiboot command line, may be NULL
+ * Return Value: requested number of terminals, DEFAULT_NUM_TERMINALS if not given
+ * Looks for "terminals=N" anywhere on the command line */
+uint8_t multi_term_parse_cmdline(const int8_t* cmdline) {
+    uint32_t count = 0;
+    const int8_t* digit;
+
+    if(cmdline == NULL)
+        return DEFAULT_NUM_TERMINALS;
+
+    for(; *cmdline != '\0'; cmdline++) {
+        if(strncmp(cmdline, (int8_t *) TERM_CMDLINE_OPTION, TERM_CMDLINE_OPTION_LEN) != 0)
+            continue;
+        for(digit = cmdline + TERM_CMDLINE_OPTION_LEN; *digit >= '0' && *digit <= '9'; digit++) {
+            count = count * 10 + (*digit - '0');
+            // anything this big gets clamped anyways
+            if(count > MAX_TERMINALS)
+                return MAX_TERMINALS;
+        }
+        return (count > 0) ? count : DEFAULT_NUM_TERMINALS;
+    }
+    return DEFAULT_NUM_TERMINALS;
+}
+
+/* uint8_t multi_term_init(uint8_t count)
+ * Inputs: count - how many terminals we want
+ * Return Value: how many terminals were actually set up
+ * Each terminal needs a root shell pid, a terminal_t from its cache and a video memory
+ * backup page, so we stop early if we run out of either */
+uint8_t multi_term_init(uint8_t count) {
     int term;
-    for (term = 0; term < 3; term++){
+    void* backup;
+
+    kmem_cache_init(&terminal_cache, "terminal", sizeof(terminal_t));
+
+    if(count > MAX_TERMINALS)
+        count = MAX_TERMINALS;
+    for(term = 0; term < count; term++) {
+        terminals[term] = (terminal_t *) kmem_cache_alloc(&terminal_cache);
+        if(terminals[term] == NULL)
+            break;
+        backup = page_pool_alloc(TERM_BACKUP_SIZE / PG_BASE_SIZE);
+        if(backup == NULL) {
+            kmem_cache_free(&terminal_cache, terminals[term]);
+            terminals[term] = NULL;
+            break;
+        }
+        memset(terminals[term], 0, sizeof(terminal_t));
+        work_init(&terminals[term]->history_work, terminal_history_sync, term);
+        mutex_init(&terminals[term]->write_mutex);
+        virtual_terminal_addresses[term] = (uint32_t) backup;
+        physical_terminal_addresses[term] = (uint32_t) backup;
+    }
+    num_terminals = term;
+
+    // for each term, call terminal init
+    for (term = 0; term < num_terminals; term++){
         current_term = term;
         terminal_init();
     }
     // default term to terminal 1
     current_term = 0; 
+    return num_terminals;
 }
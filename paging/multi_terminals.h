@@ -2,20 +2,26 @@
 #define _MULTI_TERMINALS_H
 
 #include "page_structs.h"
+#include "page_pool.h"
+#include "kmalloc.h"
 #include "../devices/terminal_structs.h"
 #include "../devices/terminal.h"
 #include "../interrupts/syscalls.h"
 
 #define VISUAL_VIRTUAL_ADDR 0xB8000
-#define TERM_1_PHYSICAL_BACKUP 0xB9000
-#define TERM_2_PHYSICAL_BACKUP 0xBA000
-#define TERM_3_PHYSICAL_BACKUP 0xBB000
-#define TERM_1_VIRTUAL_BACKUP 0xB9000
-#define TERM_2_VIRTUAL_BACKUP 0xBA000
-#define TERM_3_VIRTUAL_BACKUP 0xBB000
+// size of a terminal's video memory backup
+#define TERM_BACKUP_SIZE PG_BASE_SIZE
 
-extern uint32_t virtual_terminal_addresses[3];
-extern uint32_t physical_terminal_addresses[3];
+// boot command line option for the number of terminals, e.g. "terminals=6"
+#define TERM_CMDLINE_OPTION "terminals="
+#define TERM_CMDLINE_OPTION_LEN 10
 
-void three_term_init(); 
+extern uint32_t virtual_terminal_addresses[MAX_TERMINALS];
+extern uint32_t physical_terminal_addresses[MAX_TERMINALS];
+
+/* reads the terminal count from the boot command line, DEFAULT_NUM_TERMINALS if it isn't there */
+uint8_t multi_term_parse_cmdline(const int8_t* cmdline);
+
+/* allocates and initializes count terminals, returns how many were brought up */
+uint8_t multi_term_init(uint8_t count);
 #endif 
@@ -0,0 +1,103 @@
+#include "page_pool.h"
+#include "../spinlock.h"
+
+// one bit per 4kB page of the kernel's 4MB page, set = in use
+static uint32_t page_pool_bitmap[PAGE_POOL_BITMAP_WORDS];
+static uint32_t page_pool_available;
+// every processor allocates kernel stacks and page tables from here
+static spinlock_t page_pool_lock = SPINLOCK_INIT;
+
+#define PAGE_IDX(addr) (((uint32_t) (addr) - KERNEL_MEM_START) / PG_BASE_SIZE)
+#define PAGE_ADDR(idx) (KERNEL_MEM_START + (idx) * PG_BASE_SIZE)
+#define PAGE_USED(idx) (page_pool_bitmap[(idx) >> 5] & (1 << ((idx) & 0x1F)))
+
+/*
+ * page_pool_init
+ * Inputs: reserved_end - first address after the kernel image and boot modules
+ * Return Value: None
+ * Side Effects: everything below reserved_end and the boot stack are never handed out
+ */
+void page_pool_init(uint32_t reserved_end) {
+    uint32_t idx;
+    uint32_t first_free = PAGE_IDX(reserved_end + PG_BASE_SIZE - 1);
+    uint32_t boot_stack = PAGE_IDX(KERNEL_MEM_END - BOOT_STACK_SIZE);
+
+    page_pool_available = 0;
+    for(idx = 0; idx < PAGE_POOL_NUM_PAGES; idx++) {
+        if(idx < first_free || idx >= boot_stack) {
+            page_pool_bitmap[idx >> 5] |= (1 << (idx & 0x1F));
+        } else {
+            page_pool_bitmap[idx >> 5] &= ~(1 << (idx & 0x1F));
+            page_pool_available++;
+        }
+    }
+}
+
+/*
+ * page_pool_alloc
+ * Inputs: num_pages - how many contiguous 4kB pages are needed
+ * Return Value: address of the first page, or NULL if no run is long enough
+ * Side Effects: marks the pages as used. Searches from the top down, away from
+ *               the kernel image.
+ */
+void* page_pool_alloc(uint32_t num_pages) {
+    int32_t idx;
+    uint32_t run = 0;
+    uint32_t flags;
+
+    spin_lock_irqsave(&page_pool_lock, flags);
+    if(num_pages == 0 || num_pages > page_pool_available) {
+        spin_unlock_irqrestore(&page_pool_lock, flags);
+        return NULL;
+    }
+
+    for(idx = PAGE_POOL_NUM_PAGES - 1; idx >= 0; idx--) {
+        if(PAGE_USED(idx)) {
+            run = 0;
+            continue;
+        }
+        if(++run == num_pages) {
+            uint32_t i;
+            for(i = idx; i < idx + num_pages; i++)
+                page_pool_bitmap[i >> 5] |= (1 << (i & 0x1F));
+            page_pool_available -= num_pages;
+            spin_unlock_irqrestore(&page_pool_lock, flags);
+            return (void *) PAGE_ADDR(idx);
+        }
+    }
+    spin_unlock_irqrestore(&page_pool_lock, flags);
+    return NULL;
+}
+
+/*
+ * page_pool_free
+ * Inputs: addr - address returned by page_pool_alloc
+ *         num_pages - the same count that was allocated
+ * Return Value: None
+ * Side Effects: pages may be handed out again immediately
+ */
+void page_pool_free(void* addr, uint32_t num_pages) {
+    uint32_t idx;
+    uint32_t first = PAGE_IDX(addr);
+    uint32_t flags;
+
+    if((uint32_t) addr < KERNEL_MEM_START || first + num_pages > PAGE_POOL_NUM_PAGES)
+        return;
+
+    spin_lock_irqsave(&page_pool_lock, flags);
+    for(idx = first; idx < first + num_pages; idx++) {
+        if(PAGE_USED(idx)) {
+            page_pool_bitmap[idx >> 5] &= ~(1 << (idx & 0x1F));
+            page_pool_available++;
+        }
+    }
+    spin_unlock_irqrestore(&page_pool_lock, flags);
+}
+
+/*
+ * page_pool_free_pages
+ * Return Value: number of 4kB pages that are still free
+ */
+uint32_t page_pool_free_pages() {
+    return page_pool_available;
+}
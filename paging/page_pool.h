@@ -0,0 +1,35 @@
+/** page_pool.h - allocator for 4kB pages inside the kernel's 4MB page
+ *
+ *  Everything between the end of the kernel image (and any boot modules)
+ *  and KERNEL_MEM_END is identity mapped, so pages handed out here are
+ *  directly usable by the kernel and can also be mapped into user space.
+ */
+
+#ifndef _PAGE_POOL_H
+#define _PAGE_POOL_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "page_structs.h"
+
+#define PAGE_POOL_NUM_PAGES ((KERNEL_MEM_END - KERNEL_MEM_START) / PG_BASE_SIZE)
+#define PAGE_POOL_BITMAP_WORDS (PAGE_POOL_NUM_PAGES / 32)
+// boot.S starts the kernel on a stack right below KERNEL_MEM_END, it becomes the idle thread
+#define BOOT_STACK_SIZE 0x2000
+
+/* marks every page from the start of the kernel up to reserved_end as in use */
+extern void page_pool_init(uint32_t reserved_end);
+
+/* returns num_pages contiguous 4kB pages, highest free addresses first, or NULL */
+extern void* page_pool_alloc(uint32_t num_pages);
+
+/* gives back pages returned by page_pool_alloc */
+extern void page_pool_free(void* addr, uint32_t num_pages);
+
+/* number of pages currently available */
+extern uint32_t page_pool_free_pages(void);
+
+#endif /* ASM */
+
+#endif /* _PAGE_POOL_H */
@@ -1,4 +1,7 @@
 #include "page_structs.h"
+#include "page_pool.h"
+#include "tlb.h"
+#include "../lib.h"
 
 /*
  * Initialize the values of the page directory and page table we 
@@ -39,19 +42,47 @@ void init_page_structs() {
     // Create a page table entry for video memory (located from 0xB8000 - 0xB9000 in virtual memory)
     // 4 KB page, r/w with supervisor privs
     // rshift 12 bits b/c page base address is represented by top 20 bits
-    page_table[addr] = (VIDEO_MEM_FULL_ADDR) | RW_SUPERVISOR_PRESENT_MASK;  // Default to video mem page corresponding to terminal 1
-
-    // Create page table entries for video memory buffers (located from 0xB9000-0xBC000 in virtual memory)
-    // Used to support 3 separate terminals
-    for (i = 1; i <= 3; i++) {
-        // Backups are contiguous 4 KB memory pages, use 4 KB offset based on current index
-        // Physical memory is contiguous from 0xB9000 - 0xBC000
-        page_table[addr + i] = (VIDEO_MEM_FULL_ADDR + i * 0x1000) | RW_SUPERVISOR_PRESENT_MASK;
-    }
+    page_table[addr] = (VIDEO_MEM_FULL_ADDR) | RW_SUPERVISOR_PRESENT_MASK | PAGE_GLOBAL_MASK;  // Default to video mem page corresponding to terminal 1
+
+    // Terminal backups are allocated from the page pool, see multi_terminals.c
 
     // flush TLB
-	asm volatile ("movl %cr3,%eax; movl %eax,%cr3");
+    tlb_flush_all(TLB_REASON_BOOT);
     
     /* End Page Table Initialization */
 }
 
+/*
+ * Allocates a page directory and copies the kernel's entries into it. The
+ * 0-4MB page table is shared by pointer, so later changes to it show up in
+ * every directory. Everything above the kernel is left absent for the caller.
+ */
+uint32_t* page_dir_create() {
+    uint32_t* dir = (uint32_t *) page_pool_alloc(1);
+    if(dir == NULL)
+        return NULL;
+
+    memcpy(dir, page_directory, PG_BASE_SIZE);
+    return dir;
+}
+
+/*
+ * Frees a directory from page_dir_create.
+ */
+void page_dir_destroy(uint32_t* dir) {
+    page_pool_free(dir, 1);
+}
+
+/*
+ * Switches address space. Pool pages are identity mapped, so the directory's
+ * address is also its physical address. Global kernel pages stay in the TLB.
+ */
+int32_t page_dir_load(uint32_t* dir) {
+    uint32_t cr3;
+
+    asm volatile ("movl %%cr3, %0" : "=r" (cr3));
+    if(cr3 == (uint32_t) dir)
+        return 0;
+    tlb_load_cr3((uint32_t) dir, TLB_REASON_SWITCH);
+    return 1;
+}
@@ -12,9 +12,20 @@
 // Bits that mark the named flags as enabled
 #define RW_SUPERVISOR_PRESENT_MASK 0x00000003
 #define RW_SUPERVISOR_ABSENT_MASK  0x00000002
+#define PAGE_PRESENT_MASK          0x00000001
+#define PAGE_RW_MASK               0x00000002
+// set by the processor whenever the page is used, swap clears it to find cold pages
+#define PAGE_ACCESSED_MASK         0x00000020
+// kernel mappings are the same in every page directory, so they can survive a CR3 load
+#define PAGE_GLOBAL_MASK           0x00000100
 #define RW_USER_PRESENT_4MB_MASK   0x00000087
+// global 4MB page with caching off (PCD and PWT), for memory mapped device registers
+#define RW_SUPERVISOR_UNCACHED_4MB_MASK 0x0000019B
+#define FOUR_MB_PAGE_MASK 0xFFC00000
+#define PAGE_DIR_SHIFT 22
 //vidmap magic number
 #define USER_READ_WRITE_PRESENT_ENABLE 7 //represents 0b111, enables user, read/write, and present bits
+#define USER_READ_ONLY_PRESENT_ENABLE 5 //represents 0b101, user and present but no writes
 
 #define FIVE_MSB 0xFFFFF000
 #define EMPTY_ENTRY 0x00000000
@@ -31,11 +42,18 @@
 
 #ifndef ASM
 
+// kernel only mappings, loaded while a processor idles or runs a kernel thread
 uint32_t page_directory[PG_ENTRIES] __attribute__ ((aligned (PG_BASE_SIZE)));
 uint32_t page_table[PG_ENTRIES] __attribute__ ((aligned (PG_BASE_SIZE)));
-uint32_t page_table_vid[PG_ENTRIES]  __attribute__((aligned(PG_BASE_SIZE)));
 void init_page_structs(void);
 
+/* new page directory holding just the kernel mappings, or NULL */
+uint32_t* page_dir_create(void);
+/* gives back a directory from page_dir_create, it must not be loaded anywhere */
+void page_dir_destroy(uint32_t* dir);
+/* loads dir into CR3 unless it is already there, returns 1 if it loaded it */
+int32_t page_dir_load(uint32_t* dir);
+
 #endif /* ASM */
 
 #endif /* _PAGE_STRUCTS_H */
@@ -0,0 +1,154 @@
+#include "shm.h"
+#include "frame_alloc.h"
+#include "kmalloc.h"
+#include "../spinlock.h"
+#include "../interrupts/syscalls.h"
+
+static shm_segment_t segments[SHM_MAX_SEGMENTS];
+// guards segments[], a segment's frames don't change while anyone has it attached
+static spinlock_t shm_lock = SPINLOCK_INIT;
+
+#define SHM_SEGMENT_ADDR(id) (USER_SHM_START + (id) * SHM_SEGMENT_MAX_SIZE)
+
+/* void shm_segment_free(shm_segment_t* segment)
+ * Inputs: segment - segment nobody has attached, shm_lock held
+ * Return Value: None
+ * Frames some process still maps stay around until it unmaps them */
+static void shm_segment_free(shm_segment_t* segment) {
+    uint32_t i;
+
+    for(i = 0; i < segment->pages; i++)
+        frame_free(segment->frames[i]);
+    kfree(segment->frames);
+    segment->frames = NULL;
+    segment->used = 0;
+}
+
+/* int32_t shm_get(int32_t key, uint32_t size)
+ * Inputs: key - name the processes sharing the segment agree on
+ *         size - bytes a new segment gets, at most SHM_SEGMENT_MAX_SIZE
+ * Return Value: id of the segment, -1 if an existing one is smaller than size,
+ *               the table is full or we are out of memory
+ * A new segment nobody attaches stays until someone attaches and detaches it */
+int32_t shm_get(int32_t key, uint32_t size) {
+    shm_segment_t* segment = NULL;
+    int32_t id;
+    uint32_t flags;
+
+    if(size == 0 || size > SHM_SEGMENT_MAX_SIZE)
+        return -1;
+
+    spin_lock_irqsave(&shm_lock, flags);
+    for(id = 0; id < SHM_MAX_SEGMENTS; id++) {
+        if(segments[id].used && segments[id].key == key) {
+            spin_unlock_irqrestore(&shm_lock, flags);
+            return (size <= segments[id].pages * PG_BASE_SIZE) ? id : -1;
+        }
+        if(!segments[id].used && segment == NULL)
+            segment = &segments[id];
+    }
+    if(segment == NULL) {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+
+    segment->key = key;
+    segment->attached = 0;
+    segment->frames = (uint32_t *) kmalloc(((size + PG_BASE_SIZE - 1) / PG_BASE_SIZE) * sizeof(uint32_t));
+    if(segment->frames == NULL) {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+    for(segment->pages = 0; segment->pages * PG_BASE_SIZE < size; segment->pages++) {
+        segment->frames[segment->pages] = frame_alloc_zeroed();
+        if(segment->frames[segment->pages] == FRAME_NONE) {
+            shm_segment_free(segment);
+            spin_unlock_irqrestore(&shm_lock, flags);
+            return -1;
+        }
+    }
+    segment->used = 1;
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return segment - segments;
+}
+
+/* int32_t shm_attach(PCB_BLOCK_t* leader, int32_t id)
+ * Inputs: leader - process to map the segment into
+ *         id - from shm_get
+ * Return Value: user address of the segment, which is the same in every
+ *               process, -1 if there is no such segment or we are out of memory
+ * Attaching a segment twice just hands back where it already is */
+int32_t shm_attach(PCB_BLOCK_t* leader, int32_t id) {
+    shm_segment_t* segment;
+    uint32_t i;
+    uint32_t flags;
+
+    if(id < 0 || id >= SHM_MAX_SEGMENTS)
+        return -1;
+    segment = &segments[id];
+
+    spin_lock_irqsave(&shm_lock, flags);
+    if(!segment->used) {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+    if(leader->shm_attached & (1 << id)) {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return SHM_SEGMENT_ADDR(id);
+    }
+    segment->attached++;
+    leader->shm_attached |= (1 << id);
+    spin_unlock_irqrestore(&shm_lock, flags);
+
+    for(i = 0; i < segment->pages; i++) {
+        if(user_mem_map_frame(leader, SHM_SEGMENT_ADDR(id) + i * PG_BASE_SIZE, segment->frames[i]) != 0) {
+            shm_detach(leader, id);
+            return -1;
+        }
+    }
+    return SHM_SEGMENT_ADDR(id);
+}
+
+/* int32_t shm_detach(PCB_BLOCK_t* leader, int32_t id)
+ * Inputs: leader - process to unmap the segment from, without threads on other processors
+ *         id - segment it attached
+ * Return Value: 0, -1 if leader doesn't have it attached
+ * The last process to detach frees the segment */
+int32_t shm_detach(PCB_BLOCK_t* leader, int32_t id) {
+    shm_segment_t* segment;
+    uint32_t i;
+    uint32_t flags;
+
+    if(id < 0 || id >= SHM_MAX_SEGMENTS)
+        return -1;
+    segment = &segments[id];
+
+    spin_lock_irqsave(&shm_lock, flags);
+    if(!(leader->shm_attached & (1 << id))) {
+        spin_unlock_irqrestore(&shm_lock, flags);
+        return -1;
+    }
+    leader->shm_attached &= ~(1 << id);
+    spin_unlock_irqrestore(&shm_lock, flags);
+
+    for(i = 0; i < segment->pages; i++)
+        user_mem_unmap(leader, SHM_SEGMENT_ADDR(id) + i * PG_BASE_SIZE);
+
+    spin_lock_irqsave(&shm_lock, flags);
+    if(--segment->attached == 0)
+        shm_segment_free(segment);
+    spin_unlock_irqrestore(&shm_lock, flags);
+    return 0;
+}
+
+/* void shm_detach_all(PCB_BLOCK_t* leader)
+ * Inputs: leader - process going away
+ * Return Value: None */
+void shm_detach_all(PCB_BLOCK_t* leader) {
+    int32_t id;
+
+    for(id = 0; id < SHM_MAX_SEGMENTS; id++) {
+        if(leader->shm_attached & (1 << id))
+            shm_detach(leader, id);
+    }
+}
@@ -0,0 +1,49 @@
+/** shm.h - shared memory segments between processes
+ *
+ *  A segment is a set of zeroed 4kB frames looked up by a key. Every process
+ *  that attaches it gets the same frames mapped, so whatever one writes the
+ *  others see without a copy. Segment id i is always attached at the same
+ *  address, USER_SHM_START + i * SHM_SEGMENT_MAX_SIZE, so pointers into it
+ *  mean the same thing in every process. A segment goes away when the last
+ *  process that attached it detaches or exits.
+ */
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "user_mem.h"
+
+// segments that can exist at once, each gets its own slot of the shm region
+#define SHM_MAX_SEGMENTS     16
+#define SHM_SEGMENT_MAX_SIZE ((USER_SHM_END - USER_SHM_START) / SHM_MAX_SEGMENTS)
+
+struct PCB_BLOCK_t;
+
+typedef struct shm_segment {
+    int32_t key;
+    uint32_t pages;
+    // pages frames from frame_alloc, the segment holds one reference to each
+    uint32_t* frames;
+    // processes that have it attached
+    uint32_t attached;
+    uint8_t used;
+} shm_segment_t;
+
+/* id of the segment with key, made with size bytes if there is none yet, -1 on failure */
+extern int32_t shm_get(int32_t key, uint32_t size);
+
+/* maps segment id into leader, returns the user address it is at or -1 */
+extern int32_t shm_attach(struct PCB_BLOCK_t* leader, int32_t id);
+
+/* unmaps segment id from leader, 0 or -1 if it wasn't attached */
+extern int32_t shm_detach(struct PCB_BLOCK_t* leader, int32_t id);
+
+/* detaches every segment leader still has */
+extern void shm_detach_all(struct PCB_BLOCK_t* leader);
+
+#endif /* ASM */
+
+#endif /* _SHM_H */
@@ -0,0 +1,265 @@
+#include "swap.h"
+#include "page_pool.h"
+#include "frame_alloc.h"
+#include "user_mem.h"
+#include "../spinlock.h"
+#include "../lib.h"
+#include "../interrupts/syscalls.h"
+#include "../scheduler/scheduler.h"
+#include "../scheduler/kthread.h"
+
+// page table entries holding each slot, 0 if it is free
+static uint16_t slot_refs[SWAP_MAX_SLOTS];
+static uint32_t slot_cursor;
+static swap_stats_t swap_stats;
+// guards the slots and the disk. Nothing else is taken under it, so it can be
+// taken under sched_lock and mm_lock, and from a fault where the kernel holds a spinlock
+static spinlock_t swap_lock = SPINLOCK_INIT;
+
+// page on its way to disk, and the slot it goes to. Reads of that slot are
+// served from here until the write is done
+static uint8_t* out_buffer;
+static uint32_t pending_slot = SWAP_SLOT_NONE;
+// where reads from the disk land before they are copied into a frame
+static uint8_t* in_buffer;
+// set once a write failed, the page that didn't make it stays in out_buffer for good
+static uint8_t swap_failed;
+
+// kswapd sleeps here between scans
+static wait_queue_t swap_wait;
+static int32_t kswapd_pid = -1;
+// clock hand, the process and the user address it points at
+static uint8_t hand_pid;
+static uint32_t hand_addr = PROCESS_VIRTUAL_ADDRESS_START;
+
+/* uint32_t swap_slot_alloc()
+ * Inputs: None
+ * Return Value: a slot with one reference, SWAP_SLOT_NONE if there is none */
+uint32_t swap_slot_alloc() {
+    uint32_t slot = SWAP_SLOT_NONE;
+    uint32_t i;
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    for(i = 0; i < swap_stats.slots && swap_stats.slots_used < swap_stats.slots; i++) {
+        if(++slot_cursor >= swap_stats.slots)
+            slot_cursor = 0;
+        if(slot_refs[slot_cursor] == 0) {
+            slot = slot_cursor;
+            slot_refs[slot] = 1;
+            swap_stats.slots_used++;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&swap_lock, flags);
+    return slot;
+}
+
+/* int32_t swap_slot_ref(uint32_t slot)
+ * Inputs: slot - from swap_slot_alloc
+ * Return Value: 0, -1 if SWAP_MAX_REFS entries already hold it
+ * For fork, which copies swapped out entries like present ones, and fails
+ * the same way frame_ref makes it fail once a count is full */
+int32_t swap_slot_ref(uint32_t slot) {
+    int32_t ret = -1;
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    if(slot_refs[slot] != 0 && slot_refs[slot] != SWAP_MAX_REFS) {
+        slot_refs[slot]++;
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&swap_lock, flags);
+    return ret;
+}
+
+/* void swap_slot_free(uint32_t slot)
+ * Inputs: slot - from swap_slot_alloc
+ * Return Value: None */
+void swap_slot_free(uint32_t slot) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    if(slot_refs[slot] != 0 && --slot_refs[slot] == 0)
+        swap_stats.slots_used--;
+    spin_unlock_irqrestore(&swap_lock, flags);
+}
+
+/* int32_t swap_read(uint32_t slot, uint32_t frame)
+ * Inputs: slot - slot a page table entry holds
+ *         frame - frame to fill
+ * Return Value: 0, -1 if the disk failed us
+ * Polls the disk with interrupts off, a page fault can't know whether it is
+ * allowed to sleep */
+int32_t swap_read(uint32_t slot, uint32_t frame) {
+    int32_t ret = 0;
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    if(slot == pending_slot) {
+        frame_copy(frame, (uint32_t) out_buffer);
+    } else {
+        ret = ata_read(SWAP_DRIVE, SWAP_SLOT_LBA(slot), SWAP_SECTORS_PER_SLOT, in_buffer);
+        // pool pages are identity mapped
+        if(ret == 0)
+            frame_copy(frame, (uint32_t) in_buffer);
+    }
+    if(ret == 0)
+        swap_stats.pages_in++;
+    spin_unlock_irqrestore(&swap_lock, flags);
+    return ret;
+}
+
+/* int32_t swap_evict_locked(PCB_BLOCK_t* leader, uint32_t* hand)
+ * Inputs: leader - process that can't run while we hold sched_lock
+ *         hand - where the clock hand is in its user memory
+ * Return Value: 0 if a page is on its way out, 1 once the hand went past the
+ *               last page, -1 if there is no slot or a write is still pending
+ * The page's frame is free once we return, swap_write_pending puts it on disk */
+int32_t swap_evict_locked(PCB_BLOCK_t* leader, uint32_t* hand) {
+    uint32_t slot;
+    int32_t ret;
+
+    if(pending_slot != SWAP_SLOT_NONE)
+        return -1;
+    ret = user_mem_evict(leader, hand, (uint32_t) out_buffer, &slot);
+    if(ret == 0) {
+        spin_lock(&swap_lock);
+        pending_slot = slot;
+        spin_unlock(&swap_lock);
+    }
+    return ret;
+}
+
+/* void swap_write_pending()
+ * Inputs: None
+ * Return Value: None
+ * Nothing to do if no page is on its way out */
+void swap_write_pending() {
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    if(pending_slot != SWAP_SLOT_NONE) {
+        if(ata_write(SWAP_DRIVE, SWAP_SLOT_LBA(pending_slot), SWAP_SECTORS_PER_SLOT, out_buffer) == 0) {
+            pending_slot = SWAP_SLOT_NONE;
+            swap_stats.pages_out++;
+        } else {
+            swap_stats.write_errors++;
+            swap_failed = 1;
+        }
+    }
+    spin_unlock_irqrestore(&swap_lock, flags);
+}
+
+/* uint8_t swap_victim(PCB_BLOCK_t* process)
+ * Inputs: process - PCB[] entry, can be NULL
+ * Return Value: 1 if its user memory can be swapped out, sched_lock held
+ * Only leaders without threads that have been blocked for a long time, whose
+ * directory no processor has loaded */
+static uint8_t swap_victim(PCB_BLOCK_t* process) {
+    return process != NULL && process->leader == process && process->page_directory != NULL &&
+           process->state == PROCESS_BLOCKED && process->thread_count == 0 && process->cpu != NO_CPU &&
+           cpus[process->cpu].ticks - process->last_ran >= SWAP_IDLE_TICKS;
+}
+
+/* int32_t swap_out_one()
+ * Inputs: None
+ * Return Value: 0 if a page was swapped out, -1 if nothing could be
+ * Moves the clock hand on to the next process whenever it gets to the end of one */
+static int32_t swap_out_one() {
+    uint32_t tries;
+    int32_t ret = 1;
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    for(tries = 0; tries <= process_table_size && ret == 1; tries++) {
+        if(swap_victim(PCB[hand_pid]))
+            ret = swap_evict_locked(PCB[hand_pid], &hand_addr);
+        if(ret == 1) {
+            hand_pid = (hand_pid + 1) % process_table_size;
+            hand_addr = PROCESS_VIRTUAL_ADDRESS_START;
+        }
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    if(ret != 0)
+        return -1;
+
+    swap_write_pending();
+    return 0;
+}
+
+/* void kswapd(uint32_t arg)
+ * Inputs: arg - unused
+ * Return Value: None, never returns
+ * Swaps out up to SWAP_BATCH_PAGES pages every time swap_tick_locked wakes it */
+static void kswapd(uint32_t arg) {
+    uint32_t i;
+    uint32_t flags;
+
+    while(1) {
+        spin_lock_irqsave(&sched_lock, flags);
+        sleep_on(&swap_wait);
+        spin_unlock_irqrestore(&sched_lock, flags);
+
+        for(i = 0; i < SWAP_BATCH_PAGES && !swap_failed; i++) {
+            if(swap_out_one() != 0)
+                break;
+        }
+    }
+}
+
+/* void swap_tick_locked(uint32_t ticks)
+ * Inputs: ticks - the processor's tick count
+ * Return Value: None */
+void swap_tick_locked(uint32_t ticks) {
+    if(kswapd_pid >= 0 && ticks % SWAP_SCAN_TICKS == 0)
+        wake_up_locked(&swap_wait);
+}
+
+/* int32_t swap_init()
+ * Inputs: None
+ * Return Value: 0 if swap is on, -1 if there is no swap disk or no memory for it
+ * Must run after scheduler_init. Any disk on the slave channel answers
+ * IDENTIFY, only one whose first sector has SWAP_MAGIC was set aside for us */
+int32_t swap_init() {
+    uint32_t sectors = ata_identify(SWAP_DRIVE);
+    uint32_t slots = sectors / SWAP_SECTORS_PER_SLOT;
+
+    // the first slot is the header
+    if(slots <= 1)
+        return -1;
+    slots--;
+    if(slots > SWAP_MAX_SLOTS)
+        slots = SWAP_MAX_SLOTS;
+
+    in_buffer = (uint8_t *) page_pool_alloc(1);
+    if(in_buffer == NULL)
+        return -1;
+    if(ata_read(SWAP_DRIVE, 0, 1, in_buffer) != 0 ||
+       strncmp((int8_t *) in_buffer, (int8_t *) SWAP_MAGIC, SWAP_MAGIC_LEN) != 0) {
+        printf("swap: disk has no %s header, not using it\n", SWAP_MAGIC);
+        page_pool_free(in_buffer, 1);
+        in_buffer = NULL;
+        return -1;
+    }
+
+    out_buffer = (uint8_t *) page_pool_alloc(1);
+    wait_queue_init(&swap_wait);
+    if(out_buffer != NULL)
+        kswapd_pid = kthread_create(kswapd, 0, (int8_t *) "kswapd");
+    if(kswapd_pid < 0)
+        return -1;
+    swap_stats.slots = slots;
+    return 0;
+}
+
+/* void swap_get_stats(swap_stats_t* stats)
+ * Inputs: stats - where to copy the counters
+ * Return Value: None */
+void swap_get_stats(swap_stats_t* stats) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&swap_lock, flags);
+    *stats = swap_stats;
+    spin_unlock_irqrestore(&swap_lock, flags);
+}
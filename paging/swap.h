@@ -0,0 +1,92 @@
+/** swap.h - paging idle processes' user memory out to disk
+ *
+ *  The swap area is a whole ATA disk, the slave on the primary channel,
+ *  cut into 4kB slots. The disk is only used if its first sector starts
+ *  with SWAP_MAGIC, so a data disk left on that channel isn't overwritten.
+ *  Make one with
+ *      dd if=/dev/zero of=swap.img bs=1M count=64
+ *      printf 'SWAPSPACE391' | dd of=swap.img conv=notrunc
+ *  and boot with -hdb swap.img. The first slot holds that header, pages go
+ *  in the ones after it. Every SWAP_SCAN_TICKS the kswapd thread walks the
+ *  user pages of processes that have been blocked for SWAP_IDLE_TICKS with
+ *  a clock hand. A page whose accessed bit is set gets it cleared and a
+ *  second chance, one that is still clear the next time around is written
+ *  to a slot and its frame freed. The page table entry then holds the slot,
+ *  and the next touch faults it back in through user_mem_fault.
+ */
+
+#ifndef _SWAP_H
+#define _SWAP_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../devices/ata.h"
+#include "page_structs.h"
+
+#define SWAP_DRIVE              ATA_DRIVE_SLAVE
+#define SWAP_SECTORS_PER_SLOT   (PG_BASE_SIZE / ATA_SECTOR_SIZE)
+// what the first sector of a swap disk has to start with
+#define SWAP_MAGIC              "SWAPSPACE391"
+#define SWAP_MAGIC_LEN          12
+// first sector of a slot, the header slot comes before slot 0
+#define SWAP_SLOT_LBA(slot)     (((slot) + 1) * SWAP_SECTORS_PER_SLOT)
+// most slots we keep track of, 64MB of swap
+#define SWAP_MAX_SLOTS          16384
+// most page table entries that can share one slot
+#define SWAP_MAX_REFS           0xFFFF
+#define SWAP_SLOT_NONE          0xFFFFFFFF
+
+// a not present user page table entry with this bit set holds a slot in its frame bits
+#define SWAP_PTE_MASK           0x00000200
+#define SWAP_PTE(slot)          (((slot) << THREE_BYTE_SIZE) | SWAP_PTE_MASK)
+#define SWAP_PTE_SLOT(pte)      ((pte) >> THREE_BYTE_SIZE)
+
+// how often kswapd looks for pages, and how long a process has to be blocked first
+#define SWAP_SCAN_TICKS         100
+#define SWAP_IDLE_TICKS         6000
+// most pages kswapd writes out each time it wakes
+#define SWAP_BATCH_PAGES        32
+
+typedef struct swap_stats {
+    uint32_t slots;
+    uint32_t slots_used;
+    uint32_t pages_out;
+    uint32_t pages_in;
+    uint32_t write_errors;
+} swap_stats_t;
+
+struct PCB_BLOCK_t;
+
+/* looks for the swap disk and starts kswapd, 0 if swap is on, -1 if there is no disk
+ * or it doesn't have the swap header */
+extern int32_t swap_init();
+
+/* a free slot with one reference, SWAP_SLOT_NONE if swap is full or off */
+extern uint32_t swap_slot_alloc();
+
+/* another page table entry holds slot, 0 or -1 if its count is full */
+extern int32_t swap_slot_ref(uint32_t slot);
+
+/* drops a reference to slot, it is free once none are left */
+extern void swap_slot_free(uint32_t slot);
+
+/* copies the page in slot into frame, 0 or -1 */
+extern int32_t swap_read(uint32_t slot, uint32_t frame);
+
+/* pages out one cold page of leader from *hand on, sched_lock held. 0 if it did,
+ * 1 once the hand went past its last page, -1 if swap is full */
+extern int32_t swap_evict_locked(struct PCB_BLOCK_t* leader, uint32_t* hand);
+
+/* writes the page swap_evict_locked took to disk */
+extern void swap_write_pending();
+
+/* called on every scheduler tick of the first processor with sched_lock held */
+extern void swap_tick_locked(uint32_t ticks);
+
+/* copies the swap counters */
+extern void swap_get_stats(swap_stats_t* stats);
+
+#endif /* ASM */
+
+#endif /* _SWAP_H */
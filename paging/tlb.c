@@ -0,0 +1,69 @@
+#include "tlb.h"
+#include "page_structs.h"
+#include "../lib.h"
+
+// every processor bumps these, so they are only touched with lock incl
+static tlb_stats_t tlb_stats;
+
+/* void tlb_count(uint32_t* counter)
+ * Inputs: counter - counter to bump
+ * Return Value: None */
+static void tlb_count(uint32_t* counter) {
+    asm volatile ("lock incl %0" : "+m" (*counter) : : "memory");
+}
+
+/* void tlb_flush_page(uint32_t addr, uint8_t reason)
+ * Inputs: addr - any address in the page whose entry changed
+ *         reason - TLB_REASON_* to count the flush under
+ * Return Value: None
+ * Only drops the translation on this processor */
+void tlb_flush_page(uint32_t addr, uint8_t reason) {
+    asm volatile ("invlpg (%0)" : : "r" (addr) : "memory");
+    tlb_count(&tlb_stats.pages[reason]);
+}
+
+/* void tlb_flush_range(uint32_t start, uint32_t end, uint8_t reason)
+ * Inputs: start, end - virtual range whose entries changed, end exclusive
+ *         reason - TLB_REASON_* to count the flush under
+ * Return Value: None
+ * Falls back to a full flush for long ranges */
+void tlb_flush_range(uint32_t start, uint32_t end, uint8_t reason) {
+    uint32_t addr;
+
+    start &= ~(PG_BASE_SIZE - 1);
+    if(end <= start)
+        return;
+    if((end - start) / PG_BASE_SIZE > TLB_RANGE_MAX_PAGES) {
+        tlb_flush_all(reason);
+        return;
+    }
+    for(addr = start; addr < end; addr += PG_BASE_SIZE)
+        tlb_flush_page(addr, reason);
+}
+
+/* void tlb_flush_all(uint8_t reason)
+ * Inputs: reason - TLB_REASON_* to count the flush under
+ * Return Value: None
+ * Global kernel pages survive this */
+void tlb_flush_all(uint8_t reason) {
+    uint32_t cr3;
+
+    asm volatile ("movl %%cr3, %0" : "=r" (cr3));
+    tlb_load_cr3(cr3, reason);
+}
+
+/* void tlb_load_cr3(uint32_t cr3, uint8_t reason)
+ * Inputs: cr3 - physical address of the page directory to run on
+ *         reason - TLB_REASON_* to count the flush under
+ * Return Value: None */
+void tlb_load_cr3(uint32_t cr3, uint8_t reason) {
+    asm volatile ("movl %0, %%cr3" : : "r" (cr3) : "memory");
+    tlb_count(&tlb_stats.full[reason]);
+}
+
+/* void tlb_get_stats(tlb_stats_t* stats)
+ * Inputs: stats - filled in with the counters
+ * Return Value: None */
+void tlb_get_stats(tlb_stats_t* stats) {
+    memcpy(stats, &tlb_stats, sizeof(tlb_stats_t));
+}
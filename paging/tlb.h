@@ -0,0 +1,60 @@
+/** tlb.h - throwing stale translations out of the TLB
+ *
+ *  Changing a single entry only needs that page dropped with invlpg. Loading
+ *  CR3 drops every translation that isn't global, which switching to another
+ *  address space has to do anyway. Every flush is counted under the reason
+ *  it was done for.
+ */
+
+#ifndef _TLB_H
+#define _TLB_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// why a flush was done, indexes the counters in tlb_stats_t
+#define TLB_REASON_BOOT     0
+// CR3 load to run another address space
+#define TLB_REASON_SWITCH   1
+// a process's vidmap page moved on or off screen
+#define TLB_REASON_VIDMAP   2
+// the trampoline pages below 1MB were mapped or unmapped
+#define TLB_REASON_LOW_MEM  3
+#define TLB_REASON_APIC     4
+// a frame window was pointed at another frame, see frame_zero
+#define TLB_REASON_WINDOW   5
+// user pages were unmapped or had their permissions changed
+#define TLB_REASON_USER_MEM 6
+// fork write protected shared pages, or a write to one got its own copy
+#define TLB_REASON_COW      7
+#define TLB_NUM_REASONS     8
+
+// past this many pages one CR3 load is cheaper than a run of invlpg
+#define TLB_RANGE_MAX_PAGES 32
+
+typedef struct tlb_stats {
+    // pages dropped one at a time with invlpg
+    uint32_t pages[TLB_NUM_REASONS];
+    // CR3 loads, each one drops every non-global translation
+    uint32_t full[TLB_NUM_REASONS];
+} tlb_stats_t;
+
+/* drops the translation of the page holding addr */
+extern void tlb_flush_page(uint32_t addr, uint8_t reason);
+
+/* drops the translations of every page in [start, end) */
+extern void tlb_flush_range(uint32_t start, uint32_t end, uint8_t reason);
+
+/* drops every non-global translation by reloading CR3 */
+extern void tlb_flush_all(uint8_t reason);
+
+/* loads a new page directory, which flushes like tlb_flush_all */
+extern void tlb_load_cr3(uint32_t cr3, uint8_t reason);
+
+/* copies the flush counters, summed over all processors */
+extern void tlb_get_stats(tlb_stats_t* stats);
+
+#endif /* ASM */
+
+#endif /* _TLB_H */
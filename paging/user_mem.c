@@ -0,0 +1,505 @@
+#include "user_mem.h"
+#include "frame_alloc.h"
+#include "page_pool.h"
+#include "tlb.h"
+#include "swap.h"
+#include "../interrupts/syscalls.h"
+
+#define PAGE_ALIGN_DOWN(addr) ((addr) & ~(PG_BASE_SIZE - 1))
+#define PAGE_ALIGN_UP(addr)   (((addr) + PG_BASE_SIZE - 1) & ~(PG_BASE_SIZE - 1))
+#define PTE_IDX(addr)         (((addr) >> THREE_BYTE_SIZE) & (PG_ENTRIES - 1))
+
+/* uint32_t* user_pte(PCB_BLOCK_t* leader, uint32_t addr, uint8_t create)
+ * Inputs: leader - process whose tables to walk, its mm_lock held
+ *         addr - user address
+ *         create - whether to allocate a missing page table
+ * Return Value: the page table entry for addr, NULL if there is no table for it */
+static uint32_t* user_pte(PCB_BLOCK_t* leader, uint32_t addr, uint8_t create) {
+    uint32_t* pde = &leader->page_directory[addr >> BITSHIFT_PAGE_OFFSET];
+    uint32_t* table;
+
+    if(!(*pde & PAGE_PRESENT_MASK)) {
+        if(!create)
+            return NULL;
+        table = (uint32_t *) page_pool_alloc(1);
+        if(table == NULL)
+            return NULL;
+        memset(table, 0, PG_BASE_SIZE);
+        // pool pages are identity mapped
+        *pde = (uint32_t) table | USER_READ_WRITE_PRESENT_ENABLE;
+    }
+    table = (uint32_t *) (*pde & FIVE_MSB);
+    return &table[PTE_IDX(addr)];
+}
+
+/* int32_t user_map_page(PCB_BLOCK_t* leader, uint32_t addr)
+ * Inputs: leader - process to map the page into
+ *         addr - page aligned user address
+ * Return Value: 0 once the page is mapped, by us or someone who beat us to it, -1 if out of memory
+ * The frame is zeroed before its entry is written, so another thread can never
+ * see what was in it before */
+static int32_t user_map_page(PCB_BLOCK_t* leader, uint32_t addr) {
+    uint32_t frame = frame_alloc_zeroed();
+    uint32_t* pte;
+    uint32_t flags;
+
+    if(frame == FRAME_NONE)
+        return -1;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 1);
+    // a swapped out page is brought back by the fault that retries
+    if(pte == NULL || (*pte & (PAGE_PRESENT_MASK | SWAP_PTE_MASK))) {
+        spin_unlock_irqrestore(&leader->mm_lock, flags);
+        frame_free(frame);
+        return (pte == NULL) ? -1 : 0;
+    }
+    *pte = frame | USER_READ_WRITE_PRESENT_ENABLE;
+    leader->resident_pages++;
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return 0;
+}
+
+/* int32_t user_cow_page(PCB_BLOCK_t* leader, uint32_t addr)
+ * Inputs: leader - process whose directory is loaded
+ *         addr - page aligned user address a write hit read only
+ * Return Value: 0 once the page is writable, -1 if it isn't a shared page or we are out of memory
+ * Whoever still shares the frame keeps it, we take a copy. The last one left
+ * just gets write access back. A page another thread already dealt with is
+ * left as it is */
+static int32_t user_cow_page(PCB_BLOCK_t* leader, uint32_t addr) {
+    uint32_t* pte;
+    uint32_t old, copy;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    if(pte == NULL || !(*pte & PAGE_PRESENT_MASK)) {
+        spin_unlock_irqrestore(&leader->mm_lock, flags);
+        return -1;
+    }
+    if(!(*pte & PAGE_RW_MASK)) {
+        old = *pte & FIVE_MSB;
+        // nobody can take a new reference without our mm_lock, so 1 stays 1
+        if(frame_refcount(old) > 1) {
+            copy = frame_alloc();
+            if(copy == FRAME_NONE) {
+                spin_unlock_irqrestore(&leader->mm_lock, flags);
+                return -1;
+            }
+            frame_copy(copy, old);
+            *pte = copy | USER_READ_WRITE_PRESENT_ENABLE;
+            frame_free(old);
+        } else {
+            *pte |= PAGE_RW_MASK;
+        }
+        tlb_flush_page(addr, TLB_REASON_COW);
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return 0;
+}
+
+/* int32_t user_table_fork(PCB_BLOCK_t* child, PCB_BLOCK_t* parent, uint32_t addr)
+ * Inputs: child - new leader, not running yet
+ *         parent - leader being forked, its mm_lock held
+ *         addr - start of the 4MB the table covers
+ * Return Value: 0, -1 if the page pool is out or a frame or slot is shared too often
+ * Every present entry loses its write bit and is copied into the child's
+ * table, which takes a reference to the frame behind it. Swapped out entries
+ * are copied as they are and share the slot */
+static int32_t user_table_fork(PCB_BLOCK_t* child, PCB_BLOCK_t* parent, uint32_t addr) {
+    uint32_t* table;
+    uint32_t* child_pte;
+    uint32_t i;
+
+    if(!(parent->page_directory[addr >> BITSHIFT_PAGE_OFFSET] & PAGE_PRESENT_MASK))
+        return 0;
+    table = (uint32_t *) (parent->page_directory[addr >> BITSHIFT_PAGE_OFFSET] & FIVE_MSB);
+    for(i = 0; i < PG_ENTRIES; i++) {
+        if(!(table[i] & (PAGE_PRESENT_MASK | SWAP_PTE_MASK)))
+            continue;
+        child_pte = user_pte(child, addr + i * PG_BASE_SIZE, 1);
+        if(child_pte == NULL)
+            return -1;
+        if(!(table[i] & PAGE_PRESENT_MASK)) {
+            if(swap_slot_ref(SWAP_PTE_SLOT(table[i])) != 0)
+                return -1;
+            *child_pte = table[i];
+            continue;
+        }
+        if(frame_ref(table[i] & FIVE_MSB) != 0)
+            return -1;
+        table[i] &= ~PAGE_RW_MASK;
+        *child_pte = table[i];
+        child->resident_pages++;
+    }
+    return 0;
+}
+
+/* void user_table_free(uint32_t* pde)
+ * Inputs: pde - directory entry of a user page table
+ * Return Value: None
+ * Frees every frame and swap slot in the table and then the table */
+static void user_table_free(uint32_t* pde) {
+    uint32_t* table;
+    uint32_t i;
+
+    if(!(*pde & PAGE_PRESENT_MASK))
+        return;
+    table = (uint32_t *) (*pde & FIVE_MSB);
+    for(i = 0; i < PG_ENTRIES; i++) {
+        if(table[i] & PAGE_PRESENT_MASK)
+            frame_free(table[i] & FIVE_MSB);
+        else if(table[i] & SWAP_PTE_MASK)
+            swap_slot_free(SWAP_PTE_SLOT(table[i]));
+    }
+    page_pool_free(table, 1);
+    *pde = EMPTY_ENTRY | RW_SUPERVISOR_ABSENT_MASK;
+}
+
+/* int32_t user_mem_init(PCB_BLOCK_t* leader)
+ * Inputs: leader - new process with its page directory
+ * Return Value: 0, -1 if the page pool is out
+ * Nothing is mapped yet, every page comes in on first touch */
+int32_t user_mem_init(PCB_BLOCK_t* leader) {
+    spin_lock_init(&leader->mm_lock);
+    leader->brk = USER_HEAP_START;
+    leader->resident_pages = 0;
+    return (user_pte(leader, PROCESS_VIRTUAL_ADDRESS_START, 1) == NULL) ? -1 : 0;
+}
+
+/* int32_t user_mem_populate(PCB_BLOCK_t* leader, uint32_t start, uint32_t end)
+ * Inputs: leader - process to map the pages into
+ *         start, end - user range, end exclusive
+ * Return Value: 0, -1 if we ran out of memory part way
+ * For the loader, which writes through a directory that isn't the running
+ * process's, so faults there couldn't be resolved. The frames are reached
+ * through the frame windows, so no directory has to be loaded for this */
+int32_t user_mem_populate(PCB_BLOCK_t* leader, uint32_t start, uint32_t end) {
+    uint32_t addr;
+
+    for(addr = PAGE_ALIGN_DOWN(start); addr < end; addr += PG_BASE_SIZE) {
+        if(user_map_page(leader, addr) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* int32_t user_swap_in(PCB_BLOCK_t* leader, uint32_t addr)
+ * Inputs: leader - process whose directory is loaded
+ *         addr - page aligned user address a not present fault hit
+ * Return Value: 0 once the page is back, 1 if it was never swapped out, -1 if
+ *               we are out of memory or the disk failed
+ * The disk is read without mm_lock, so whoever gets the entry first wins and
+ * the other frame goes back */
+static int32_t user_swap_in(PCB_BLOCK_t* leader, uint32_t addr) {
+    uint32_t* pte;
+    uint32_t entry, frame;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    entry = (pte != NULL) ? *pte : EMPTY_ENTRY;
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    if((entry & PAGE_PRESENT_MASK) || !(entry & SWAP_PTE_MASK))
+        return 1;
+
+    frame = frame_alloc();
+    if(frame == FRAME_NONE)
+        return -1;
+    if(swap_read(SWAP_PTE_SLOT(entry), frame) != 0) {
+        frame_free(frame);
+        return -1;
+    }
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    if(pte != NULL && *pte == entry) {
+        *pte = frame | USER_READ_WRITE_PRESENT_ENABLE;
+        leader->resident_pages++;
+        frame = FRAME_NONE;
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    if(frame != FRAME_NONE) {
+        frame_free(frame);
+        return 0;
+    }
+    swap_slot_free(SWAP_PTE_SLOT(entry));
+    return 0;
+}
+
+/* int32_t user_mem_fault(PCB_BLOCK_t* leader, uint32_t addr, uint32_t error_code)
+ * Inputs: leader - process whose directory is loaded
+ *         addr - faulting address from CR2
+ *         error_code - what the processor pushed
+ * Return Value: 0 if the page is mapped or writable now, -1 if the fault was a real one
+ * Anywhere in the program region is fair game, the heap only below brk. A write
+ * to a present page can only be to one fork shared, the kernel writes to user
+ * memory fault the same way since CR0.WP is on. A page that isn't present may
+ * be out in swap */
+int32_t user_mem_fault(PCB_BLOCK_t* leader, uint32_t addr, uint32_t error_code) {
+    int32_t ret;
+
+    if(!(addr >= PROCESS_VIRTUAL_ADDRESS_START && addr < PROGRAM_IMAGE_END_ADDRESS) &&
+       !(addr >= USER_HEAP_START && addr < USER_HEAP_END))
+        return -1;
+    if(error_code & PAGE_FAULT_PRESENT)
+        return (error_code & PAGE_FAULT_WRITE) ? user_cow_page(leader, PAGE_ALIGN_DOWN(addr)) : -1;
+
+    ret = user_swap_in(leader, PAGE_ALIGN_DOWN(addr));
+    if(ret != 1)
+        return ret;
+    // brk can only have moved up since the faulting access was checked against it
+    if(addr >= USER_HEAP_START && addr >= leader->brk)
+        return -1;
+    return user_map_page(leader, PAGE_ALIGN_DOWN(addr));
+}
+
+/* int32_t user_mem_evict(PCB_BLOCK_t* leader, uint32_t* hand, uint32_t buffer, uint32_t* slot)
+ * Inputs: leader - process whose directory no processor has loaded
+ *         hand - user address the clock hand is at, moved past the pages we looked at
+ *         buffer - physical page the evicted page is copied to
+ *         slot - where to put the swap slot it goes to
+ * Return Value: 0 if a page was evicted, 1 once the hand went past the last
+ *               user page and was put back at the start, -1 if swap is full
+ * Clears accessed bits as it goes, a page that still has it clear the next
+ * time around is cold. Pages shared with anyone else are left alone. Nobody
+ * has the entries in their TLB, so nothing has to be flushed */
+int32_t user_mem_evict(PCB_BLOCK_t* leader, uint32_t* hand, uint32_t buffer, uint32_t* slot) {
+    uint32_t addr = *hand;
+    uint32_t* pte;
+    uint32_t frame;
+    int32_t ret = 1;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    while(addr < USER_HEAP_END && ret == 1) {
+        // the vidmap page isn't ours to swap
+        if(addr >= PROGRAM_IMAGE_END_ADDRESS && addr < USER_HEAP_START)
+            addr = USER_HEAP_START;
+        pte = user_pte(leader, addr, 0);
+        if(pte == NULL) {
+            addr = ((addr >> BITSHIFT_PAGE_OFFSET) + 1) << BITSHIFT_PAGE_OFFSET;
+            continue;
+        }
+        addr += PG_BASE_SIZE;
+        if(!(*pte & PAGE_PRESENT_MASK))
+            continue;
+        if(*pte & PAGE_ACCESSED_MASK) {
+            *pte &= ~PAGE_ACCESSED_MASK;
+            continue;
+        }
+        frame = *pte & FIVE_MSB;
+        if(frame_refcount(frame) != 1)
+            continue;
+        *slot = swap_slot_alloc();
+        if(*slot == SWAP_SLOT_NONE) {
+            ret = -1;
+            break;
+        }
+        frame_copy(buffer, frame);
+        *pte = SWAP_PTE(*slot);
+        leader->resident_pages--;
+        frame_free(frame);
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+
+    *hand = (ret == 1) ? PROCESS_VIRTUAL_ADDRESS_START : addr;
+    return ret;
+}
+
+/* int32_t user_mem_fork(PCB_BLOCK_t* child, PCB_BLOCK_t* parent)
+ * Inputs: child - new leader with its directory, from user_mem_init
+ *         parent - leader being forked, running on this processor without threads
+ * Return Value: 0, -1 if we ran out of memory part way, user_mem_free undoes what was shared
+ * Nothing is copied here, that's left to the first write. With no other threads
+ * in parent, dropping our own TLB is enough for the write protection to stick */
+int32_t user_mem_fork(PCB_BLOCK_t* child, PCB_BLOCK_t* parent) {
+    uint32_t pde;
+    int32_t ret;
+    uint32_t flags;
+
+    spin_lock_irqsave(&parent->mm_lock, flags);
+    child->brk = parent->brk;
+    ret = user_table_fork(child, parent, PROCESS_VIRTUAL_ADDRESS_START);
+    for(pde = USER_HEAP_START >> BITSHIFT_PAGE_OFFSET; pde < USER_HEAP_END >> BITSHIFT_PAGE_OFFSET && ret == 0; pde++)
+        ret = user_table_fork(child, parent, pde << BITSHIFT_PAGE_OFFSET);
+    tlb_flush_all(TLB_REASON_COW);
+    spin_unlock_irqrestore(&parent->mm_lock, flags);
+    return ret;
+}
+
+/* int32_t user_mem_sbrk(PCB_BLOCK_t* leader, int32_t increment)
+ * Inputs: leader - process whose heap to move, running on this processor
+ *         increment - bytes to grow the heap by, negative to shrink it
+ * Return Value: old end of the heap, -1 if it would leave [USER_HEAP_START, USER_HEAP_END)
+ * Growing only moves brk, pages come in on first touch. Shrinking frees whole
+ * pages past the new end. Other threads may still have those in their TLBs
+ * on other processors, so while any run the pages stay mapped */
+int32_t user_mem_sbrk(PCB_BLOCK_t* leader, int32_t increment) {
+    uint32_t old_brk, new_brk, addr;
+    uint32_t* pte;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    old_brk = leader->brk;
+    new_brk = old_brk + increment;
+    if((increment > 0 && (new_brk < old_brk || new_brk > USER_HEAP_END)) ||
+       (increment < 0 && (new_brk > old_brk || new_brk < USER_HEAP_START))) {
+        spin_unlock_irqrestore(&leader->mm_lock, flags);
+        return -1;
+    }
+    leader->brk = new_brk;
+
+    if(increment < 0 && leader->thread_count == 0) {
+        for(addr = PAGE_ALIGN_UP(new_brk); addr < old_brk; addr += PG_BASE_SIZE) {
+            pte = user_pte(leader, addr, 0);
+            if(pte == NULL)
+                continue;
+            if(!(*pte & PAGE_PRESENT_MASK)) {
+                if(*pte & SWAP_PTE_MASK)
+                    swap_slot_free(SWAP_PTE_SLOT(*pte));
+                *pte = EMPTY_ENTRY;
+                continue;
+            }
+            frame_free(*pte & FIVE_MSB);
+            *pte = EMPTY_ENTRY;
+            leader->resident_pages--;
+            tlb_flush_page(addr, TLB_REASON_USER_MEM);
+        }
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return old_brk;
+}
+
+/* int32_t user_mem_map_frame(PCB_BLOCK_t* leader, uint32_t addr, uint32_t frame)
+ * Inputs: leader - process to map the frame into
+ *         addr - page aligned user address
+ *         frame - frame from frame_alloc that stays in use by whoever handed it to us
+ * Return Value: 0, -1 if something is mapped there already or the page pool is out */
+int32_t user_mem_map_frame(PCB_BLOCK_t* leader, uint32_t addr, uint32_t frame) {
+    uint32_t* pte;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 1);
+    if(pte == NULL || (*pte & PAGE_PRESENT_MASK) || frame_ref(frame) != 0) {
+        spin_unlock_irqrestore(&leader->mm_lock, flags);
+        return -1;
+    }
+    *pte = frame | USER_READ_WRITE_PRESENT_ENABLE;
+    leader->resident_pages++;
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return 0;
+}
+
+/* void user_mem_unmap(PCB_BLOCK_t* leader, uint32_t addr)
+ * Inputs: leader - process to unmap the page from, without threads on other processors
+ *         addr - page aligned user address
+ * Return Value: None
+ * Nothing happens if the page isn't mapped */
+void user_mem_unmap(PCB_BLOCK_t* leader, uint32_t addr) {
+    uint32_t* pte;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    if(pte != NULL && (*pte & PAGE_PRESENT_MASK)) {
+        frame_free(*pte & FIVE_MSB);
+        *pte = EMPTY_ENTRY;
+        leader->resident_pages--;
+        tlb_flush_page(addr, TLB_REASON_USER_MEM);
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+}
+
+/* int32_t user_mem_read_word(PCB_BLOCK_t* leader, uint32_t addr, uint32_t* value)
+ * Inputs: leader - process whose directory is loaded
+ *         addr - 4 byte aligned user address
+ *         value - where to put the word
+ * Return Value: 0, -1 if the page isn't mapped
+ * For callers holding a spinlock, who must not take a fault. Unmapping and
+ * eviction both take mm_lock, so the page can't go away while we read it */
+int32_t user_mem_read_word(PCB_BLOCK_t* leader, uint32_t addr, uint32_t* value) {
+    uint32_t* pte;
+    int32_t ret = -1;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    if(pte != NULL && (*pte & PAGE_PRESENT_MASK)) {
+        *value = *((volatile uint32_t *) addr);
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return ret;
+}
+
+/* uint32_t user_mem_phys(PCB_BLOCK_t* leader, uint32_t addr)
+ * Inputs: leader - process whose tables to look in
+ *         addr - user address
+ * Return Value: physical address of addr, FRAME_NONE if no frame is mapped there */
+uint32_t user_mem_phys(PCB_BLOCK_t* leader, uint32_t addr) {
+    uint32_t* pte;
+    uint32_t phys = FRAME_NONE;
+    uint32_t flags;
+
+    spin_lock_irqsave(&leader->mm_lock, flags);
+    pte = user_pte(leader, addr, 0);
+    if(pte != NULL && (*pte & PAGE_PRESENT_MASK))
+        phys = (*pte & FIVE_MSB) | (addr & (PG_BASE_SIZE - 1));
+    spin_unlock_irqrestore(&leader->mm_lock, flags);
+    return phys;
+}
+
+/* int32_t user_mem_write(PCB_BLOCK_t* leader, uint32_t addr, const uint8_t* buf, uint32_t nbytes)
+ * Inputs: leader - process to write into
+ *         addr - user address to start at
+ *         buf, nbytes - kernel bytes to copy there
+ * Return Value: 0, -1 if part of the range isn't mapped writable
+ * For the loader, along with user_mem_populate, and for the kernel writing
+ * to pages it faulted in beforehand. It never faults, a page that went away
+ * or is shared copy on write in the meantime fails instead. Only a page at a
+ * time goes through the frame windows with mm_lock held, and no directory has
+ * to be loaded */
+int32_t user_mem_write(PCB_BLOCK_t* leader, uint32_t addr, const uint8_t* buf, uint32_t nbytes) {
+    uint32_t* pte;
+    uint32_t offset, chunk;
+    uint32_t flags;
+    int32_t ret = 0;
+
+    while(nbytes > 0 && ret == 0) {
+        offset = addr & (PG_BASE_SIZE - 1);
+        chunk = PG_BASE_SIZE - offset;
+        if(chunk > nbytes)
+            chunk = nbytes;
+
+        spin_lock_irqsave(&leader->mm_lock, flags);
+        pte = user_pte(leader, addr, 0);
+        if(pte != NULL && (*pte & PAGE_PRESENT_MASK) && (*pte & PAGE_RW_MASK))
+            frame_write(*pte & FIVE_MSB, offset, buf, chunk);
+        else
+            ret = -1;
+        spin_unlock_irqrestore(&leader->mm_lock, flags);
+
+        addr += chunk;
+        buf += chunk;
+        nbytes -= chunk;
+    }
+    return ret;
+}
+
+/* void user_mem_free(PCB_BLOCK_t* leader)
+ * Inputs: leader - zombie leader, or one that never ran
+ * Return Value: None
+ * The vidmap table isn't ours, process_free gives that back. Shared memory
+ * segments have to be detached first, see shm_detach_all */
+void user_mem_free(PCB_BLOCK_t* leader) {
+    uint32_t pde;
+
+    user_table_free(&leader->page_directory[PROCESS_VIRTUAL_ADDRESS_START >> BITSHIFT_PAGE_OFFSET]);
+    for(pde = USER_HEAP_START >> BITSHIFT_PAGE_OFFSET; pde < USER_SHM_END >> BITSHIFT_PAGE_OFFSET; pde++)
+        user_table_free(&leader->page_directory[pde]);
+    leader->resident_pages = 0;
+}
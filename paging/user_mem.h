@@ -0,0 +1,75 @@
+/** user_mem.h - a process's user memory in lazily mapped 4kB pages
+ *
+ *  The 4MB program region at 0x8000000 and the heap above the vidmap page
+ *  are backed by 4kB frames that are only taken from the frame allocator,
+ *  zeroed and mapped the first time they are touched, so a process costs
+ *  the memory it actually uses. The page tables come from the page pool so
+ *  the kernel can walk them whichever directory is loaded. Threads use their
+ *  leader's tables, brk and lock.
+ *
+ *  fork shares every mapped frame with the child read only, and the first
+ *  write on either side takes a private copy, or just the write permission
+ *  back once nobody else has the frame.
+ */
+
+#ifndef _USER_MEM_H
+#define _USER_MEM_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// heap grows up from the first 4MB after the vidmap page
+#define USER_HEAP_START 0x08800000
+#define USER_HEAP_END   0x10000000
+// shared memory segments are attached in the 4MB right after the heap, see shm.h
+#define USER_SHM_START  0x10000000
+#define USER_SHM_END    0x10400000
+
+// page fault error code bits
+#define PAGE_FAULT_PRESENT 0x1
+#define PAGE_FAULT_WRITE   0x2
+#define PAGE_FAULT_USER    0x4
+
+struct PCB_BLOCK_t;
+
+/* gives a new leader the page table of its program region and an empty heap */
+extern int32_t user_mem_init(struct PCB_BLOCK_t* leader);
+
+/* maps zeroed pages over [start, end) right away */
+extern int32_t user_mem_populate(struct PCB_BLOCK_t* leader, uint32_t start, uint32_t end);
+
+/* maps or swaps in the page a not present fault at addr hit, or copies a shared page
+ * a write hit, 0 if it did, -1 if addr isn't ours */
+extern int32_t user_mem_fault(struct PCB_BLOCK_t* leader, uint32_t addr, uint32_t error_code);
+
+/* maps every page of parent in child too, write protected in both, 0 or -1 if out of memory */
+extern int32_t user_mem_fork(struct PCB_BLOCK_t* child, struct PCB_BLOCK_t* parent);
+
+/* swaps out the next cold page from *hand on, see swap.h. 0 if it did, 1 at the end, -1 if swap is full */
+extern int32_t user_mem_evict(struct PCB_BLOCK_t* leader, uint32_t* hand, uint32_t buffer, uint32_t* slot);
+
+/* moves the end of the heap by increment, returns the old end or -1 */
+extern int32_t user_mem_sbrk(struct PCB_BLOCK_t* leader, int32_t increment);
+
+/* maps a frame someone else owns at addr and takes a reference to it, 0 or -1 */
+extern int32_t user_mem_map_frame(struct PCB_BLOCK_t* leader, uint32_t addr, uint32_t frame);
+
+/* unmaps the page at addr and drops its reference to the frame behind it */
+extern void user_mem_unmap(struct PCB_BLOCK_t* leader, uint32_t addr);
+
+/* reads the aligned word at addr without faulting, 0 or -1 if its page isn't mapped */
+extern int32_t user_mem_read_word(struct PCB_BLOCK_t* leader, uint32_t addr, uint32_t* value);
+
+/* physical address addr is mapped to, FRAME_NONE if it isn't */
+extern uint32_t user_mem_phys(struct PCB_BLOCK_t* leader, uint32_t addr);
+
+/* copies kernel bytes into user pages without faulting, 0 or -1 if one isn't mapped writable */
+extern int32_t user_mem_write(struct PCB_BLOCK_t* leader, uint32_t addr, const uint8_t* buf, uint32_t nbytes);
+
+/* frees every user frame and page table, the directory must not be loaded anywhere */
+extern void user_mem_free(struct PCB_BLOCK_t* leader);
+
+#endif /* ASM */
+
+#endif /* _USER_MEM_H */
@@ -0,0 +1,125 @@
+#include "vdata.h"
+#include "page_pool.h"
+#include "../spinlock.h"
+#include "../apic.h"
+#include "../devices/pit.h"
+#include "../interrupts/syscalls.h"
+
+#define SECONDS_IN_MINUTE 60
+#define SECONDS_IN_HOUR   3600
+// CPUID.1:EDX, time stamp counter present
+#define CPUID_TSC_FLAG 0x00000010
+
+vdata_t* vdata = NULL;
+
+// serializes the timer tick and the CMOS interrupt, readers never take it
+static spinlock_t vdata_lock = SPINLOCK_INIT;
+
+/* Reads the time stamp counter */
+static inline void rdtsc(uint32_t* low, uint32_t* high) {
+    asm volatile ("rdtsc" : "=a"(*low), "=d"(*high));
+}
+
+/* Makes seq odd so readers hold off, call with vdata_lock held */
+static inline void vdata_write_begin() {
+    vdata->seq++;
+    asm volatile ("" : : : "memory");
+}
+
+/* Makes seq even again, readers that overlapped the update retry */
+static inline void vdata_write_end() {
+    asm volatile ("" : : : "memory");
+    vdata->seq++;
+}
+
+/* int32_t vdata_init()
+ * Inputs: None
+ * Return Value: 0 on success, -1 if the page pool is empty
+ * Must run with interrupts off, before the first process is created */
+int32_t vdata_init() {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t start_low, start_high, end_low, end_high;
+
+    vdata = (vdata_t *) page_pool_alloc(1);
+    if(vdata == NULL)
+        return -1;
+    memset(vdata, 0, PG_BASE_SIZE);
+
+    // the PIT is set to the same rate when there are no APICs
+    vdata->tick_hz = LAPIC_TIMER_HZ;
+    vdata->num_terminals = num_terminals;
+
+    asm volatile ("cpuid"
+                  : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                  : "a"(1)
+                  );
+    if(edx & CPUID_TSC_FLAG) {
+        rdtsc(&start_low, &start_high);
+        pit_delay_us(VDATA_CALIBRATE_US);
+        rdtsc(&end_low, &end_high);
+        // the low halves are enough for 10ms
+        vdata->tsc_per_us = (end_low - start_low) / VDATA_CALIBRATE_US;
+        vdata->tick_tsc_low = end_low;
+        vdata->tick_tsc_high = end_high;
+    }
+    return 0;
+}
+
+/* void vdata_tick_locked(uint32_t ticks)
+ * Inputs: ticks - the boot processor's tick count
+ * Return Value: None
+ * Called on every tick of the boot processor with sched_lock held, which also
+ * keeps the process table still while we count runnable processes */
+void vdata_tick_locked(uint32_t ticks) {
+    uint32_t runnable[MAX_TERMINALS];
+    uint32_t tsc_low, tsc_high;
+    uint32_t i;
+
+    if(vdata == NULL)
+        return;
+
+    if(ticks % VDATA_LOAD_TICKS == 0) {
+        memset(runnable, 0, sizeof(runnable));
+        for(i = 0; i < MAX_PROCESSES; i++) {
+            if(PCB[i] == NULL || PCB[i]->state != PROCESS_RUNNABLE || (PCB[i]->flags & PROCESS_FLAG_KTHREAD))
+                continue;
+            runnable[PCB[i]->terminal_idx]++;
+        }
+    }
+
+    spin_lock(&vdata_lock);
+    vdata_write_begin();
+    vdata->ticks = ticks;
+    if(vdata->tsc_per_us != 0) {
+        rdtsc(&tsc_low, &tsc_high);
+        vdata->tick_tsc_low = tsc_low;
+        vdata->tick_tsc_high = tsc_high;
+    }
+    if(ticks % VDATA_LOAD_TICKS == 0) {
+        for(i = 0; i < MAX_TERMINALS; i++) {
+            vdata->term_runnable[i] = runnable[i];
+            vdata->term_load[i] = (vdata->term_load[i] * VDATA_LOAD_EXP +
+                                   runnable[i] * VDATA_LOAD_ONE * (VDATA_LOAD_ONE - VDATA_LOAD_EXP)) >> VDATA_LOAD_SHIFT;
+        }
+    }
+    vdata_write_end();
+    spin_unlock(&vdata_lock);
+}
+
+/* void vdata_set_wall_clock(uint8_t hours, uint8_t minutes, uint8_t seconds)
+ * Inputs: hours, minutes, seconds - local time of day
+ * Return Value: None
+ * Called from the CMOS update interrupt once a second */
+void vdata_set_wall_clock(uint8_t hours, uint8_t minutes, uint8_t seconds) {
+    uint32_t flags;
+
+    if(vdata == NULL)
+        return;
+
+    spin_lock_irqsave(&vdata_lock, flags);
+    vdata_write_begin();
+    vdata->wall_seconds = hours * SECONDS_IN_HOUR + minutes * SECONDS_IN_MINUTE + seconds;
+    vdata->wall_ticks = vdata->ticks;
+    vdata_write_end();
+    spin_unlock_irqrestore(&vdata_lock, flags);
+}
@@ -0,0 +1,86 @@
+/** vdata.h - kernel data page every process can read without a syscall
+ *
+ *  One page from the page pool is mapped read only into every address space
+ *  at USER_VDATA_ADDR, right after the vidmap page. The kernel keeps the tick
+ *  count, the time stamp counter rate, the CMOS time of day and per terminal
+ *  load figures in it. Readers take a snapshot under a sequence count: they
+ *  read seq, copy what they need and read seq again, and try again if it was
+ *  odd or changed in between. vdata_read_begin/vdata_read_retry do that and
+ *  work the same from user space.
+ */
+
+#ifndef _VDATA_H
+#define _VDATA_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../devices/terminal_structs.h"
+
+// page after the vidmap page, in the same page table
+#define USER_VDATA_ADDR 0x08401000
+#define VDATA_VID_ENTRY 1
+
+// load figures are sampled this often, 5 seconds at 100Hz
+#define VDATA_LOAD_TICKS 500
+// fixed point load averages, with VDATA_LOAD_SHIFT fractional bits
+#define VDATA_LOAD_SHIFT 11
+#define VDATA_LOAD_ONE (1 << VDATA_LOAD_SHIFT)
+// decay per sample for a 1 minute average, 1/exp(5s/1min) in fixed point
+#define VDATA_LOAD_EXP 1884
+// how long we watch the time stamp counter against the PIT at boot
+#define VDATA_CALIBRATE_US 10000
+
+typedef struct vdata {
+    // odd while the kernel is in the middle of an update
+    volatile uint32_t seq;
+    // timer ticks on the boot processor since boot, and how many make a second
+    uint32_t ticks;
+    uint32_t tick_hz;
+    // time stamp counter at the last tick, and its cycles per microsecond.
+    // 0 if the processor has no usable TSC
+    uint32_t tick_tsc_low;
+    uint32_t tick_tsc_high;
+    uint32_t tsc_per_us;
+    // local time of day from the CMOS clock in seconds after midnight, and
+    // the tick it was read at
+    uint32_t wall_seconds;
+    uint32_t wall_ticks;
+    // processes running or ready to run per terminal at the last sample, and
+    // their load average in VDATA_LOAD_SHIFT fixed point
+    uint32_t num_terminals;
+    uint32_t term_runnable[MAX_TERMINALS];
+    uint32_t term_load[MAX_TERMINALS];
+} vdata_t;
+
+// the page itself, in the kernel's identity mapping
+extern vdata_t* vdata;
+
+/* takes the page, calibrates the time stamp counter and publishes the tick rate */
+extern int32_t vdata_init();
+
+/* updates the tick, and every VDATA_LOAD_TICKS the load figures, sched_lock held */
+extern void vdata_tick_locked(uint32_t ticks);
+
+/* publishes the time of day the CMOS clock just gave us */
+extern void vdata_set_wall_clock(uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/* sequence count to hand to vdata_read_retry, waits out an update in progress */
+static inline uint32_t vdata_read_begin(const vdata_t* data) {
+    uint32_t seq;
+    do {
+        seq = data->seq;
+    } while(seq & 1);
+    asm volatile ("" : : : "memory");
+    return seq;
+}
+
+/* nonzero if the kernel updated the page since vdata_read_begin returned seq */
+static inline uint32_t vdata_read_retry(const vdata_t* data, uint32_t seq) {
+    asm volatile ("" : : : "memory");
+    return data->seq != seq;
+}
+
+#endif /* ASM */
+
+#endif /* _VDATA_H */
@@ -0,0 +1,159 @@
+#include "fpu.h"
+#include "../lib.h"
+#include "../interrupts/syscall_structs.h"
+#include "smp.h"
+
+// the pid whose x87/SSE state lives in each processor's FPU is in this_cpu()->fpu_owner,
+// the balancer never moves a process whose state is still loaded, see can_migrate
+// set once the CPU supports fxsave/fxrstor and we turned it on
+static uint8_t fpu_enabled;
+// state loaded into a process the first time it touches the FPU
+static uint8_t fpu_initial_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
+
+/* Sets CR0.TS so the next FPU/SSE instruction traps with #NM */
+static inline void stts() {
+    asm volatile ("movl %%cr0, %%eax;\n"
+                  "orl %0, %%eax;\n"
+                  "movl %%eax, %%cr0;\n"
+                  :
+                  : "i"(CR0_TS_FLAG)
+                  : "eax", "memory", "cc"
+                  );
+}
+
+/* Clears CR0.TS so FPU/SSE instructions run without trapping */
+static inline void clts() {
+    asm volatile ("clts" : : : "memory");
+}
+
+/* uint32_t fpu_init_cpu()
+ * Inputs: None
+ * Return Value: CPUID.1:EDX, 0 if the processor can't fxsave
+ * Enables the FPU and SSE (OSFXSR/OSXMMEXCPT) on the processor we run on. Every
+ * processor has its own CR0/CR4, so the other processors call this on their own */
+uint32_t fpu_init_cpu() {
+    uint32_t eax, ebx, ecx, edx;
+
+    this_cpu()->fpu_owner = FPU_NO_OWNER;
+
+    asm volatile ("cpuid"
+                  : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                  : "a"(1)
+                  );
+    if(!(edx & CPUID_FXSR_FLAG))
+        return 0;
+
+    // x87 present: EM off, MP and NE on so TS traps WAIT and errors go through #MF
+    asm volatile ("movl %%cr0, %%eax;\n"
+                  "andl %0, %%eax;\n"
+                  "orl %1, %%eax;\n"
+                  "movl %%eax, %%cr0;\n"
+                  :
+                  : "i"(~CR0_EM_FLAG), "i"(CR0_MP_FLAG | CR0_NE_FLAG)
+                  : "eax", "memory", "cc"
+                  );
+
+    // tell the CPU we save SSE state with fxsave and handle SIMD exceptions
+    if(edx & CPUID_SSE_FLAG) {
+        asm volatile ("movl %%cr4, %%eax;\n"
+                      "orl %0, %%eax;\n"
+                      "movl %%eax, %%cr4;\n"
+                      :
+                      : "i"(CR4_OSFXSR_FLAG | CR4_OSXMMEXCPT_FLAG)
+                      : "eax", "memory", "cc"
+                      );
+    }
+
+    stts();
+    return edx;
+}
+
+/* void fpu_init()
+ * Inputs: None
+ * Return Value: None
+ * Sets up the boot processor's FPU and captures a clean fxsave image.
+ * If the CPU has no fxsave support the FPU stays emulated, so any use traps and
+ * the process is killed like before. */
+void fpu_init() {
+    fpu_enabled = 0;
+    if(!fpu_init_cpu())
+        return;
+
+    // build the image every process starts with
+    clts();
+    asm volatile ("fninit");
+    asm volatile ("fxsave (%0)" : : "r"(fpu_initial_state) : "memory");
+    *((uint32_t *) (fpu_initial_state + FXSAVE_MXCSR_OFFSET)) = MXCSR_DEFAULT;
+
+    fpu_enabled = 1;
+    stts();
+}
+
+/* void fpu_switch(uint8_t process_to)
+ * Inputs: process_to - pid of the process that is about to run
+ * Return Value: None
+ * Integer-only processes never pay for a save/restore: we only arm the trap here */
+void fpu_switch(uint8_t process_to) {
+    if(!fpu_enabled)
+        return;
+
+    if(process_to == this_cpu()->fpu_owner)
+        clts();
+    else
+        stts();
+}
+
+/* void fpu_device_not_available()
+ * Inputs: None
+ * Return Value: None
+ * Saves the previous owner's registers into its PCB and loads the current process's.
+ * #NM comes in through a trap gate, so interrupts go off first: moving to another
+ * processor halfway through would load our state into the wrong FPU */
+void fpu_device_not_available() {
+    cpu_t* cpu;
+    PCB_BLOCK_t* current_PCB;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = this_cpu();
+    current_PCB = PCB[cpu->current_pid];
+
+    clts();
+
+    if(cpu->fpu_owner == cpu->current_pid) {
+        restore_flags(flags);
+        return;
+    }
+
+    if(cpu->fpu_owner != FPU_NO_OWNER)
+        asm volatile ("fxsave (%0)" : : "r"(PCB[cpu->fpu_owner]->fpu_state) : "memory");
+
+    if(!current_PCB->fpu_used) {
+        memcpy(current_PCB->fpu_state, fpu_initial_state, FPU_STATE_SIZE);
+        current_PCB->fpu_used = 1;
+    }
+    asm volatile ("fxrstor (%0)" : : "r"(current_PCB->fpu_state) : "memory");
+
+    cpu->fpu_owner = cpu->current_pid;
+    restore_flags(flags);
+}
+
+/* void fpu_release(uint8_t pid)
+ * Inputs: pid - process that is going away
+ * Return Value: None
+ * The halted process's registers are dead, so the next user doesn't need to save them */
+void fpu_release(uint8_t pid) {
+    PCB[pid]->fpu_used = 0;
+    if(this_cpu()->fpu_owner == pid) {
+        this_cpu()->fpu_owner = FPU_NO_OWNER;
+        stts();
+    }
+}
+
+/* uint8_t fpu_is_enabled()
+ * Inputs: None
+ * Return Value: 1 if lazy FPU switching is active
+ * Lets the #NM handler tell a lazy restore apart from a real missing FPU */
+uint8_t fpu_is_enabled() {
+    return fpu_enabled;
+}
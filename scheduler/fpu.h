@@ -0,0 +1,54 @@
+#ifndef _FPU_H
+#define _FPU_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// size of the fxsave/fxrstor image, must be 16 byte aligned
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_ALIGN 16
+
+// nobody's state is currently loaded in the FPU
+#define FPU_NO_OWNER 0xFF
+
+// CR0 bits
+#define CR0_MP_FLAG 0x00000002
+#define CR0_EM_FLAG 0x00000004
+#define CR0_TS_FLAG 0x00000008
+#define CR0_NE_FLAG 0x00000020
+
+// CR4 bits
+#define CR4_OSFXSR_FLAG     0x00000200
+#define CR4_OSXMMEXCPT_FLAG 0x00000400
+
+// CPUID.1:EDX feature bits
+#define CPUID_FXSR_FLAG 0x01000000
+#define CPUID_SSE_FLAG  0x02000000
+
+// default MXCSR value, all SIMD exceptions masked
+#define MXCSR_DEFAULT 0x1F80
+// offset of MXCSR in the fxsave image
+#define FXSAVE_MXCSR_OFFSET 24
+
+/* enables x87/SSE for user programs and arms lazy context switching */
+extern void fpu_init(void);
+
+/* turns on x87/SSE for the processor we are running on */
+extern uint32_t fpu_init_cpu(void);
+
+/* called whenever process_to is about to run, sets CR0.TS unless its state is already loaded */
+extern void fpu_switch(uint8_t process_to);
+
+/* called from the device-not-available trap, swaps FPU state to the current process */
+extern void fpu_device_not_available(void);
+
+/* called when a process halts, drops its state if it is loaded in the FPU */
+extern void fpu_release(uint8_t pid);
+
+/* returns 1 if lazy FPU switching is active */
+extern uint8_t fpu_is_enabled(void);
+
+#endif
+
+#endif /* _FPU_H */
@@ -0,0 +1,125 @@
+#include "futex.h"
+#include "scheduler.h"
+#include "../interrupts/syscalls.h"
+
+// sleepers of every address hashing to the same bucket share its queue,
+// each one remembers its own word in futex_owner and futex_key. Guarded by sched_lock
+static wait_queue_t futex_queues[FUTEX_HASH_SIZE];
+
+/* void futex_init()
+ * Inputs: None
+ * Return Value: None */
+void futex_init() {
+    int i;
+    for(i = 0; i < FUTEX_HASH_SIZE; i++)
+        wait_queue_init(&futex_queues[i]);
+}
+
+/* uint32_t futex_key(PCB_BLOCK_t* leader, uint32_t* uaddr, PCB_BLOCK_t** owner)
+ * Inputs: leader - leader of the running process
+ *         uaddr - user address of the word
+ *         owner - set to leader for a private word, NULL for a shared one
+ * Return Value: what the word is known by together with owner, FRAME_NONE if a
+ *               shared word isn't mapped
+ * A private word is its leader and user address, which covers every thread and
+ * stays the same when a copy on write fault or swapping moves its frame. Shared
+ * memory segments are mapped by other processes too, at their own addresses, so
+ * those words go by their frame, which stays put while anyone has it attached */
+static uint32_t futex_key(PCB_BLOCK_t* leader, uint32_t* uaddr, PCB_BLOCK_t** owner) {
+    uint32_t addr = (uint32_t) uaddr;
+
+    if(addr >= USER_SHM_START && addr < USER_SHM_END) {
+        *owner = NULL;
+        return user_mem_phys(leader, addr);
+    }
+    *owner = leader;
+    return addr;
+}
+
+/* wait_queue_t* futex_queue(PCB_BLOCK_t* owner, uint32_t key)
+ * Inputs: owner, key - the word, see futex_key
+ * Return Value: queue the sleepers on it are in */
+static wait_queue_t* futex_queue(PCB_BLOCK_t* owner, uint32_t key) {
+    // words are 4 byte aligned and PCBs come from a slab, the low bits carry nothing
+    return &futex_queues[((key ^ (uint32_t) owner) >> 2) & (FUTEX_HASH_SIZE - 1)];
+}
+
+/* int32_t futex_wait(uint32_t* uaddr, uint32_t val)
+ * Inputs: uaddr - aligned word in the running process's user page
+ *         val - value the caller last saw there
+ * Return Value: 0 once woken by futex_wake, -1 if *uaddr no longer held val or isn't ours
+ * The word is checked under sched_lock, which futex_wake also takes, so a wake up
+ * between the caller's check and ours can't get lost. Mapping the page in may
+ * allocate or read the swap disk, so that happens before taking the lock and the
+ * word is only read under it if the page is still there */
+int32_t futex_wait(uint32_t* uaddr, uint32_t val) {
+    PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+    PCB_BLOCK_t* leader = current_PCB->leader;
+    uint32_t word;
+    uint32_t flags;
+
+    while(1) {
+        if(user_mem_phys(leader, (uint32_t) uaddr) == FRAME_NONE &&
+           user_mem_fault(leader, (uint32_t) uaddr, 0) != 0)
+            return -1;
+
+        spin_lock_irqsave(&sched_lock, flags);
+        if(user_mem_read_word(leader, (uint32_t) uaddr, &word) == 0)
+            break;
+        // another thread shrank the heap under us, fault it back in or fail
+        spin_unlock_irqrestore(&sched_lock, flags);
+    }
+    if(word != val) {
+        spin_unlock_irqrestore(&sched_lock, flags);
+        return -1;
+    }
+    // the page is mapped while we hold sched_lock, so a shared word has a frame
+    current_PCB->futex_key = futex_key(leader, uaddr, &current_PCB->futex_owner);
+    sleep_on(futex_queue(current_PCB->futex_owner, current_PCB->futex_key));
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return 0;
+}
+
+/* int32_t futex_wake(uint32_t* uaddr, uint32_t count)
+ * Inputs: uaddr - aligned word in the running process's user page
+ *         count - most processes to wake
+ * Return Value: how many processes were woken
+ * Wakes the longest sleepers first, sleepers on other addresses in the same
+ * bucket stay where they are */
+int32_t futex_wake(uint32_t* uaddr, uint32_t count) {
+    PCB_BLOCK_t* owner;
+    uint32_t key = futex_key(PCB[current_process_pid]->leader, uaddr, &owner);
+    wait_queue_t* queue = futex_queue(owner, key);
+    PCB_BLOCK_t* prev = NULL;
+    PCB_BLOCK_t* process;
+    PCB_BLOCK_t* next;
+    uint32_t woken = 0;
+    uint32_t flags;
+
+    // nobody can be waiting on a shared word that isn't mapped
+    if(key == FRAME_NONE)
+        return 0;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    for(process = queue->head; process != NULL && woken < count; process = next) {
+        next = process->wait_next;
+        if(process->futex_key != key || process->futex_owner != owner) {
+            prev = process;
+            continue;
+        }
+
+        if(prev != NULL)
+            prev->wait_next = next;
+        else
+            queue->head = next;
+        if(queue->tail == process)
+            queue->tail = prev;
+        process->wait_next = NULL;
+
+        process->state = PROCESS_RUNNABLE;
+        scheduler_enqueue_locked(process);
+        woken++;
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return woken;
+}
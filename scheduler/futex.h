@@ -0,0 +1,35 @@
+/** futex.h - user space blocking on a word of memory
+ *
+ *  A process sleeps on an address of its user page as long as the word there
+ *  still holds the value it expects, and whoever changes the word wakes some
+ *  of the sleepers. Sleepers are hashed by their leader and the word's user
+ *  address, so threads sharing a user page meet in the same queue. Words in
+ *  shared memory segments go by their physical address, so processes do too.
+ */
+
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// futex operations
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+// wait queues the sleepers are hashed into, a power of two
+#define FUTEX_HASH_SIZE 32
+
+/* empties every hash queue */
+extern void futex_init();
+
+/* sleeps while *uaddr == val, 0 once woken, -1 if the value already changed or uaddr isn't mapped */
+extern int32_t futex_wait(uint32_t* uaddr, uint32_t val);
+
+/* wakes up to count processes sleeping on uaddr, returns how many were woken */
+extern int32_t futex_wake(uint32_t* uaddr, uint32_t count);
+
+#endif /* ASM */
+
+#endif /* _FUTEX_H */
@@ -0,0 +1,127 @@
+#include "kstack.h"
+#include "scheduler.h"
+#include "../interrupts/syscalls.h"
+#include "../lib.h"
+
+// deepest any kernel stack has been since boot, guarded by sched_lock
+static uint32_t max_high_water = 0;
+
+/* void kstack_paint(PCB_BLOCK_t* process)
+ * Inputs: process - freshly allocated process whose stack hasn't been used yet
+ * Return Value: None */
+void kstack_paint(PCB_BLOCK_t* process) {
+    uint32_t* stack = (uint32_t *) process->kernel_stack;
+    uint32_t i;
+
+    for(i = 0; i < PCB_KERNEL_PHYSICAL_OFFSET / sizeof(uint32_t); i++)
+        stack[i] = KSTACK_PAINT;
+}
+
+/* uint32_t stack_high_water(uint32_t* stack)
+ * Inputs: stack - bottom of a painted kernel stack
+ * Return Value: bytes between the top of the stack and the deepest word it wrote
+ * Stacks grow down, so the first word from the bottom that lost its paint is
+ * as deep as the process has ever been. A word pushed with the paint's value
+ * makes us undercount by at most that word */
+static uint32_t stack_high_water(uint32_t* stack) {
+    uint32_t words = PCB_KERNEL_PHYSICAL_OFFSET / sizeof(uint32_t);
+    uint32_t i;
+
+    for(i = 0; i < words; i++) {
+        if(stack[i] != KSTACK_PAINT)
+            break;
+    }
+    return (words - i) * sizeof(uint32_t);
+}
+
+/* uint32_t kstack_high_water(PCB_BLOCK_t* process)
+ * Inputs: process - any live process
+ * Return Value: see stack_high_water */
+uint32_t kstack_high_water(PCB_BLOCK_t* process) {
+    return stack_high_water((uint32_t *) process->kernel_stack);
+}
+
+/* void kstack_check(PCB_BLOCK_t* process)
+ * Inputs: process - process being switched away from
+ * Return Value: None, doesn't return if the canary is gone
+ * Whatever the stack ran into below it is already corrupted, so like any
+ * other kernel fault we stop right here instead of running on top of it */
+void kstack_check(PCB_BLOCK_t* process) {
+    uint32_t* stack = (uint32_t *) process->kernel_stack;
+    uint32_t i;
+
+    for(i = 0; i < KSTACK_CANARY_WORDS; i++) {
+        if(stack[i] != KSTACK_PAINT) {
+            cli();
+            printf("Kernel stack overflow in pid %d (%s)\n", process->pid, process->cmd_name);
+            while(1);
+        }
+    }
+}
+
+/* void kstack_retire(PCB_BLOCK_t* process)
+ * Inputs: process - process about to be freed, sched_lock held
+ * Return Value: None */
+void kstack_retire(PCB_BLOCK_t* process) {
+    uint32_t depth = kstack_high_water(process);
+
+    kstack_check(process);
+    if(depth > max_high_water)
+        max_high_water = depth;
+}
+
+/* int32_t kstack_get_stats(uint8_t pid, kstack_stats_t* stats)
+ * Inputs: pid - process to report on, NO_PID for just the boot-wide numbers
+ *         stats - where to put them
+ * Return Value: 0 on success, -1 if pid isn't a live process
+ * The boot-wide maximum also covers every process still running, so it
+ * doesn't lag behind until the deepest one exits. Scanning a stack takes a
+ * while, so sched_lock is only held to find each stack and to check that it
+ * still belongs to the same process afterwards, a stack that was freed while
+ * we looked at it doesn't count. stats may be a user page that isn't present,
+ * so it is only written once the lock is dropped for good */
+int32_t kstack_get_stats(uint8_t pid, kstack_stats_t* stats) {
+    kstack_stats_t snapshot;
+    PCB_BLOCK_t* process;
+    uint32_t* stack;
+    uint32_t depth;
+    uint8_t found = 0;
+    uint32_t flags;
+    uint32_t i;
+
+    if(pid != NO_PID && pid >= MAX_PROCESSES)
+        return -1;
+
+    snapshot.high_water = 0;
+    for(i = 0; i < MAX_PROCESSES; i++) {
+        spin_lock_irqsave(&sched_lock, flags);
+        process = PCB[i];
+        stack = (process != NULL) ? (uint32_t *) process->kernel_stack : NULL;
+        spin_unlock_irqrestore(&sched_lock, flags);
+        if(stack == NULL)
+            continue;
+
+        // pool pages stay mapped, so even a stack freed under us can be read
+        depth = stack_high_water(stack);
+
+        spin_lock_irqsave(&sched_lock, flags);
+        if(PCB[i] == process && (uint32_t *) process->kernel_stack == stack) {
+            if(depth > max_high_water)
+                max_high_water = depth;
+            if(i == pid) {
+                snapshot.high_water = depth;
+                found = 1;
+            }
+        }
+        spin_unlock_irqrestore(&sched_lock, flags);
+    }
+    if(pid != NO_PID && !found)
+        return -1;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    snapshot.max_high_water = max_high_water;
+    spin_unlock_irqrestore(&sched_lock, flags);
+    snapshot.size = PCB_KERNEL_PHYSICAL_OFFSET;
+    memcpy(stats, &snapshot, sizeof(kstack_stats_t));
+    return 0;
+}
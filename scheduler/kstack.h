@@ -0,0 +1,52 @@
+/** kstack.h - kernel stack overflow checks and depth profiling
+ *
+ *  Every kernel stack is painted with KSTACK_PAINT when its process is
+ *  allocated. The lowest KSTACK_CANARY_WORDS words are the canary, they
+ *  sit right above whatever the page pool handed out below the stack, and
+ *  are checked every time the process is switched out. The deepest point
+ *  a stack ever reached is the lowest word that lost its paint, which
+ *  gives a high-water mark without touching the fast paths.
+ */
+
+#ifndef _KSTACK_H
+#define _KSTACK_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+// pattern every kernel stack starts out filled with
+#define KSTACK_PAINT 0x57AC57AC
+// words at the bottom of the stack that must still hold the paint
+#define KSTACK_CANARY_WORDS 4
+
+struct PCB_BLOCK_t;
+
+// kernel stack depths handed out by the kstack_stats syscall, in bytes
+typedef struct kstack_stats {
+    // size of every kernel stack
+    uint32_t size;
+    // deepest the asked for process has been
+    uint32_t high_water;
+    // deepest any process has been since boot, exited ones included
+    uint32_t max_high_water;
+} kstack_stats_t;
+
+/* fills a new kernel stack with the paint */
+extern void kstack_paint(struct PCB_BLOCK_t* process);
+
+/* bytes of process's kernel stack that have ever been used */
+extern uint32_t kstack_high_water(struct PCB_BLOCK_t* process);
+
+/* halts the machine if process ran off the bottom of its kernel stack */
+extern void kstack_check(struct PCB_BLOCK_t* process);
+
+/* folds the depth of a process about to be freed into the boot-wide maximum */
+extern void kstack_retire(struct PCB_BLOCK_t* process);
+
+/* fills stats for pid, or only the boot-wide numbers if pid is NO_PID */
+extern int32_t kstack_get_stats(uint8_t pid, kstack_stats_t* stats);
+
+#endif /* ASM */
+
+#endif /* _KSTACK_H */
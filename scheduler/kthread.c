@@ -0,0 +1,51 @@
+#include "kthread.h"
+#include "scheduler.h"
+#include "../interrupts/syscalls.h"
+#include "../lib.h"
+
+/* int32_t kthread_create(kthread_fn_t fn, uint32_t arg, const int8_t* name)
+ * Inputs: fn - what the thread runs
+ *         arg - handed to fn
+ *         name - shown as the thread's command name
+ * Return Value: pid of the new thread, -1 if we are out of pids or kernel stacks
+ * Kernel threads are scheduled like processes but never leave ring 0, so they
+ * have no user page, no files and no terminal of their own */
+int32_t kthread_create(kthread_fn_t fn, uint32_t arg, const int8_t* name) {
+    PCB_BLOCK_t* thread;
+    uint32_t* stack;
+    uint32_t flags;
+    cli_and_save(flags);
+
+    thread = process_alloc(0, PROCESS_FLAG_KTHREAD);
+    if(thread == NULL) {
+        restore_flags(flags);
+        return -1;
+    }
+    strncpy((int8_t *) thread->cmd_name, name, ARG_BUF_SIZE - 1);
+
+    // first context_switch pops 4 registers and returns into kthread_first_run,
+    // which pops fn and leaves arg on top as fn's argument
+    stack = (uint32_t *) thread->kernel_stack_top;
+    *(--stack) = arg;
+    *(--stack) = (uint32_t) fn;
+    *(--stack) = (uint32_t) kthread_first_run;
+    *(--stack) = 0;
+    *(--stack) = 0;
+    *(--stack) = 0;
+    *(--stack) = 0;
+    thread->context_esp = (uint32_t) stack;
+
+    thread->state = PROCESS_RUNNABLE;
+    scheduler_enqueue(thread);
+
+    restore_flags(flags);
+    return thread->pid;
+}
+
+/* void kthread_exit()
+ * Inputs: None
+ * Return Value: None, never returns
+ * Nobody waits on kernel threads, so they get freed right after switching away */
+void kthread_exit() {
+    process_exit(0);
+}
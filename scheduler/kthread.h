@@ -0,0 +1,23 @@
+#ifndef _KTHREAD_H
+#define _KTHREAD_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../interrupts/syscall_structs.h"
+
+// body of a kernel thread, returning from it ends the thread
+typedef void (*kthread_fn_t)(uint32_t arg);
+
+/* starts fn(arg) on its own kernel stack, returns its pid or -1 */
+extern int32_t kthread_create(kthread_fn_t fn, uint32_t arg, const int8_t* name);
+
+/* ends the calling kernel thread, never returns */
+extern void kthread_exit();
+
+/* where a new kernel thread's first context_switch returns to, calls its fn */
+extern void kthread_first_run();
+
+#endif
+
+#endif /* _KTHREAD_H */
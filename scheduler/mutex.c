@@ -0,0 +1,68 @@
+#include "mutex.h"
+#include "scheduler.h"
+#include "../spinlock.h"
+
+/* void mutex_init(mutex_t* mutex)
+ * Inputs: mutex - mutex to set up
+ * Return Value: None */
+void mutex_init(mutex_t* mutex) {
+    mutex->locked = 0;
+    mutex->owner = NO_PID;
+    wait_queue_init(&mutex->waiters);
+}
+
+/* void mutex_lock(mutex_t* mutex)
+ * Inputs: mutex - mutex to take
+ * Return Value: None
+ * locked is checked and set under sched_lock, which mutex_unlock also takes before
+ * waking anyone, so a wake up can't slip in between. The boot thread has no PCB
+ * to sleep on, so before the first process runs we spin instead */
+void mutex_lock(mutex_t* mutex) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    while(mutex->locked) {
+        if(current_process_pid == NO_PID) {
+            spin_unlock_irqrestore(&sched_lock, flags);
+            asm volatile ("pause" : : : "memory");
+            spin_lock_irqsave(&sched_lock, flags);
+            continue;
+        }
+        sleep_on(&mutex->waiters);
+    }
+    mutex->locked = 1;
+    mutex->owner = current_process_pid;
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* int32_t mutex_trylock(mutex_t* mutex)
+ * Inputs: mutex - mutex to take
+ * Return Value: 1 if it is ours now, 0 if someone else holds it */
+int32_t mutex_trylock(mutex_t* mutex) {
+    int32_t taken = 0;
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    if(!mutex->locked) {
+        mutex->locked = 1;
+        mutex->owner = current_process_pid;
+        taken = 1;
+    }
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return taken;
+}
+
+/* void mutex_unlock(mutex_t* mutex)
+ * Inputs: mutex - mutex we hold
+ * Return Value: None
+ * Only one waiter is woken, the others would just go back to sleep. It still has
+ * to win the mutex in mutex_lock, so a process that never slept may get it first */
+void mutex_unlock(mutex_t* mutex) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&sched_lock, flags);
+    mutex->locked = 0;
+    mutex->owner = NO_PID;
+    wake_up_one_locked(&mutex->waiters);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
@@ -0,0 +1,42 @@
+/** mutex.h - sleeping locks for process context
+ *
+ *  A spinlock keeps interrupts off for as long as it is held, which is fine
+ *  for a few instructions but not for copying a whole user buffer or reading
+ *  a file. A mutex can be held across all of that with interrupts on, and
+ *  whoever wants it while it's taken sleeps instead of spinning.
+ *  Never take one from an interrupt handler or while holding a spinlock.
+ */
+
+#ifndef _MUTEX_H
+#define _MUTEX_H
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../interrupts/syscall_structs.h"
+
+typedef struct mutex {
+    volatile uint8_t locked;
+    // pid holding it, NO_PID if it's free or held by the boot thread
+    uint8_t owner;
+    // processes waiting for it, woken one at a time
+    wait_queue_t waiters;
+} mutex_t;
+
+#define MUTEX_INIT { 0, NO_PID, { NULL, NULL } }
+
+/* sets up an unlocked mutex */
+extern void mutex_init(mutex_t* mutex);
+
+/* takes the mutex, sleeping until it is free */
+extern void mutex_lock(mutex_t* mutex);
+
+/* takes the mutex if it is free, returns 1 if we got it and 0 if not */
+extern int32_t mutex_trylock(mutex_t* mutex);
+
+/* gives the mutex to the longest waiter, or frees it */
+extern void mutex_unlock(mutex_t* mutex);
+
+#endif /* ASM */
+
+#endif /* _MUTEX_H */
@@ -5,13 +5,18 @@
 #include "../debug.h"
 #include "../paging/multi_terminals.h"
 #include "../devices/pit.h"
+#include "fpu.h"
+#include "../apic.h"
+#include "../paging/tlb.h"
+#include "../paging/frame_alloc.h"
+#include "../paging/swap.h"
+#include "../paging/vdata.h"
+#include "../fs/poll.h"
+#include "kstack.h"
 
-uint8_t num_multiprocess;
-uint8_t current_multiprocess;
-uint8_t on_default_term;
-uint8_t keyboard_disabled;
-uint8_t multi_process_idx[MAX_MULTIPROCESS_NUM];
-process_t all_process[MAX_PROCESSES];
+uint8_t terminal_foreground_pid[MAX_TERMINALS];
+
+spinlock_t sched_lock = SPINLOCK_INIT;
 
 
 /* void scheduler_init()
@@ -19,123 +24,520 @@ process_t all_process[MAX_PROCESSES];
  * Return Value: None
  * Inits all local variables for scheduler */
 void scheduler_init() {
-    num_multiprocess = 0;
-    current_multiprocess = 2;
-    on_default_term = 0;
-    keyboard_disabled = 0;
-}
-
-/* void process_context_switch(uint8_t process_from, uint8_t process_to)
- * Inputs: process_from - pid of process we are switching from
-           process_to - pid of process we are switching to
- * Return Value: None
- * performs a context switch between kernel stacks of two different processes */
-void process_context_switch(uint8_t process_from, uint8_t process_to) {
-    /* save esp/ebp */
-    asm ("movl %%esp, %0;\n"
-            "movl %%ebp, %1;\n"
-            : "=g"(all_process[multi_process_idx[process_from]].saved_esp), "=g"(all_process[multi_process_idx[process_from]].saved_ebp)
-            :
-            : "memory", "cc"
-            );
-    current_process_pid = multi_process_idx[process_to];
-
-    uint32_t addr = VIDEO_MEM_FULL_ADDR >> THREE_BYTE_SIZE;
-    unsigned int page_dir = (unsigned int) PROGRAM_IMAGE_END_ADDRESS >> BITSHIFT_PAGE_OFFSET;
-    if(current_term == process_to) {
+    int i;
+
+    spin_lock_init(&sched_lock);
+    for(i = 0; i < MAX_CPUS; i++) {
+        cpus[i].run_queue_head = NULL;
+        cpus[i].run_queue_tail = NULL;
+        cpus[i].run_queue_length = 0;
+        cpus[i].idle_context_esp = 0;
+        cpus[i].reap_pending = NULL;
+        cpus[i].ticks = 0;
+        cpus[i].idle_ticks = 0;
+        cpus[i].steals = 0;
+        cpus[i].migrations_in = 0;
+        cpus[i].migrations_out = 0;
+        // the boot thread isn't a process, it becomes the idle loop
+        cpus[i].current_pid = NO_PID;
+    }
+    for(i = 0; i < MAX_TERMINALS; i++)
+        terminal_foreground_pid[i] = NO_PID;
+}
+
+/* uint32_t cpu_load(cpu_t* cpu)
+ * Inputs: cpu - processor to look at
+ * Return Value: processes queued on it plus the one running there
+ * sched_lock must be held */
+static uint32_t cpu_load(cpu_t* cpu) {
+    return cpu->run_queue_length + ((cpu->current_pid != NO_PID) ? 1 : 0);
+}
+
+/* cpu_t* scheduler_pick_cpu(PCB_BLOCK_t* process)
+ * Inputs: process - process that is ready to run
+ * Return Value: processor whose run queue it goes on
+ * A new process goes to the online processor with the least to do and stays
+ * there until the balancer moves it. sched_lock must be held */
+static cpu_t* scheduler_pick_cpu(PCB_BLOCK_t* process) {
+    uint32_t best_load = 0;
+    uint32_t load;
+    uint8_t best = 0;
+    uint8_t i;
+
+    if(process->cpu != NO_CPU)
+        return &cpus[process->cpu];
+
+    for(i = 0; i < num_cpus; i++) {
+        if(!cpus[i].online)
+            continue;
+        load = cpu_load(&cpus[i]);
+        if(i == 0 || load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+    process->cpu = best;
+    return &cpus[best];
+}
+
+/* void scheduler_enqueue_locked(PCB_BLOCK_t* process)
+ * Inputs: process - process that is ready to run
+ * Return Value: None
+ * Appends process to the back of its processor's run queue, and pokes that
+ * processor if it is sitting idle. sched_lock must be held */
+void scheduler_enqueue_locked(PCB_BLOCK_t* process) {
+    cpu_t* cpu = scheduler_pick_cpu(process);
+
+    process->run_next = NULL;
+    if(cpu->run_queue_tail != NULL)
+        cpu->run_queue_tail->run_next = process;
+    else
+        cpu->run_queue_head = process;
+    cpu->run_queue_tail = process;
+    cpu->run_queue_length++;
+
+    // an idle processor would otherwise only notice on its next timer tick
+    if(apic_enabled && cpu->current_pid == NO_PID && cpu != this_cpu())
+        lapic_send_ipi(cpu->apic_id, RESCHED_VECTOR);
+}
+
+/* void scheduler_enqueue(PCB_BLOCK_t* process)
+ * Inputs: process - process that is ready to run
+ * Return Value: None */
+void scheduler_enqueue(PCB_BLOCK_t* process) {
+    uint32_t flags;
+    spin_lock_irqsave(&sched_lock, flags);
+    scheduler_enqueue_locked(process);
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* PCB_BLOCK_t* run_queue_pop(cpu_t* cpu)
+ * Inputs: cpu - processor whose queue to take from
+ * Return Value: the process at the front of the run queue, NULL if it's empty
+ * sched_lock must be held */
+static PCB_BLOCK_t* run_queue_pop(cpu_t* cpu) {
+    PCB_BLOCK_t* process = cpu->run_queue_head;
+    if(process != NULL) {
+        cpu->run_queue_head = process->run_next;
+        if(cpu->run_queue_head == NULL)
+            cpu->run_queue_tail = NULL;
+        cpu->run_queue_length--;
+        process->run_next = NULL;
+    }
+    return process;
+}
+
+/* int32_t can_migrate(PCB_BLOCK_t* process, cpu_t* from, uint32_t allow_hot)
+ * Inputs: process - process queued on from
+ *         from - processor we would take it off
+ *         allow_hot - whether a process that just ran there may still move
+ * Return Value: 1 if moving it is worth it, 0 if not
+ * A process whose registers are still in from's FPU can't move, fpu_switch would
+ * never save them. One that ran a tick or two ago still has its working set in
+ * from's cache, so we'd rather leave it there. sched_lock must be held */
+static int32_t can_migrate(PCB_BLOCK_t* process, cpu_t* from, uint32_t allow_hot) {
+    if(from->fpu_owner == process->pid)
+        return 0;
+    if(!allow_hot && from->ticks - process->last_ran < CACHE_HOT_TICKS)
+        return 0;
+    return 1;
+}
+
+/* PCB_BLOCK_t* run_queue_take(cpu_t* from, uint32_t allow_hot)
+ * Inputs: from - processor whose queue to take from
+ *         allow_hot - whether cache-hot processes may be taken
+ * Return Value: the process that has waited longest among those allowed to move,
+ *               NULL if there is none. sched_lock must be held */
+static PCB_BLOCK_t* run_queue_take(cpu_t* from, uint32_t allow_hot) {
+    PCB_BLOCK_t* prev = NULL;
+    PCB_BLOCK_t* process = from->run_queue_head;
+
+    while(process != NULL && !can_migrate(process, from, allow_hot)) {
+        prev = process;
+        process = process->run_next;
+    }
+    if(process == NULL)
+        return NULL;
+
+    if(prev != NULL)
+        prev->run_next = process->run_next;
+    else
+        from->run_queue_head = process->run_next;
+    if(from->run_queue_tail == process)
+        from->run_queue_tail = prev;
+    from->run_queue_length--;
+    process->run_next = NULL;
+    return process;
+}
+
+/* cpu_t* busiest_cpu(cpu_t* self)
+ * Inputs: self - processor looking for work
+ * Return Value: the other online processor with the most queued processes,
+ *               NULL if nobody has anything waiting. sched_lock must be held */
+static cpu_t* busiest_cpu(cpu_t* self) {
+    cpu_t* busiest = NULL;
+    uint8_t i;
+
+    for(i = 0; i < num_cpus; i++) {
+        if(&cpus[i] == self || !cpus[i].online || cpus[i].run_queue_length == 0)
+            continue;
+        if(busiest == NULL || cpus[i].run_queue_length > busiest->run_queue_length)
+            busiest = &cpus[i];
+    }
+    return busiest;
+}
+
+/* PCB_BLOCK_t* scheduler_migrate(cpu_t* from, cpu_t* to, uint32_t allow_hot)
+ * Inputs: from - processor to take a queued process off
+ *         to - processor it moves to, this one
+ *         allow_hot - whether cache-hot processes may be taken
+ * Return Value: the process now at the back of to's queue, NULL if none could move
+ * sched_lock must be held */
+static PCB_BLOCK_t* scheduler_migrate(cpu_t* from, cpu_t* to, uint32_t allow_hot) {
+    PCB_BLOCK_t* process = run_queue_take(from, allow_hot);
+    if(process == NULL)
+        return NULL;
+
+    process->cpu = to->id;
+    // nothing of it is in our cache yet
+    process->last_ran = to->ticks - CACHE_HOT_TICKS;
+    from->migrations_out++;
+    to->migrations_in++;
+    scheduler_enqueue_locked(process);
+    return process;
+}
+
+/* PCB_BLOCK_t* scheduler_steal(cpu_t* cpu)
+ * Inputs: cpu - processor whose run queue ran dry, this one
+ * Return Value: process taken from the busiest processor, NULL if there was none
+ * An idle processor is worth more than a warm cache, so when every queued process
+ * is cache-hot we take one of those anyway. sched_lock must be held */
+static PCB_BLOCK_t* scheduler_steal(cpu_t* cpu) {
+    cpu_t* victim = busiest_cpu(cpu);
+    PCB_BLOCK_t* process;
+
+    if(victim == NULL)
+        return NULL;
+    process = scheduler_migrate(victim, cpu, 0);
+    if(process == NULL)
+        process = scheduler_migrate(victim, cpu, 1);
+    if(process != NULL)
+        cpu->steals++;
+    return process;
+}
+
+/* void scheduler_rebalance(cpu_t* cpu)
+ * Inputs: cpu - processor doing the check, this one
+ * Return Value: None
+ * Pulls one cold process over when the busiest processor has REBALANCE_THRESHOLD
+ * more to do than we do. A busy processor never steals, so without this two
+ * processes could share one processor while another runs just one. sched_lock must be held */
+static void scheduler_rebalance(cpu_t* cpu) {
+    cpu_t* busiest = busiest_cpu(cpu);
+
+    if(busiest == NULL || cpu_load(busiest) < cpu_load(cpu) + REBALANCE_THRESHOLD)
+        return;
+    scheduler_migrate(busiest, cpu, 0);
+}
+
+/* void scheduler_map_process(PCB_BLOCK_t* process)
+ * Inputs: process - process that is about to run on this processor
+ * Return Value: None
+ * Loads the process's page directory and points its vidmap page at real video
+ * memory only if the process's terminal is the one on screen. Kernel threads get
+ * the kernel's directory, so no processor is left on a directory that gets freed */
+void scheduler_map_process(PCB_BLOCK_t* process) {
+    cpu_t* cpu = this_cpu();
+    cpu->tss.esp0 = process->kernel_stack_top;
+
+    if(process->flags & PROCESS_FLAG_KTHREAD) {
+        page_dir_load(page_directory);
+        return;
+    }
+
+    // threads share their leader's directory
+    PCB_BLOCK_t* leader = process->leader;
+    uint32_t vid_entry;
+    if(current_term == process->terminal_idx) {
         // we also want to map vidmap page -> 0xB8000
-        page_table_vid[0] = (VIDEO_MEM_FULL_ADDR) | USER_READ_WRITE_PRESENT_ENABLE;			
-        page_directory[page_dir] = (unsigned int)(page_table_vid);
-        page_directory[page_dir] |= USER_READ_WRITE_PRESENT_ENABLE;
+        vid_entry = (VIDEO_MEM_FULL_ADDR) | USER_READ_WRITE_PRESENT_ENABLE;
     } else {
         // we also want to map vidmap page -> physical backup buffers
-        page_table_vid[0] = (physical_terminal_addresses[process_to]) | USER_READ_WRITE_PRESENT_ENABLE;			
-        page_directory[page_dir] = (unsigned int)(page_table_vid);
-        page_directory[page_dir] |= USER_READ_WRITE_PRESENT_ENABLE;
+        vid_entry = (physical_terminal_addresses[process->terminal_idx]) | USER_READ_WRITE_PRESENT_ENABLE;
+    }
+
+    if(leader->page_table_vid[0] == vid_entry) {
+        page_dir_load(leader->page_directory);
+        return;
+    }
+    leader->page_table_vid[0] = vid_entry;
+
+    // loading a different directory flushes the old vidmap entry anyway
+    if(!page_dir_load(leader->page_directory))
+        tlb_flush_page(PROGRAM_IMAGE_END_ADDRESS, TLB_REASON_VIDMAP);
+}
+
+/* void scheduler_reap_after_switch(PCB_BLOCK_t* process)
+ * Inputs: process - zombie nobody is going to wait for
+ * Return Value: None
+ * The process is still standing on its kernel stack, so the next process on this
+ * processor frees it in schedule_tail. sched_lock must be held */
+void scheduler_reap_after_switch(PCB_BLOCK_t* process) {
+    this_cpu()->reap_pending = process;
+}
+
+/* void schedule_tail()
+ * Inputs: None
+ * Return Value: None
+ * Runs on the new stack right after every switch, still holding sched_lock */
+void schedule_tail() {
+    cpu_t* cpu = this_cpu();
+    if(cpu->reap_pending != NULL) {
+        process_free(cpu->reap_pending);
+        cpu->reap_pending = NULL;
     }
+}
 
-    /* switch process paging */
-    uint32_t four_mb_page_start = PCB_KERNEL_PHYSICAL_ADDRESS + all_process[multi_process_idx[process_to]].PCB->pid * PROCESS_USER_PHYSICAL_OFFSET;
-    // page is 4MB aligned
-    uint32_t page_dir_entry = four_mb_page_start | RW_USER_PRESENT_4MB_MASK;
-    page_directory[PROCESS_VIRTUAL_ADDRESS_START >> BITSHIFT_PAGE_OFFSET] = page_dir_entry;
+/* void scheduler_unlock()
+ * Inputs: None
+ * Return Value: None
+ * A process switched to for the first time doesn't return through schedule_locked,
+ * so process_first_run and kthread_first_run drop the lock its switcher held */
+void scheduler_unlock() {
+    spin_unlock(&sched_lock);
+}
 
-    // if current_term == currently scheduled process, changed video memory to be mapped to actual video memory
-    // else change video memory to be mapped to the actual physical memory buffer
+/* void schedule_locked()
+ * Inputs: None
+ * Return Value: None
+ * Puts the current process back on the run queue if it can still run, and switches to
+ * whoever is at the front of this processor's queue. Falls back to the idle loop when
+ * nothing is runnable. sched_lock must be held with interrupts off. The lock stays held
+ * across the switch and is dropped by whoever we switched to, so no other processor
+ * can pick up prev before we are off its stack */
+void schedule_locked() {
+    cpu_t* cpu = this_cpu();
+    PCB_BLOCK_t* prev = (cpu->current_pid == NO_PID) ? NULL : PCB[cpu->current_pid];
+    PCB_BLOCK_t* next;
 
-    // flush tlb
-    asm volatile ("movl %cr3,%eax; movl %eax,%cr3");
+    if(prev != NULL && prev->state == PROCESS_RUNNABLE)
+        scheduler_enqueue_locked(prev);
 
-    uint32_t kernel_stack_base_ptr = PCB_KERNEL_PHYSICAL_ADDRESS - sizeof(int) - (all_process[multi_process_idx[process_to]].PCB->pid * PCB_KERNEL_PHYSICAL_OFFSET);
-    tss.esp0 = kernel_stack_base_ptr;
+    next = run_queue_pop(cpu);
+    if(next == NULL && num_cpus > 1 && scheduler_steal(cpu) != NULL)
+        next = run_queue_pop(cpu);
+    if(next == prev)
+        return;
 
-    // only allow typing on active terminal (this also has the super-nice side effect of making sure
-    // that anything involving typing such as running commands or scrolling works properly on its own
-    // terminal)
-    if(process_to != current_term && !keyboard_disabled) {
-        disable_irq(1);
-        keyboard_disabled = 1;
+    if(prev != NULL) {
+        prev->last_ran = cpu->ticks;
+        kstack_check(prev);
     }
-    else if(process_to == current_term && keyboard_disabled) {
-        enable_irq(1);
-        keyboard_disabled = 0;
+
+    if(next != NULL) {
+        scheduler_map_process(next);
+        cpu->current_pid = next->pid;
+    } else {
+        page_dir_load(page_directory);
+        cpu->current_pid = NO_PID;
     }
+    fpu_switch(cpu->current_pid);
 
-    send_eoi(PIT_IRQ);
+    context_switch((prev != NULL) ? &prev->context_esp : &cpu->idle_context_esp,
+                   (next != NULL) ? next->context_esp : cpu->idle_context_esp);
 
-    /* restore esp/ebp */
-    asm ("movl %0, %%esp;\n"
-        "movl %1, %%ebp;\n"
-        :
-        : "g"(all_process[multi_process_idx[process_to]].saved_esp), "g"(all_process[multi_process_idx[process_to]].saved_ebp)
-        : "memory", "cc"
-        );
+    schedule_tail();
+}
+
+/* void schedule()
+ * Inputs: None
+ * Return Value: None
+ * Takes sched_lock and switches to the next process, see schedule_locked.
+ * Interrupts are still off once this process is switched back to */
+void schedule() {
+    uint32_t flags;
+    spin_lock_irqsave(&sched_lock, flags);
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
 }
 
 /* void scheduler_step()
  * Inputs: None
  * Return Value: None
- * called after 1 time-slice, i.e after PIT interrupt is triggered */
+ * called after 1 time-slice, i.e after the PIT or local APIC timer interrupt is triggered */
 void scheduler_step() {
+    uint32_t flags;
+    cpu_t* cpu;
 
-    if(num_multiprocess != MAX_MULTIPROCESS_NUM) {
-        if(num_multiprocess > 0) {
-            // since we have a esp/ebp to save, let's save it
-            // save our current esp, ebp into its multiprocess struct
-            asm ("movl %%esp, %0;\n"
-                "movl %%ebp, %1;\n"
-                : "=g"(all_process[multi_process_idx[num_multiprocess - 1]].saved_esp), "=g"(all_process[multi_process_idx[num_multiprocess - 1]].saved_ebp)
-                :
-                : "memory", "cc"
-                );
-        }
+    spin_lock_irqsave(&sched_lock, flags);
+    cpu = this_cpu();
+    cpu->ticks++;
+    if(cpu->current_pid == NO_PID)
+        cpu->idle_ticks++;
+    if(cpu->id == 0) {
+        vdata_tick_locked(cpu->ticks);
+        swap_tick_locked(cpu->ticks);
+        poll_tick_locked(cpu->ticks);
+    }
+    if(num_cpus > 1 && cpu->ticks % REBALANCE_TICKS == 0)
+        scheduler_rebalance(cpu);
+    schedule_locked();
+    spin_unlock_irqrestore(&sched_lock, flags);
+}
 
-        // setup new process struct
-        process_t process;
-        process.PCB = PCB[num_multiprocess];
-        process.active_terminal_idx = num_multiprocess;
-        
-        current_process_pid = num_multiprocess;
-
-        multi_process_idx[num_multiprocess] = num_multiprocess;
-        all_process[multi_process_idx[num_multiprocess]] = process;
-        terminal_switch(num_multiprocess, 0);
-        num_multiprocess++;
-        // allow for another PIT interrupt
-        send_eoi(PIT_IRQ);
-        sys_execute((uint8_t *) "shell");
-    } else {
-        // if we aren't on the default terminal yet, switch to it
-        if(!on_default_term) {
-            terminal_switch(0, 1);
-            on_default_term = 1;
-            draw_status_bar();
+/* void scheduler_idle()
+ * Inputs: None
+ * Return Value: None, never returns
+ * Where every processor parks once it is done booting, and where the scheduler
+ * resumes it whenever it has nothing to run. Spare time goes into zeroing frames
+ * ahead of the page faults that will want them, then we halt until the next interrupt */
+void scheduler_idle() {
+    while(1) {
+        if(frame_zero_pool_refill() == 0)
+            asm volatile ("hlt");
+    }
+}
+
+/* int32_t scheduler_get_stats(uint32_t cpu_idx, sched_stats_t* stats)
+ * Inputs: cpu_idx - index of the processor
+ *         stats - where to copy its counters
+ * Return Value: 0 on success, -1 if there is no such processor
+ * stats may be a user page that isn't present, so it is only written once
+ * sched_lock is dropped */
+int32_t scheduler_get_stats(uint32_t cpu_idx, sched_stats_t* stats) {
+    sched_stats_t snapshot;
+    uint32_t flags;
+    cpu_t* cpu;
+
+    if(cpu_idx >= num_cpus)
+        return -1;
+    cpu = &cpus[cpu_idx];
+
+    spin_lock_irqsave(&sched_lock, flags);
+    snapshot.online = cpu->online;
+    snapshot.ticks = cpu->ticks;
+    snapshot.idle_ticks = cpu->idle_ticks;
+    snapshot.run_queue_length = cpu->run_queue_length;
+    snapshot.steals = cpu->steals;
+    snapshot.migrations_in = cpu->migrations_in;
+    snapshot.migrations_out = cpu->migrations_out;
+    spin_unlock_irqrestore(&sched_lock, flags);
+
+    memcpy(stats, &snapshot, sizeof(sched_stats_t));
+    return 0;
+}
+
+/* void scheduler_ipi_handler()
+ * Inputs: None
+ * Return Value: None
+ * Another processor queued work for us or switched terminals. The vidmap page of
+ * whatever runs here may point at the wrong place now, so map it again before
+ * picking who runs next */
+void scheduler_ipi_handler() {
+    cpu_t* cpu;
+
+    lapic_eoi();
+    cpu = this_cpu();
+    if(cpu->current_pid != NO_PID)
+        scheduler_map_process(PCB[cpu->current_pid]);
+    schedule();
+}
+
+/* void scheduler_kick_others()
+ * Inputs: None
+ * Return Value: None
+ * Sends a reschedule IPI to every other processor that is up */
+void scheduler_kick_others() {
+    cpu_t* self;
+    uint8_t i;
+
+    if(!apic_enabled)
+        return;
+    self = this_cpu();
+    for(i = 0; i < num_cpus; i++) {
+        if(&cpus[i] != self && cpus[i].online)
+            lapic_send_ipi(cpus[i].apic_id, RESCHED_VECTOR);
+    }
+}
+
+/* void wait_queue_init(wait_queue_t* queue)
+ * Inputs: queue - queue to empty
+ * Return Value: None */
+void wait_queue_init(wait_queue_t* queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+/* void sleep_on(wait_queue_t* queue)
+ * Inputs: queue - where to wait
+ * Return Value: None
+ * Blocks the current process until wake_up(queue). Callers check their condition
+ * while holding sched_lock and loop, so a wake up can't slip in between. The lock
+ * is held again once we return */
+void sleep_on(wait_queue_t* queue) {
+    PCB_BLOCK_t* current_PCB = PCB[current_process_pid];
+
+    current_PCB->state = PROCESS_BLOCKED;
+    current_PCB->wait_next = NULL;
+    if(queue->tail != NULL)
+        queue->tail->wait_next = current_PCB;
+    else
+        queue->head = current_PCB;
+    queue->tail = current_PCB;
+
+    schedule_locked();
+}
+
+/* void wake_up_locked(wait_queue_t* queue)
+ * Inputs: queue - queue to empty
+ * Return Value: None
+ * sched_lock must be held */
+void wake_up_locked(wait_queue_t* queue) {
+    PCB_BLOCK_t* process;
+    PCB_BLOCK_t* next;
+
+    process = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    while(process != NULL) {
+        next = process->wait_next;
+        process->wait_next = NULL;
+        if(process->state == PROCESS_BLOCKED) {
+            process->state = PROCESS_RUNNABLE;
+            scheduler_enqueue_locked(process);
         }
+        process = next;
+    }
+}
+
+/* void wake_up_one_locked(wait_queue_t* queue)
+ * Inputs: queue - queue to take the front of
+ * Return Value: None
+ * For handing something over to exactly one sleeper, the rest keep sleeping.
+ * sched_lock must be held */
+void wake_up_one_locked(wait_queue_t* queue) {
+    PCB_BLOCK_t* process;
 
-        uint8_t old_process = current_multiprocess;
-        current_multiprocess = (current_multiprocess + 1) % num_multiprocess;
-        process_context_switch(old_process, current_multiprocess);
-        
+    while((process = queue->head) != NULL) {
+        queue->head = process->wait_next;
+        if(queue->head == NULL)
+            queue->tail = NULL;
+        process->wait_next = NULL;
+        if(process->state == PROCESS_BLOCKED) {
+            process->state = PROCESS_RUNNABLE;
+            scheduler_enqueue_locked(process);
+            return;
+        }
     }
-    return;
+}
+
+/* void wake_up(wait_queue_t* queue)
+ * Inputs: queue - queue to empty
+ * Return Value: None
+ * Safe to call from interrupt handlers */
+void wake_up(wait_queue_t* queue) {
+    uint32_t flags;
+    spin_lock_irqsave(&sched_lock, flags);
+    wake_up_locked(queue);
+    spin_unlock_irqrestore(&sched_lock, flags);
 }
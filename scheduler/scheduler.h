@@ -6,20 +6,18 @@
 #include "../interrupts/syscall_structs.h"
 #include "../devices/keyboard.h"
 #include "../i8259.h"
+#include "../spinlock.h"
+#include "smp.h"
 
-// for the 3 shells we are running
-#define MAX_MULTIPROCESS_NUM 3
+// EFLAGS a new process starts with, only IF set
+#define USER_EFLAGS 0x202
 
-typedef struct {
-    // the PCB block for each process
-    PCB_BLOCK_t* PCB;
-    // saved kernel esp
-    uint32_t saved_esp;
-    // saved kernel ebp
-    uint32_t saved_ebp;
-    // which terminal is process running on
-    uint8_t active_terminal_idx;
-} process_t;
+// a process that ran within this many ticks still has a warm cache where it ran
+#define CACHE_HOT_TICKS 3
+// every processor checks this often whether it should pull work from the busiest one
+#define REBALANCE_TICKS 20
+// and only does when the busiest one has at least this many more processes than it
+#define REBALANCE_THRESHOLD 2
 
 /* init stuff relating to scheduler */
 extern void scheduler_init();
@@ -27,17 +25,69 @@ extern void scheduler_init();
 /* called after 1 time-slice, i.e after PIT interrupt is triggered */
 extern void scheduler_step();
 
-/* performs a context switch between kernel stacks of two different processes */
-extern void process_context_switch(uint8_t process_from, uint8_t process_to);
+/* copies the counters of processor cpu_idx into stats, -1 if there is no such processor */
+extern int32_t scheduler_get_stats(uint32_t cpu_idx, sched_stats_t* stats);
 
-// this is where all the process_t structs are stored
-extern process_t all_process[MAX_PROCESSES];
+/* protects the run queues, wait queues, process states and the process tree,
+ * taken with interrupts off and held across context_switch */
+extern spinlock_t sched_lock;
 
-// this is where the indexes of the processes im currently scheduling are stored
-extern uint8_t multi_process_idx[MAX_MULTIPROCESS_NUM];
+/* switches to the next runnable process, must be called with interrupts off */
+extern void schedule();
 
-// which idx in multi_process_idx is currently scheduled
-extern uint8_t current_multiprocess;
+/* same as schedule, for callers that already hold sched_lock */
+extern void schedule_locked();
+
+/* drops sched_lock for a process that was just switched to for the first time */
+extern void scheduler_unlock();
+
+/* puts a runnable process at the back of its processor's run queue */
+extern void scheduler_enqueue(PCB_BLOCK_t* process);
+
+/* same as scheduler_enqueue, sched_lock must be held */
+extern void scheduler_enqueue_locked(PCB_BLOCK_t* process);
+
+/* reschedule IPI from another processor */
+extern void scheduler_ipi_handler();
+
+/* makes every other processor remap its current process and reschedule */
+extern void scheduler_kick_others();
+
+/* loads process's page directory, maps its vidmap page and points the TSS at its kernel stack */
+extern void scheduler_map_process(PCB_BLOCK_t* process);
+
+/* frees process once we are no longer running on its kernel stack */
+extern void scheduler_reap_after_switch(PCB_BLOCK_t* process);
+
+/* idle loop of every processor, zeroes frames for the page fault path while nothing runs */
+extern void scheduler_idle();
+
+/* finishes a switch on the new process's stack */
+extern void schedule_tail();
+
+/* empties a wait queue */
+extern void wait_queue_init(wait_queue_t* queue);
+
+/* blocks the current process until someone calls wake_up on queue, sched_lock must be held */
+extern void sleep_on(wait_queue_t* queue);
+
+/* makes every process sleeping on queue runnable again */
+extern void wake_up(wait_queue_t* queue);
+
+/* same as wake_up, sched_lock must be held */
+extern void wake_up_locked(wait_queue_t* queue);
+
+/* makes only the longest sleeper on queue runnable again, sched_lock must be held */
+extern void wake_up_one_locked(wait_queue_t* queue);
+
+/* saves callee-saved registers and esp into *save_esp, then resumes the stack at load_esp */
+extern void context_switch(uint32_t* save_esp, uint32_t load_esp);
+
+/* where a new process's first context_switch returns to, irets into user space */
+extern void process_first_run();
+
+// process in the foreground of each terminal, shown on the status bar
+extern uint8_t terminal_foreground_pid[MAX_TERMINALS];
 
 #endif
 
@@ -0,0 +1,338 @@
+#include "smp.h"
+#include "fpu.h"
+#include "scheduler.h"
+#include "../apic.h"
+#include "../lib.h"
+#include "../devices/pit.h"
+#include "../paging/page_structs.h"
+#include "../paging/page_pool.h"
+#include "../paging/tlb.h"
+#include "../interrupts/sysenter.h"
+
+cpu_t cpus[MAX_CPUS];
+uint8_t num_cpus = 1;
+
+// cpus[] index of every APIC id, filled in before the other processors start
+static uint8_t apic_id_to_cpu[256];
+
+// low pages we identity mapped to read the BIOS areas and hold the trampoline
+static uint8_t low_mem_mapped[LOW_MEM_END / PG_BASE_SIZE];
+
+// what lgdt wants, no padding in front unlike x86_desc_t
+typedef struct __attribute__((packed)) gdtr {
+    uint16_t limit;
+    uint32_t base;
+} gdtr_t;
+
+/* cpu_t* this_cpu()
+ * Inputs: None
+ * Return Value: the processor we are running on
+ * Interrupts should be off, or the answer may change under the caller */
+cpu_t* this_cpu() {
+    if(!apic_enabled)
+        return &cpus[0];
+    return &cpus[apic_id_to_cpu[lapic_id()]];
+}
+
+/* uint8_t this_cpu_pid()
+ * Inputs: None
+ * Return Value: pid of the process we are running in, NO_PID on an idle processor
+ * Safe with interrupts on: we can't be moved between finding our processor and
+ * reading its pid, and once read the pid stays ours wherever we get moved to */
+uint8_t this_cpu_pid() {
+    uint32_t flags;
+    uint8_t pid;
+
+    cli_and_save(flags);
+    pid = this_cpu()->current_pid;
+    restore_flags(flags);
+    return pid;
+}
+
+/* void cpu_load_descriptors(cpu_t* cpu)
+ * Inputs: cpu - processor we are running on
+ * Return Value: None
+ * Every processor needs its own TSS for esp0, and ltr marks the TSS descriptor
+ * busy, so each one gets a copy of the GDT with its own TSS entry in it */
+static void cpu_load_descriptors(cpu_t* cpu) {
+    seg_desc_t the_tss_desc;
+    gdtr_t gdtr;
+
+    memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+
+    the_tss_desc = tss_desc_ptr;
+    SET_TSS_PARAMS(the_tss_desc, &cpu->tss, tss_size);
+    // ltr on the boot GDT already set the busy bit in the copy
+    the_tss_desc.type = 0x9;
+    cpu->gdt[KERNEL_TSS >> 3] = the_tss_desc;
+
+    memset(&cpu->tss, 0, sizeof(cpu->tss));
+    cpu->tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->tss.ss0 = KERNEL_DS;
+    cpu->tss.esp0 = tss.esp0;
+
+    gdtr.limit = sizeof(cpu->gdt) - 1;
+    gdtr.base = (uint32_t) cpu->gdt;
+    asm volatile ("lgdt (%0)" : : "r"(&gdtr) : "memory");
+
+    ltr(KERNEL_TSS);
+    lldt(KERNEL_LDT);
+
+    // sysenter finds the kernel stack through this processor's TSS
+    sysenter_init_cpu(cpu);
+}
+
+/* void low_mem_map(uint32_t addr, uint32_t size)
+ * Inputs: addr, size - physical range below 1MB
+ * Return Value: None
+ * Identity maps the pages of the range that aren't mapped already */
+static void low_mem_map(uint32_t addr, uint32_t size) {
+    uint32_t page;
+
+    for(page = addr / PG_BASE_SIZE; page < LOW_MEM_END / PG_BASE_SIZE && page * PG_BASE_SIZE < addr + size; page++) {
+        if(page_table[page] & PAGE_PRESENT_MASK)
+            continue;
+        page_table[page] = (page * PG_BASE_SIZE) | RW_SUPERVISOR_PRESENT_MASK;
+        low_mem_mapped[page] = 1;
+    }
+
+    tlb_flush_range(addr, addr + size, TLB_REASON_LOW_MEM);
+}
+
+/* void low_mem_unmap(uint32_t addr, uint32_t size)
+ * Inputs: addr, size - physical range below 1MB
+ * Return Value: None
+ * Takes back the pages low_mem_map added, so stray NULL pointers fault again */
+static void low_mem_unmap(uint32_t addr, uint32_t size) {
+    uint32_t page;
+
+    for(page = addr / PG_BASE_SIZE; page < LOW_MEM_END / PG_BASE_SIZE && page * PG_BASE_SIZE < addr + size; page++) {
+        if(!low_mem_mapped[page])
+            continue;
+        page_table[page] = EMPTY_ENTRY | RW_SUPERVISOR_ABSENT_MASK;
+        low_mem_mapped[page] = 0;
+    }
+
+    tlb_flush_range(addr, addr + size, TLB_REASON_LOW_MEM);
+}
+
+/* uint8_t mp_checksum(uint8_t* addr, uint32_t len)
+ * Inputs: addr, len - bytes to add up
+ * Return Value: 0 if the structure is intact */
+static uint8_t mp_checksum(uint8_t* addr, uint32_t len) {
+    uint8_t sum = 0;
+    uint32_t i;
+    for(i = 0; i < len; i++)
+        sum += addr[i];
+    return sum;
+}
+
+/* mp_float_t* mp_search(uint32_t addr, uint32_t len)
+ * Inputs: addr, len - mapped physical range to scan
+ * Return Value: the floating pointer structure if it is in the range, NULL otherwise */
+static mp_float_t* mp_search(uint32_t addr, uint32_t len) {
+    uint32_t p;
+    mp_float_t* mp;
+
+    for(p = addr; p + sizeof(mp_float_t) <= addr + len; p += MP_FLOAT_ALIGN) {
+        mp = (mp_float_t *) p;
+        if(strncmp(mp->signature, (int8_t *) "_MP_", sizeof(mp->signature)) == 0 &&
+           mp_checksum((uint8_t *) mp, mp->length * MP_FLOAT_ALIGN) == 0)
+            return mp;
+    }
+    return NULL;
+}
+
+/* mp_float_t* mp_find()
+ * Inputs: None
+ * Return Value: the MP floating pointer structure, NULL on a uniprocessor machine
+ * Looks where the MP spec says to: the first KB of the EBDA, the last KB of base
+ * memory and the BIOS ROM. Everything below 1MB is left mapped for mp_parse */
+static mp_float_t* mp_find() {
+    mp_float_t* mp;
+    uint32_t ebda;
+    uint32_t base_mem_end;
+
+    low_mem_map(0, LOW_MEM_END);
+
+    ebda = (uint32_t) *((uint16_t *) BDA_EBDA_SEGMENT) << 4;
+    if(ebda != 0 && (mp = mp_search(ebda, MP_SEARCH_SIZE)) != NULL)
+        return mp;
+
+    base_mem_end = (uint32_t) *((uint16_t *) BDA_BASE_MEM_KB) * 1024;
+    if(base_mem_end >= MP_SEARCH_SIZE && (mp = mp_search(base_mem_end - MP_SEARCH_SIZE, MP_SEARCH_SIZE)) != NULL)
+        return mp;
+
+    return mp_search(BIOS_ROM_START, BIOS_ROM_SIZE);
+}
+
+/* int32_t mp_parse(mp_float_t* mp, uint32_t* lapic_addr, uint32_t* ioapic_addr)
+ * Inputs: mp - floating pointer structure found by mp_find
+ *         lapic_addr, ioapic_addr - where the APIC registers are
+ * Return Value: 0 if we found an I/O APIC, -1 if we should stay on the PICs
+ * Fills in cpus[] and num_cpus, the boot processor always ends up as cpus[0],
+ * and hands the ISA interrupt assignments to the APIC code */
+static int32_t mp_parse(mp_float_t* mp, uint32_t* lapic_addr, uint32_t* ioapic_addr) {
+    mp_config_t* config;
+    uint8_t* entry;
+    uint8_t isa_bus_id = NO_CPU;
+    uint32_t i;
+
+    // default configurations without a table, and tables we haven't mapped, are left alone
+    if(mp->config_table == 0 || mp->config_table + sizeof(mp_config_t) > LOW_MEM_END)
+        return -1;
+    config = (mp_config_t *) mp->config_table;
+    if(strncmp(config->signature, (int8_t *) "PCMP", sizeof(config->signature)) != 0 ||
+       mp->config_table + config->length > LOW_MEM_END ||
+       mp_checksum((uint8_t *) config, config->length) != 0)
+        return -1;
+
+    *lapic_addr = config->lapic_addr;
+    *ioapic_addr = 0;
+    num_cpus = 1;
+
+    entry = (uint8_t *) (config + 1);
+    for(i = 0; i < config->entry_count; i++) {
+        switch(*entry) {
+            case MP_ENTRY_PROCESSOR: {
+                mp_processor_t* proc = (mp_processor_t *) entry;
+                if(proc->flags & MP_CPU_BSP)
+                    cpus[0].apic_id = proc->apic_id;
+                else if((proc->flags & MP_CPU_ENABLED) && num_cpus < MAX_CPUS)
+                    cpus[num_cpus++].apic_id = proc->apic_id;
+                entry += MP_PROCESSOR_SIZE;
+                break;
+            }
+            case MP_ENTRY_BUS: {
+                mp_bus_t* bus = (mp_bus_t *) entry;
+                if(strncmp(bus->bus_type, (int8_t *) "ISA", 3) == 0)
+                    isa_bus_id = bus->bus_id;
+                entry += MP_OTHER_ENTRY_SIZE;
+                break;
+            }
+            case MP_ENTRY_IOAPIC: {
+                mp_ioapic_t* ioapic = (mp_ioapic_t *) entry;
+                // ISA IRQs all sit on the first I/O APIC
+                if((ioapic->flags & MP_IOAPIC_ENABLED) && *ioapic_addr == 0)
+                    *ioapic_addr = ioapic->addr;
+                entry += MP_OTHER_ENTRY_SIZE;
+                break;
+            }
+            case MP_ENTRY_IO_INTERRUPT: {
+                mp_io_interrupt_t* intr = (mp_io_interrupt_t *) entry;
+                if(intr->int_type == MP_INTR_INT && intr->src_bus == isa_bus_id)
+                    apic_set_isa_route(intr->src_irq, intr->dst_pin, intr->flags);
+                entry += MP_OTHER_ENTRY_SIZE;
+                break;
+            }
+            case MP_ENTRY_LOCAL_INTERRUPT:
+                entry += MP_OTHER_ENTRY_SIZE;
+                break;
+            default:
+                // don't know how long it is, so we can't go any further
+                i = config->entry_count;
+                break;
+        }
+    }
+
+    return (*ioapic_addr != 0) ? 0 : -1;
+}
+
+/* int32_t smp_start_ap(cpu_t* cpu)
+ * Inputs: cpu - processor to start, its apic_id is filled in
+ * Return Value: 0 once it checked in, -1 if it never did
+ * Gives the processor an idle stack, hands it and the kernel's page directory to
+ * the trampoline and sends it the startup IPIs. Processes bring their own
+ * directories, so the kernel one is all a processor needs while it idles */
+static int32_t smp_start_ap(cpu_t* cpu) {
+    uint8_t* stack;
+    uint32_t waited;
+
+    stack = (uint8_t *) page_pool_alloc(AP_STACK_PAGES);
+    if(stack == NULL)
+        return -1;
+
+    *((uint32_t *) (AP_TRAMPOLINE_ADDR + (&ap_boot_cr3 - &ap_trampoline))) = (uint32_t) page_directory;
+    *((uint32_t *) (AP_TRAMPOLINE_ADDR + (&ap_boot_esp - &ap_trampoline))) = (uint32_t) stack + AP_STACK_PAGES * PG_BASE_SIZE;
+
+    lapic_start_ap(cpu->apic_id, AP_TRAMPOLINE_ADDR);
+
+    for(waited = 0; waited < AP_ONLINE_TIMEOUT_MS && !cpu->online; waited++)
+        pit_delay_us(1000);
+    return cpu->online ? 0 : -1;
+}
+
+/* void smp_init()
+ * Inputs: None
+ * Return Value: None
+ * Moves the boot processor onto its own GDT/TSS. If the MP table lists more
+ * processors, switches interrupt delivery to the APICs and starts the rest.
+ * Must run with interrupts off, after paging and the page pool are up */
+void smp_init() {
+    mp_float_t* mp;
+    uint32_t lapic_addr = LAPIC_DEFAULT_BASE;
+    uint32_t ioapic_addr = IOAPIC_DEFAULT_BASE;
+    uint8_t has_imcr;
+    uint8_t* tramp_gdt_desc;
+    uint32_t i;
+
+    for(i = 0; i < MAX_CPUS; i++) {
+        cpus[i].id = i;
+        cpus[i].online = 0;
+    }
+    num_cpus = 1;
+
+    cpu_load_descriptors(&cpus[0]);
+    cpus[0].online = 1;
+
+    mp = mp_find();
+    if(mp == NULL || mp_parse(mp, &lapic_addr, &ioapic_addr) != 0 || num_cpus == 1) {
+        num_cpus = 1;
+        low_mem_unmap(0, LOW_MEM_END);
+        return;
+    }
+    has_imcr = (mp->feature2 & MP_FEATURE_IMCR) ? 1 : 0;
+    low_mem_unmap(0, LOW_MEM_END);
+
+    apic_map(lapic_addr, ioapic_addr);
+    // the MP table's BSP flag and the hardware had better agree, trust the hardware
+    cpus[0].apic_id = lapic_id();
+    for(i = 0; i < num_cpus; i++)
+        apic_id_to_cpu[cpus[i].apic_id] = i;
+    apic_enable(has_imcr);
+
+    // the trampoline loads the boot GDT, ap_main switches to the processor's own copy
+    low_mem_map(AP_TRAMPOLINE_ADDR, PG_BASE_SIZE);
+    memcpy((void *) AP_TRAMPOLINE_ADDR, &ap_trampoline, &ap_trampoline_end - &ap_trampoline);
+    tramp_gdt_desc = (uint8_t *) AP_TRAMPOLINE_ADDR + (&ap_boot_gdt_desc - &ap_trampoline);
+    *((uint16_t *) tramp_gdt_desc) = sizeof(seg_desc_t) * NUM_GDT_ENTRIES - 1;
+    *((uint32_t *) (tramp_gdt_desc + sizeof(uint16_t))) = (uint32_t) gdt;
+
+    for(i = 1; i < num_cpus; i++) {
+        if(smp_start_ap(&cpus[i]) != 0)
+            printf("cpu %d (apic %d) did not start\n", i, cpus[i].apic_id);
+    }
+
+    low_mem_unmap(AP_TRAMPOLINE_ADDR, PG_BASE_SIZE);
+}
+
+/* void ap_main()
+ * Inputs: None
+ * Return Value: None, never returns
+ * Where the other processors land from the trampoline, on their idle stack
+ * with the boot GDT and interrupts off. Once online the scheduler hands them
+ * processes from their own run queue on every local APIC timer tick */
+void ap_main() {
+    cpu_t* cpu = this_cpu();
+
+    cpu_load_descriptors(cpu);
+    lidt(idt_desc_ptr);
+    fpu_init_cpu();
+    lapic_init();
+
+    cpu->online = 1;
+    sti();
+
+    /* This is where the scheduler parks this processor whenever it has nothing to run */
+    scheduler_idle();
+}
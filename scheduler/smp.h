@@ -0,0 +1,180 @@
+/** smp.h - multiprocessor bring-up and per processor state
+ *
+ *  The boot processor finds the other processors in the MP configuration
+ *  table, switches interrupt delivery to the APICs and starts each one
+ *  through a real mode trampoline. Every processor has its own GDT, TSS,
+ *  run queue and idle loop.
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+// most processors we will bring up
+#define MAX_CPUS 8
+#define NO_CPU 0xFF
+
+// physical page the other processors start at in real mode, must be below 1MB
+#define AP_TRAMPOLINE_ADDR 0x7000
+// pages in each processor's idle stack
+#define AP_STACK_PAGES 2
+// how long we wait for a started processor to check in, in ms
+#define AP_ONLINE_TIMEOUT_MS 100
+
+#define CR0_PE_FLAG 0x00000001
+
+#ifndef ASM
+
+#include "../types.h"
+#include "../x86_desc.h"
+
+// low memory the MP floating pointer can be in
+#define BDA_EBDA_SEGMENT    0x40E
+#define BDA_BASE_MEM_KB     0x413
+#define BIOS_ROM_START      0xF0000
+#define BIOS_ROM_SIZE       0x10000
+#define LOW_MEM_END         0x100000
+#define MP_SEARCH_SIZE      1024
+#define MP_FLOAT_ALIGN      16
+
+// MP configuration table entry types and their sizes
+#define MP_ENTRY_PROCESSOR      0
+#define MP_ENTRY_BUS            1
+#define MP_ENTRY_IOAPIC         2
+#define MP_ENTRY_IO_INTERRUPT   3
+#define MP_ENTRY_LOCAL_INTERRUPT 4
+#define MP_PROCESSOR_SIZE       20
+#define MP_OTHER_ENTRY_SIZE     8
+
+#define MP_CPU_ENABLED  0x1
+#define MP_CPU_BSP      0x2
+#define MP_IOAPIC_ENABLED 0x1
+#define MP_INTR_INT     0
+// second feature byte, the machine has an IMCR
+#define MP_FEATURE_IMCR 0x80
+
+// MP floating pointer structure
+typedef struct __attribute__((packed)) mp_float {
+    int8_t signature[4];
+    uint32_t config_table;
+    uint8_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t feature1;
+    uint8_t feature2;
+    uint8_t reserved[3];
+} mp_float_t;
+
+// MP configuration table header, entries follow right after it
+typedef struct __attribute__((packed)) mp_config {
+    int8_t signature[4];
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    int8_t oem_id[8];
+    int8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+typedef struct __attribute__((packed)) mp_processor {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_processor_t;
+
+typedef struct __attribute__((packed)) mp_bus {
+    uint8_t type;
+    uint8_t bus_id;
+    int8_t bus_type[6];
+} mp_bus_t;
+
+typedef struct __attribute__((packed)) mp_ioapic {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t addr;
+} mp_ioapic_t;
+
+typedef struct __attribute__((packed)) mp_io_interrupt {
+    uint8_t type;
+    uint8_t int_type;
+    uint16_t flags;
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic;
+    uint8_t dst_pin;
+} mp_io_interrupt_t;
+
+struct PCB_BLOCK_t;
+
+// everything one processor needs to itself
+typedef struct cpu {
+    // index into cpus[]
+    uint8_t id;
+    uint8_t apic_id;
+    // set by the processor itself once it is ready to run processes
+    volatile uint8_t online;
+
+    // process running here, NO_PID while this processor idles
+    uint8_t current_pid;
+    // runnable processes waiting for this processor, linked through run_next
+    struct PCB_BLOCK_t* run_queue_head;
+    struct PCB_BLOCK_t* run_queue_tail;
+    uint32_t run_queue_length;
+    // kernel esp of this processor's idle loop while a process runs
+    uint32_t idle_context_esp;
+    // process that exited here without a parent to wait on it
+    struct PCB_BLOCK_t* reap_pending;
+
+    // timer ticks this processor took, and how many of them found it idle
+    uint32_t ticks;
+    uint32_t idle_ticks;
+    // processes taken from another processor's queue because ours ran dry
+    uint32_t steals;
+    // processes moved onto and off this processor, by stealing or rebalancing
+    uint32_t migrations_in;
+    uint32_t migrations_out;
+
+    // pid whose x87/SSE registers are loaded in this processor's FPU
+    uint8_t fpu_owner;
+
+    seg_desc_t gdt[NUM_GDT_ENTRIES] __attribute__((aligned(8)));
+    tss_t tss;
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+// processors found in the MP table, not all of them have to come online
+extern uint8_t num_cpus;
+
+/* the processor we are running on */
+extern cpu_t* this_cpu();
+
+/* the process we are running in, safe to call with interrupts on */
+extern uint8_t this_cpu_pid();
+
+/* gives the boot processor its own GDT/TSS and starts any other processors */
+extern void smp_init();
+
+/* C entry point of the other processors, called from the trampoline */
+extern void ap_main();
+
+/* trampoline code and the parameters the boot processor fills in, see ap_trampoline.S */
+extern uint8_t ap_trampoline;
+extern uint8_t ap_trampoline_end;
+extern uint8_t ap_boot_gdt_desc;
+extern uint8_t ap_boot_cr3;
+extern uint8_t ap_boot_esp;
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
@@ -0,0 +1,98 @@
+#include "workqueue.h"
+#include "kthread.h"
+#include "scheduler.h"
+#include "../lib.h"
+#include "../spinlock.h"
+
+// pending work, oldest first, linked through next
+static work_t* work_head;
+static work_t* work_tail;
+// kworker sleeps here while the queue is empty
+static wait_queue_t work_wait;
+static int32_t kworker_pid = -1;
+// guards the list, interrupt handlers on any processor queue work
+static spinlock_t work_lock = SPINLOCK_INIT;
+
+/* void work_init(work_t* work, void (*func)(uint32_t data), uint32_t data)
+ * Inputs: work - item to set up
+ *         func - what to run
+ *         data - handed to func
+ * Return Value: None */
+void work_init(work_t* work, void (*func)(uint32_t data), uint32_t data) {
+    work->func = func;
+    work->data = data;
+    work->next = NULL;
+    work->pending = 0;
+}
+
+/* int32_t queue_work(work_t* work)
+ * Inputs: work - item to run later
+ * Return Value: 1 if work was queued, 0 if it was already waiting to run
+ * Safe to call from interrupt handlers. Before the kworker is up the work
+ * just runs right away like it used to */
+int32_t queue_work(work_t* work) {
+    uint32_t flags;
+
+    if(kworker_pid < 0) {
+        work->func(work->data);
+        return 1;
+    }
+
+    spin_lock_irqsave(&work_lock, flags);
+    if(work->pending) {
+        spin_unlock_irqrestore(&work_lock, flags);
+        return 0;
+    }
+    work->pending = 1;
+    work->next = NULL;
+    if(work_tail != NULL)
+        work_tail->next = work;
+    else
+        work_head = work;
+    work_tail = work;
+    spin_unlock_irqrestore(&work_lock, flags);
+
+    wake_up(&work_wait);
+    return 1;
+}
+
+/* void kworker(uint32_t arg)
+ * Inputs: arg - unused
+ * Return Value: None, never returns
+ * Runs queued work one item at a time with interrupts on. pending is cleared
+ * before func runs, so func can queue its own work again */
+static void kworker(uint32_t arg) {
+    work_t* work;
+    uint32_t flags;
+
+    while(1) {
+        // queue_work wakes us under sched_lock after adding to the list
+        spin_lock_irqsave(&sched_lock, flags);
+        while(work_head == NULL)
+            sleep_on(&work_wait);
+        spin_unlock(&sched_lock);
+
+        spin_lock(&work_lock);
+        work = work_head;
+        work_head = work->next;
+        if(work_head == NULL)
+            work_tail = NULL;
+        work->next = NULL;
+        work->pending = 0;
+        spin_unlock_irqrestore(&work_lock, flags);
+
+        work->func(work->data);
+    }
+}
+
+/* int32_t workqueue_init()
+ * Inputs: None
+ * Return Value: pid of the kworker thread, -1 if it couldn't be started
+ * Must run after scheduler_init */
+int32_t workqueue_init() {
+    work_head = NULL;
+    work_tail = NULL;
+    wait_queue_init(&work_wait);
+    kworker_pid = kthread_create(kworker, 0, (int8_t *) "kworker");
+    return kworker_pid;
+}
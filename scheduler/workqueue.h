@@ -0,0 +1,37 @@
+/** workqueue.h - deferred work for interrupt handlers
+ *
+ *  Interrupt handlers queue a work_t and return; the kworker kernel thread
+ *  runs the queued functions later with interrupts enabled.
+ */
+
+#ifndef _WORKQUEUE_H
+#define _WORKQUEUE_H
+
+#ifndef ASM
+
+#include "../types.h"
+
+typedef struct work {
+    void (*func)(uint32_t data);
+    uint32_t data;
+    struct work* next;
+    // set while the work is on the queue, so queueing it twice runs it once
+    uint8_t pending;
+} work_t;
+
+// static initializer for a work_t
+#define WORK_INIT(f, d) { (f), (d), NULL, 0 }
+
+/* sets up a work item that runs func(data) */
+extern void work_init(work_t* work, void (*func)(uint32_t data), uint32_t data);
+
+/* queues work for the kworker thread, safe from interrupt handlers.
+ * Returns 1 if it was queued, 0 if it was already pending */
+extern int32_t queue_work(work_t* work);
+
+/* starts the kworker thread */
+extern int32_t workqueue_init();
+
+#endif /* ASM */
+
+#endif /* _WORKQUEUE_H */
@@ -0,0 +1,75 @@
+/* spinlock.h - Locks that also hold off the other processors
+ * vim:ts=4 noexpandtab
+ *
+ * cli only masks interrupts on the processor that runs it. Data shared between
+ * processors takes one of these instead, and since interrupt handlers take them
+ * too they are always grabbed with interrupts off (spin_lock_irqsave) outside
+ * of interrupt handlers.
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+#ifndef ASM
+
+typedef struct spinlock {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+/* void spin_lock_init(spinlock_t* lock);
+ * Inputs: lock -- lock to set up unlocked */
+static inline void spin_lock_init(spinlock_t* lock) {
+    lock->locked = 0;
+}
+
+/* void spin_lock(spinlock_t* lock);
+ * Inputs: lock -- lock to take
+ * Function: spins until the lock is ours. Waiting is done with plain reads
+ * so the cache line isn't bounced around while someone else holds it */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t held = 1;
+    while (1) {
+        asm volatile ("xchgl %0, %1"
+                : "+r"(held), "+m"(lock->locked)
+                :
+                : "memory"
+        );
+        if (held == 0)
+            return;
+        while (lock->locked)
+            asm volatile ("pause" : : : "memory");
+        held = 1;
+    }
+}
+
+/* void spin_unlock(spinlock_t* lock);
+ * Inputs: lock -- lock we hold
+ * Function: x86 doesn't reorder stores with older loads or stores, so a plain
+ * store is enough as long as the compiler keeps it last */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+/* Saves EFLAGS into flags, disables interrupts on this processor and takes lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+/* Drops lock and puts back the EFLAGS saved by spin_lock_irqsave */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+    spin_unlock(lock);                  \
+    restore_flags(flags);               \
+} while (0)
+
+#endif /* ASM */
+
+#endif /* _SPINLOCK_H */
@@ -4,10 +4,32 @@
 
 #include "devices/rtc.h"
 #include "devices/terminal.h"
+#include "paging/multi_terminals.h"
 #include "paging/page_structs.h"
 #include "fs/file.h"
 #include "fs/directory.h"
 #include "fs/fs.h"
+#include "paging/page_pool.h"
+#include "paging/frame_alloc.h"
+#include "paging/tlb.h"
+#include "paging/kmalloc.h"
+#include "paging/user_mem.h"
+#include "paging/shm.h"
+#include "paging/swap.h"
+#include "paging/vdata.h"
+#include "scheduler/kstack.h"
+#include "scheduler/kthread.h"
+#include "scheduler/futex.h"
+#include "scheduler/fpu.h"
+#include "interrupts/sysenter.h"
+#include "interrupts/syscall_structs.h"
+#include "scheduler/workqueue.h"
+#include "scheduler/smp.h"
+#include "spinlock.h"
+#include "scheduler/mutex.h"
+#include "fs/pipe.h"
+#include "fs/poll.h"
+#include "devices/pit.h"
 
 #define PASS 1
 #define FAIL 0
@@ -501,6 +523,1444 @@ int rtc_open_write_read_close_test() {
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* fpu_test
+ *
+ * Checks that the PCB has room for a whole, aligned fxsave image, and that
+ * fpu_switch only leaves CR0.TS clear for the process whose state is loaded
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: leaves CR0.TS set, the next FPU use traps and reloads the owner
+ * Files: fpu.c
+ */
+int fpu_test() {
+	TEST_HEADER;
+
+	uint32_t cr0;
+	uint32_t flags;
+	uint8_t owner;
+	int result = PASS;
+
+	if(sizeof(((PCB_BLOCK_t *) 0)->fpu_state) != FPU_STATE_SIZE ||
+	   ((uint32_t) &((PCB_BLOCK_t *) 0)->fpu_state) % FPU_STATE_ALIGN != 0)
+		return FAIL;
+	if(!fpu_is_enabled())
+		return PASS;
+
+	cli_and_save(flags);
+	owner = this_cpu()->fpu_owner;
+
+	fpu_switch(owner);
+	asm volatile ("movl %%cr0, %0" : "=r"(cr0));
+	if(cr0 & CR0_TS_FLAG)
+		result = FAIL;
+
+	fpu_switch(owner + 1);
+	asm volatile ("movl %%cr0, %0" : "=r"(cr0));
+	if(!(cr0 & CR0_TS_FLAG))
+		result = FAIL;
+
+	restore_flags(flags);
+	return result;
+}
+
+/* multi_term_test
+ *
+ * Checks how the terminal count is read from the boot command line, defaults and
+ * clamping included, and that every terminal brought up has its state and backup page
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: multi_terminals.c
+ */
+int multi_term_test() {
+	TEST_HEADER;
+
+	uint8_t term;
+
+	if(multi_term_parse_cmdline(NULL) != DEFAULT_NUM_TERMINALS)
+		return FAIL;
+	if(multi_term_parse_cmdline((int8_t *) "root=hd0") != DEFAULT_NUM_TERMINALS)
+		return FAIL;
+	if(multi_term_parse_cmdline((int8_t *) "quiet terminals=6 debug") != 6)
+		return FAIL;
+	if(multi_term_parse_cmdline((int8_t *) "terminals=0") != DEFAULT_NUM_TERMINALS)
+		return FAIL;
+	if(multi_term_parse_cmdline((int8_t *) "terminals=999") != MAX_TERMINALS)
+		return FAIL;
+
+	if(num_terminals == 0 || num_terminals > MAX_TERMINALS)
+		return FAIL;
+	for(term = 0; term < num_terminals; term++) {
+		if(terminals[term] == NULL || virtual_terminal_addresses[term] == 0 ||
+		   (virtual_terminal_addresses[term] & (PG_BASE_SIZE - 1)))
+			return FAIL;
+	}
+	return PASS;
+}
+
+/* process_table_alloc_test
+ *
+ * Checks that pids and kernel stacks are handed back out after being freed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, everything allocated is released again
+ * Files: syscall_structs.c, page_pool.c
+ */
+int process_table_alloc_test() {
+	TEST_HEADER;
+
+	uint8_t first, second;
+	uint32_t free_pages = page_pool_free_pages();
+	void* stack;
+
+	first = pid_alloc();
+	second = pid_alloc();
+	if(first == NO_PID || second == NO_PID || first == second)
+		return FAIL;
+	pid_release(second);
+	// the free list is LIFO, so the same pid has to come back
+	if(pid_alloc() != second)
+		return FAIL;
+	pid_release(second);
+	pid_release(first);
+
+	stack = page_pool_alloc(2);
+	if(stack == NULL || ((uint32_t) stack & (PG_BASE_SIZE - 1)))
+		return FAIL;
+	if(page_pool_free_pages() != free_pages - 2)
+		return FAIL;
+	page_pool_free(stack, 2);
+	if(page_pool_free_pages() != free_pages)
+		return FAIL;
+	return PASS;
+}
+
+/* process_leader_test
+ *
+ * Checks that a new process leads itself with no threads, so its user page and
+ * file table are its own
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the PCB is freed again
+ * Files: syscalls.c
+ */
+int process_leader_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	process = process_alloc(0, 0);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	if(process->leader != process || process->thread_count != 0 || (process->flags & PROCESS_FLAG_THREAD))
+		result = FAIL;
+
+	spin_lock(&sched_lock);
+	process_free(process);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+	return result;
+}
+
+/* run_queue_unlink
+ *
+ * Takes a process the test woke back off whichever run queue it landed on,
+ * sched_lock must be held
+ * Inputs: process -- process to take off
+ * Outputs: 1 if it was queued, 0 if not
+ */
+static int run_queue_unlink(PCB_BLOCK_t* process) {
+	PCB_BLOCK_t* prev;
+	PCB_BLOCK_t* iter;
+	uint8_t i;
+
+	for(i = 0; i < num_cpus; i++) {
+		prev = NULL;
+		for(iter = cpus[i].run_queue_head; iter != NULL; prev = iter, iter = iter->run_next) {
+			if(iter != process)
+				continue;
+			if(prev != NULL)
+				prev->run_next = iter->run_next;
+			else
+				cpus[i].run_queue_head = iter->run_next;
+			if(cpus[i].run_queue_tail == iter)
+				cpus[i].run_queue_tail = prev;
+			cpus[i].run_queue_length--;
+			iter->run_next = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* wait_queue_test
+ *
+ * Queues two blocked processes on a wait queue the way sleep_on does, then checks
+ * that wake_up_one_locked only makes the longest sleeper runnable and queues it to
+ * run, and that wake_up_locked empties the queue and skips processes that aren't blocked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, both PCBs are taken off the run queues and freed again
+ * Files: scheduler.c
+ */
+int wait_queue_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* first;
+	PCB_BLOCK_t* second;
+	wait_queue_t queue;
+	uint32_t flags;
+	int result = PASS;
+
+	wait_queue_init(&queue);
+	cli_and_save(flags);
+	first = process_alloc(0, 0);
+	second = process_alloc(0, 0);
+	spin_lock(&sched_lock);
+	if(first == NULL || second == NULL) {
+		if(first != NULL)
+			process_free(first);
+		if(second != NULL)
+			process_free(second);
+		spin_unlock(&sched_lock);
+		restore_flags(flags);
+		return FAIL;
+	}
+
+	first->state = PROCESS_BLOCKED;
+	second->state = PROCESS_BLOCKED;
+	first->wait_next = second;
+	second->wait_next = NULL;
+	queue.head = first;
+	queue.tail = second;
+
+	wake_up_one_locked(&queue);
+	if(first->state != PROCESS_RUNNABLE || second->state != PROCESS_BLOCKED || queue.head != second)
+		result = FAIL;
+	if(!run_queue_unlink(first))
+		result = FAIL;
+
+	// a process that isn't blocked anymore just leaves the queue
+	first->state = PROCESS_ZOMBIE;
+	second->wait_next = first;
+	queue.tail = first;
+	wake_up_locked(&queue);
+	if(queue.head != NULL || queue.tail != NULL || second->state != PROCESS_RUNNABLE || first->state != PROCESS_ZOMBIE)
+		result = FAIL;
+	if(!run_queue_unlink(second) || run_queue_unlink(first))
+		result = FAIL;
+
+	process_free(first);
+	process_free(second);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+	return result;
+}
+
+/* test_thread_create
+ *
+ * Starts fn(arg) as a thread of leader that stays in ring 0, so it runs in the
+ * leader's page directory and futex/user_mem see it as one of its threads.
+ * Returning from fn ends it like thread_exit
+ * Inputs: leader -- process the thread belongs to, with an address space
+ *		   fn, arg -- what the thread runs
+ * Outputs: pid of the thread, -1 if we ran out
+ */
+static int32_t test_thread_create(PCB_BLOCK_t* leader, kthread_fn_t fn, uint32_t arg) {
+	PCB_BLOCK_t* thread;
+	uint32_t* stack;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	thread = process_alloc(leader->terminal_idx, PROCESS_FLAG_THREAD);
+	if(thread == NULL) {
+		restore_flags(flags);
+		return -1;
+	}
+	thread->leader = leader;
+
+	// same first switch as kthread_create
+	stack = (uint32_t *) thread->kernel_stack_top;
+	*(--stack) = arg;
+	*(--stack) = (uint32_t) fn;
+	*(--stack) = (uint32_t) kthread_first_run;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	*(--stack) = 0;
+	thread->context_esp = (uint32_t) stack;
+
+	spin_lock(&sched_lock);
+	leader->thread_count++;
+	thread->state = PROCESS_RUNNABLE;
+	scheduler_enqueue_locked(thread);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+	return thread->pid;
+}
+
+/* test_leader_create
+ *
+ * Makes a process with its own address space for test threads to run in
+ * Inputs: None
+ * Outputs: the leader, NULL if we ran out
+ */
+static PCB_BLOCK_t* test_leader_create() {
+	PCB_BLOCK_t* leader;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	leader = process_alloc(0, 0);
+	if(leader != NULL && process_address_space_create(leader) != RETURN_PASS) {
+		spin_lock(&sched_lock);
+		process_free(leader);
+		spin_unlock(&sched_lock);
+		leader = NULL;
+	}
+	restore_flags(flags);
+	return leader;
+}
+
+/* test_leader_free
+ *
+ * Waits for every test thread of leader to exit, then frees it. sched_lock is held
+ * across the switch away from an exiting thread, so once we get it with no threads
+ * left nobody runs in the leader's page directory anymore
+ * Inputs: leader -- from test_leader_create
+ * Outputs: None
+ */
+static void test_leader_free(PCB_BLOCK_t* leader) {
+	uint32_t flags;
+
+	while(leader->thread_count > 0);
+	spin_lock_irqsave(&sched_lock, flags);
+	process_free(leader);
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+static volatile int32_t futex_test_early;
+static volatile int32_t futex_test_waited;
+static volatile int32_t futex_test_woken;
+static volatile uint32_t futex_test_done;
+static volatile int32_t futex_test_waiter_pid;
+// 0 until both threads exist, then 1 to go ahead or -1 to give up
+static volatile int32_t futex_test_go;
+
+static void futex_test_waiter(uint32_t word) {
+	while(futex_test_go == 0);
+	if(futex_test_go < 0)
+		return;
+	futex_test_waited = futex_wait((uint32_t *) word, 0);
+	futex_test_done++;
+}
+
+static void futex_test_waker(uint32_t word) {
+	while(futex_test_go == 0);
+	if(futex_test_go < 0)
+		return;
+
+	// the word holds 0, so this has to come straight back
+	futex_test_early = futex_wait((uint32_t *) word, 1);
+
+	while(PCB[futex_test_waiter_pid]->state != PROCESS_BLOCKED);
+	*((volatile uint32_t *) word) = 1;
+	futex_test_woken = futex_wake((uint32_t *) word, 1);
+	futex_test_done++;
+}
+
+/* futex_test_run
+ *
+ * Starts a waiter and a waker thread of leader on word and waits for both
+ * Inputs: leader -- process to run them in
+ *		   word -- user address holding 0
+ * Outputs: PASS/FAIL
+ */
+static int futex_test_run(PCB_BLOCK_t* leader, uint32_t word) {
+	futex_test_early = 0;
+	futex_test_waited = -1;
+	futex_test_woken = 0;
+	futex_test_done = 0;
+	futex_test_go = 0;
+	futex_test_waiter_pid = test_thread_create(leader, futex_test_waiter, word);
+	if(futex_test_waiter_pid < 0 || test_thread_create(leader, futex_test_waker, word) < 0) {
+		futex_test_go = -1;
+		return FAIL;
+	}
+	futex_test_go = 1;
+
+	while(futex_test_done < 2);
+	if(futex_test_early != -1 || futex_test_waited != 0 || futex_test_woken != 1)
+		return FAIL;
+	return PASS;
+}
+
+/* futex_test
+ *
+ * Runs two threads of one process on a word of its user page. The waiter sleeps
+ * while the word is 0, the waker first checks that waiting for a value the word
+ * doesn't hold returns -1 right away, then changes the word and wakes the waiter
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: blocks until both threads are done
+ * Files: futex.c
+ */
+int futex_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* leader;
+	uint32_t word = PROGRAM_VIRTUAL_ADDRESS_START;
+	int result = PASS;
+
+	leader = test_leader_create();
+	if(leader == NULL)
+		return FAIL;
+	if(user_mem_populate(leader, word, word + sizeof(uint32_t)) != 0) {
+		test_leader_free(leader);
+		return FAIL;
+	}
+
+	result = futex_test_run(leader, word);
+	test_leader_free(leader);
+	return result;
+}
+
+/* frame_alloc_test
+ *
+ * Checks that 4kB and 4MB frames come back aligned and that freeing them puts
+ * the free counts back where they were
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, everything allocated is released again
+ * Files: frame_alloc.c
+ */
+int frame_alloc_test() {
+	TEST_HEADER;
+
+	uint32_t free_frames = frame_free_count();
+	uint32_t small, large;
+
+	small = frame_alloc();
+	if(small == FRAME_NONE || (small & (FRAME_SIZE - 1)) || small < FRAME_MANAGED_START)
+		return FAIL;
+	if(frame_free_count() != free_frames - 1)
+		return FAIL;
+
+	large = frame_alloc_large();
+	if(large != FRAME_NONE) {
+		if((large & (LARGE_FRAME_SIZE - 1)) || frame_free_count() != free_frames - 1 - FRAMES_PER_LARGE)
+			return FAIL;
+		// the 4kB frame came out of a 4MB frame that was already broken up or a new one
+		if(small >= large && small < large + LARGE_FRAME_SIZE)
+			return FAIL;
+		frame_free_large(large);
+	}
+	frame_free(small);
+	if(frame_free_count() != free_frames)
+		return FAIL;
+	return PASS;
+}
+
+/* page_dir_test
+ *
+ * Checks that a new page directory starts out with exactly the kernel's
+ * entries, that the kernel page is global, and that it can be loaded and
+ * swapped back out
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the directory is freed again
+ * Files: page_structs.c
+ */
+int page_dir_test() {
+	TEST_HEADER;
+
+	uint32_t* dir = page_dir_create();
+	uint32_t old_cr3, flags;
+	int i, result = PASS;
+
+	if(dir == NULL)
+		return FAIL;
+	if(((uint32_t) dir & (PG_BASE_SIZE - 1)) || !(dir[1] & PAGE_GLOBAL_MASK))
+		result = FAIL;
+	for(i = 0; i < PG_ENTRIES; i++) {
+		if(dir[i] != page_directory[i])
+			result = FAIL;
+	}
+
+	cli_and_save(flags);
+	asm volatile ("movl %%cr3, %0" : "=r" (old_cr3));
+	if(page_dir_load(dir) != 1 || page_dir_load(dir) != 0)
+		result = FAIL;
+	page_dir_load((uint32_t *) old_cr3);
+	restore_flags(flags);
+
+	page_dir_destroy(dir);
+	return result;
+}
+
+/* tlb_flush_test
+ *
+ * Checks that short ranges are flushed page by page, long ones with a single
+ * CR3 load, and prints how the flushes so far split up by reason
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: flushes some of the kernel's own translations
+ * Files: tlb.c
+ */
+int tlb_flush_test() {
+	TEST_HEADER;
+
+	tlb_stats_t before, after;
+	uint32_t flags;
+	int i;
+
+	cli_and_save(flags);
+	tlb_get_stats(&before);
+	tlb_flush_page(KERNEL_MEM_START, TLB_REASON_BOOT);
+	tlb_flush_range(KERNEL_MEM_START, KERNEL_MEM_START + 2 * PG_BASE_SIZE, TLB_REASON_BOOT);
+	tlb_flush_range(KERNEL_MEM_START, KERNEL_MEM_START + (TLB_RANGE_MAX_PAGES + 1) * PG_BASE_SIZE, TLB_REASON_BOOT);
+	tlb_get_stats(&after);
+	restore_flags(flags);
+
+	for(i = 0; i < TLB_NUM_REASONS; i++)
+		printf("reason %d: %d pages, %d full\n", i, after.pages[i], after.full[i]);
+
+	// other processors may have flushed for other reasons in between, never for ours
+	if(after.pages[TLB_REASON_BOOT] - before.pages[TLB_REASON_BOOT] != 3)
+		return FAIL;
+	if(after.full[TLB_REASON_BOOT] - before.full[TLB_REASON_BOOT] != 1)
+		return FAIL;
+	return PASS;
+}
+
+/* kmalloc_test
+ *
+ * Checks that kmalloc hands out aligned memory of every size class and
+ * beyond, that a cache's usage goes back to where it was once everything is
+ * freed, and prints every cache's stats
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, everything allocated is released again
+ * Files: kmalloc.c
+ */
+int kmalloc_test() {
+	TEST_HEADER;
+
+	static kmem_cache_t test_cache;
+	static uint8_t test_cache_ready = 0;
+	kmem_cache_stats_t stats;
+	void* small[KMALLOC_NUM_CACHES + 1];
+	void* objects[16];
+	uint32_t i, in_use;
+	int result = PASS;
+
+	if(!test_cache_ready) {
+		kmem_cache_init(&test_cache, "test", 100);
+		test_cache_ready = 1;
+	}
+
+	// every size class, then one that takes whole pages
+	for(i = 0; i <= KMALLOC_NUM_CACHES; i++) {
+		small[i] = kmalloc((KMALLOC_MIN_SIZE << i) - 1);
+		if(small[i] == NULL || ((uint32_t) small[i] & (KMEM_ALIGN - 1)))
+			result = FAIL;
+		else
+			memset(small[i], i, (KMALLOC_MIN_SIZE << i) - 1);
+	}
+	for(i = 0; i <= KMALLOC_NUM_CACHES; i++)
+		kfree(small[i]);
+
+	in_use = test_cache.objects_in_use;
+	for(i = 0; i < 16; i++) {
+		objects[i] = kmem_cache_alloc(&test_cache);
+		if(objects[i] == NULL)
+			return FAIL;
+	}
+	if(test_cache.objects_in_use != in_use + 16 || test_cache.object_size != 112)
+		result = FAIL;
+	for(i = 0; i < 16; i++)
+		kmem_cache_free(&test_cache, objects[i]);
+	// everything went back, only the one empty slab is kept
+	if(test_cache.objects_in_use != in_use || test_cache.slabs > 1)
+		result = FAIL;
+
+	for(i = 0; kmem_cache_get_stats(i, &stats) == 0; i++)
+		printf("%s: %d/%d objects of %d bytes, %d pages\n", stats.name, stats.objects_in_use, stats.objects_total, stats.object_size, stats.pages);
+	return result;
+}
+
+/* user_mem_test
+ *
+ * Checks that a new address space costs no frames until pages are mapped,
+ * that sbrk moves the heap within its bounds, and that every frame comes
+ * back when the process is freed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, the PCB and its memory are freed again
+ * Files: user_mem.c, syscalls.c
+ */
+int user_mem_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	uint32_t free_frames = frame_free_count();
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	process = process_alloc(0, 0);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	process->page_directory = page_dir_create();
+	if(process->page_directory == NULL || user_mem_init(process) != 0)
+		result = FAIL;
+
+	if(result == PASS) {
+		if(process->resident_pages != 0 || frame_free_count() != free_frames)
+			result = FAIL;
+		if(user_mem_populate(process, PROGRAM_VIRTUAL_ADDRESS_START, PROGRAM_VIRTUAL_ADDRESS_START + PG_BASE_SIZE + 1) != 0)
+			result = FAIL;
+		if(process->resident_pages != 2 || user_mem_phys(process, PROGRAM_VIRTUAL_ADDRESS_START + 4) == FRAME_NONE)
+			result = FAIL;
+		if(user_mem_phys(process, PROGRAM_VIRTUAL_ADDRESS_START + 2 * PG_BASE_SIZE) != FRAME_NONE)
+			result = FAIL;
+
+		// the heap only exists once sbrk says so
+		if(user_mem_fault(process, USER_HEAP_START, 0) != -1)
+			result = FAIL;
+		if(user_mem_sbrk(process, PG_BASE_SIZE) != USER_HEAP_START || user_mem_fault(process, USER_HEAP_START, 0) != 0)
+			result = FAIL;
+		if(user_mem_sbrk(process, -2 * PG_BASE_SIZE) != -1 || user_mem_sbrk(process, -PG_BASE_SIZE) != USER_HEAP_START + PG_BASE_SIZE)
+			result = FAIL;
+		if(process->resident_pages != 2)
+			result = FAIL;
+	}
+
+	spin_lock(&sched_lock);
+	process_free(process);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+
+	if(frame_free_count() != free_frames)
+		result = FAIL;
+	return result;
+}
+
+/* cow_fork_test
+ *
+ * Checks that user_mem_fork shares frames instead of copying them, that a
+ * write fault gives the writer its own copy, and that the last sharer just
+ * gets write access back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, both PCBs and their memory are freed again
+ * Files: user_mem.c, frame_alloc.c
+ */
+int cow_fork_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* parent;
+	PCB_BLOCK_t* child;
+	uint32_t free_frames = frame_free_count();
+	uint32_t addr = PROGRAM_VIRTUAL_ADDRESS_START;
+	uint32_t shared;
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	parent = process_alloc(0, 0);
+	child = process_alloc(0, 0);
+	if(parent == NULL || child == NULL) {
+		spin_lock(&sched_lock);
+		if(parent != NULL)
+			process_free(parent);
+		if(child != NULL)
+			process_free(child);
+		spin_unlock(&sched_lock);
+		restore_flags(flags);
+		return FAIL;
+	}
+	parent->page_directory = page_dir_create();
+	child->page_directory = page_dir_create();
+	if(parent->page_directory == NULL || child->page_directory == NULL ||
+	   user_mem_init(parent) != 0 || user_mem_init(child) != 0 ||
+	   user_mem_populate(parent, addr, addr + PG_BASE_SIZE) != 0)
+		result = FAIL;
+
+	if(result == PASS) {
+		shared = user_mem_phys(parent, addr);
+		if(user_mem_fork(child, parent) != 0 || user_mem_phys(child, addr) != shared)
+			result = FAIL;
+		if(frame_refcount(shared) != 2 || child->resident_pages != 1 || frame_free_count() != free_frames - 1)
+			result = FAIL;
+
+		// reads never copy, a write leaves the parent alone with the old frame
+		if(user_mem_fault(child, addr, PAGE_FAULT_PRESENT) != -1)
+			result = FAIL;
+		if(user_mem_fault(child, addr, PAGE_FAULT_PRESENT | PAGE_FAULT_WRITE) != 0)
+			result = FAIL;
+		if(user_mem_phys(child, addr) == shared || frame_refcount(shared) != 1)
+			result = FAIL;
+		if(user_mem_fault(parent, addr, PAGE_FAULT_PRESENT | PAGE_FAULT_WRITE) != 0 || user_mem_phys(parent, addr) != shared)
+			result = FAIL;
+	}
+
+	spin_lock(&sched_lock);
+	process_free(child);
+	process_free(parent);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+
+	if(frame_free_count() != free_frames)
+		result = FAIL;
+	return result;
+}
+
+/* cow_futex_test
+ *
+ * Forks a process with a heap page, so the page is shared copy on write, then
+ * runs futex_test's waiter and waker in the parent on a word of it. The waker's
+ * store copies the page before it wakes, the waiter still has to be found
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: blocks until both threads are done
+ * Files: futex.c, user_mem.c
+ */
+int cow_futex_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* parent;
+	PCB_BLOCK_t* child;
+	uint32_t word = USER_HEAP_START;
+	uint32_t shared = FRAME_NONE;
+	uint32_t flags;
+	int result = PASS;
+
+	parent = test_leader_create();
+	child = test_leader_create();
+	if(parent == NULL || child == NULL) {
+		if(parent != NULL)
+			test_leader_free(parent);
+		if(child != NULL)
+			test_leader_free(child);
+		return FAIL;
+	}
+
+	cli_and_save(flags);
+	if(user_mem_sbrk(parent, PG_BASE_SIZE) != USER_HEAP_START || user_mem_fault(parent, word, 0) != 0 ||
+	   user_mem_fork(child, parent) != 0)
+		result = FAIL;
+	else
+		shared = user_mem_phys(parent, word);
+	restore_flags(flags);
+
+	if(result == PASS && shared != user_mem_phys(child, word))
+		result = FAIL;
+	if(result == PASS)
+		result = futex_test_run(parent, word);
+	// the waker's store has to have given the parent its own copy
+	if(result == PASS && user_mem_phys(parent, word) == shared)
+		result = FAIL;
+
+	test_leader_free(child);
+	test_leader_free(parent);
+	return result;
+}
+
+/* shm_test
+ *
+ * Checks that two processes attaching a segment by the same key get the
+ * same frames at the same address, and that the frames are freed once the
+ * last of them is gone
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None, both PCBs, their memory and the segment are freed again
+ * Files: shm.c, user_mem.c
+ */
+int shm_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* first;
+	PCB_BLOCK_t* second;
+	uint32_t free_frames = frame_free_count();
+	int32_t id, addr;
+	uint32_t frame;
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	first = process_alloc(0, 0);
+	second = process_alloc(0, 0);
+	if(first == NULL || second == NULL) {
+		spin_lock(&sched_lock);
+		if(first != NULL)
+			process_free(first);
+		if(second != NULL)
+			process_free(second);
+		spin_unlock(&sched_lock);
+		restore_flags(flags);
+		return FAIL;
+	}
+	first->page_directory = page_dir_create();
+	second->page_directory = page_dir_create();
+	if(first->page_directory == NULL || second->page_directory == NULL ||
+	   user_mem_init(first) != 0 || user_mem_init(second) != 0)
+		result = FAIL;
+
+	id = shm_get(391, 2 * PG_BASE_SIZE);
+	if(id < 0 || shm_get(391, PG_BASE_SIZE) != id || shm_get(391, SHM_SEGMENT_MAX_SIZE) != -1)
+		result = FAIL;
+
+	if(result == PASS) {
+		addr = shm_attach(first, id);
+		if(addr < USER_SHM_START || shm_attach(second, id) != addr || shm_attach(first, id) != addr)
+			result = FAIL;
+		frame = user_mem_phys(first, addr + PG_BASE_SIZE);
+		if(frame == FRAME_NONE || user_mem_phys(second, addr + PG_BASE_SIZE) != frame || frame_refcount(frame) != 3)
+			result = FAIL;
+		if(shm_detach(first, id) != 0 || shm_detach(first, id) != -1 || frame_refcount(frame) != 2)
+			result = FAIL;
+		if(user_mem_phys(first, addr) != FRAME_NONE || first->resident_pages != 0)
+			result = FAIL;
+	}
+
+	// second still has it attached, freeing it takes the segment with it
+	spin_lock(&sched_lock);
+	process_free(first);
+	process_free(second);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+
+	if(frame_free_count() != free_frames)
+		result = FAIL;
+	return result;
+}
+
+/* zero_pool_test
+ *
+ * Checks that refilling the zeroed pool doesn't count against free memory,
+ * and that frame_alloc_zeroed takes from it before zeroing on the spot
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: leaves the pool full
+ * Files: frame_alloc.c
+ */
+int zero_pool_test() {
+	TEST_HEADER;
+
+	frame_zero_stats_t before, after;
+	uint32_t free_frames;
+	uint32_t frame;
+	int result = PASS;
+
+	while(frame_zero_pool_refill() != 0);
+	free_frames = frame_free_count();
+	frame_zero_pool_get_stats(&before);
+	if(before.depth != FRAME_ZERO_POOL_SIZE)
+		result = FAIL;
+
+	frame = frame_alloc_zeroed();
+	frame_zero_pool_get_stats(&after);
+	if(frame == FRAME_NONE || after.hits != before.hits + 1 || after.depth != before.depth - 1)
+		result = FAIL;
+	if(frame_free_count() != free_frames - 1)
+		result = FAIL;
+	if(frame != FRAME_NONE)
+		frame_free(frame);
+
+	// an idle processor may get to it first
+	while(frame_zero_pool_refill() != 0);
+	if(frame_free_count() != free_frames)
+		result = FAIL;
+	return result;
+}
+
+/* swap_test
+ *
+ * Checks that a page the clock hand found cold twice goes out to the swap
+ * disk, gives its frame back, and comes back with what was in it on the
+ * next fault, and that the swap header in front of the slots is left alone
+ * Inputs: None
+ * Outputs: PASS/FAIL, PASS right away if there is no swap disk
+ * Side Effects: None, the PCB, its memory and the slot are freed again
+ * Files: swap.c, user_mem.c, ata.c
+ */
+int swap_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	swap_stats_t stats;
+	uint8_t header[ATA_SECTOR_SIZE];
+	uint32_t addr = PROGRAM_VIRTUAL_ADDRESS_START;
+	uint32_t hand = addr;
+	uint32_t free_frames = frame_free_count();
+	uint32_t flags;
+	int result = PASS;
+
+	swap_get_stats(&stats);
+	if(stats.slots == 0)
+		return PASS;
+
+	cli_and_save(flags);
+	process = process_alloc(0, 0);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	process->page_directory = page_dir_create();
+	if(process->page_directory == NULL || user_mem_init(process) != 0 ||
+	   user_mem_populate(process, addr, addr + PG_BASE_SIZE) != 0)
+		result = FAIL;
+
+	if(result == PASS) {
+		page_dir_load(process->page_directory);
+		*(volatile uint32_t *) addr = 0x391;
+		page_dir_load(page_directory);
+
+		// the write set the accessed bit, the first pass only clears it
+		spin_lock(&sched_lock);
+		if(swap_evict_locked(process, &hand) != 1 || swap_evict_locked(process, &hand) != 0)
+			result = FAIL;
+		spin_unlock(&sched_lock);
+		swap_write_pending();
+		if(process->resident_pages != 0 || user_mem_phys(process, addr) != FRAME_NONE)
+			result = FAIL;
+
+		if(user_mem_fault(process, addr, 0) != 0 || process->resident_pages != 1)
+			result = FAIL;
+		page_dir_load(process->page_directory);
+		if(*(volatile uint32_t *) addr != 0x391)
+			result = FAIL;
+		page_dir_load(page_directory);
+	}
+
+	spin_lock(&sched_lock);
+	process_free(process);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+
+	swap_get_stats(&stats);
+	if(stats.slots_used != 0 || frame_free_count() != free_frames)
+		result = FAIL;
+	if(ata_read(SWAP_DRIVE, 0, 1, header) != 0 || strncmp((int8_t *) header, (int8_t *) SWAP_MAGIC, SWAP_MAGIC_LEN) != 0)
+		result = FAIL;
+	return result;
+}
+
+/* vdata_test
+ *
+ * Checks that a new address space sees the vdata page read only at USER_VDATA_ADDR,
+ * and that a snapshot taken through it shows the tick count moving
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: waits for a couple of timer ticks
+ * Files: vdata.c, syscalls.c
+ */
+int vdata_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	const vdata_t* mapped = (const vdata_t *) USER_VDATA_ADDR;
+	uint32_t seq, first, second, hz;
+	uint32_t flags;
+	int result = PASS;
+
+	if(vdata == NULL || vdata->tick_hz == 0)
+		return FAIL;
+
+	cli_and_save(flags);
+	process = process_alloc(0, 0);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	if(process_address_space_create(process) != RETURN_PASS ||
+	   process->page_table_vid[VDATA_VID_ENTRY] != ((uint32_t) vdata | USER_READ_ONLY_PRESENT_ENABLE))
+		result = FAIL;
+	restore_flags(flags);
+
+	first = second = 0;
+	if(result == PASS) {
+		do {
+			cli_and_save(flags);
+			page_dir_load(process->page_directory);
+			do {
+				seq = vdata_read_begin(mapped);
+				second = mapped->ticks;
+				hz = mapped->tick_hz;
+			} while(vdata_read_retry(mapped, seq));
+			page_dir_load(page_directory);
+			restore_flags(flags);
+			if(first == 0)
+				first = second;
+		} while(second == first);
+		if(hz != vdata->tick_hz)
+			result = FAIL;
+	}
+
+	cli_and_save(flags);
+	spin_lock(&sched_lock);
+	process_free(process);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+	return result;
+}
+
+/* kstack_test
+ *
+ * Checks that a new kernel stack starts out fully painted, that its high-water mark
+ * follows the deepest word written, and that the depth outlives the process
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: kstack.c, syscalls.c
+ */
+int kstack_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	kstack_stats_t stats;
+	uint32_t* stack;
+	uint32_t words = PCB_KERNEL_PHYSICAL_OFFSET / sizeof(uint32_t);
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	process = process_alloc(0, PROCESS_FLAG_KTHREAD);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	stack = (uint32_t *) process->kernel_stack;
+
+	if(kstack_high_water(process) != 0)
+		result = FAIL;
+	// as if the process had pushed 16 words
+	stack[words - 16] = 0;
+	if(kstack_high_water(process) != 16 * sizeof(uint32_t))
+		result = FAIL;
+	kstack_check(process);
+
+	if(kstack_get_stats(process->pid, &stats) != 0 || stats.size != PCB_KERNEL_PHYSICAL_OFFSET ||
+	   stats.high_water != 16 * sizeof(uint32_t) || stats.max_high_water < stats.high_water)
+		result = FAIL;
+
+	spin_lock(&sched_lock);
+	process_free(process);
+	spin_unlock(&sched_lock);
+	restore_flags(flags);
+
+	if(kstack_get_stats(NO_PID, &stats) != 0 || stats.high_water != 0 || stats.max_high_water < 16 * sizeof(uint32_t))
+		result = FAIL;
+	return result;
+}
+
+static volatile uint32_t workqueue_test_runs;
+
+static void workqueue_test_func(uint32_t data) {
+	workqueue_test_runs += data;
+}
+
+/* workqueue_test
+ *
+ * Checks that work queued twice before the kworker gets to it only runs once
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: blocks until the kworker has run the work
+ * Files: workqueue.c, kthread.c
+ */
+int workqueue_test() {
+	TEST_HEADER;
+
+	static work_t work;
+	uint32_t flags;
+	int first, second;
+
+	workqueue_test_runs = 0;
+	work_init(&work, workqueue_test_func, 1);
+
+	// kworker can't run until interrupts are back on
+	cli_and_save(flags);
+	first = queue_work(&work);
+	second = queue_work(&work);
+	restore_flags(flags);
+	if(first != 1 || second != 0)
+		return FAIL;
+
+	while(workqueue_test_runs == 0);
+	if(workqueue_test_runs != 1)
+		return FAIL;
+	return PASS;
+}
+
+/* smp_test
+ *
+ * Checks that the boot processor is cpus[0], that every processor in the MP table
+ * came online with its own TSS, and that a spinlock can be taken and dropped
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: smp.c, apic.c, spinlock.h
+ */
+int smp_test() {
+	TEST_HEADER;
+
+	spinlock_t lock = SPINLOCK_INIT;
+	uint32_t flags;
+	uint8_t i;
+
+	// tests run on the boot thread
+	cli_and_save(flags);
+	if(this_cpu() != &cpus[0]) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	restore_flags(flags);
+
+	for(i = 0; i < num_cpus; i++) {
+		if(!cpus[i].online || cpus[i].tss.ss0 != KERNEL_DS)
+			return FAIL;
+	}
+
+	spin_lock_irqsave(&lock, flags);
+	if(!lock.locked) {
+		spin_unlock_irqrestore(&lock, flags);
+		return FAIL;
+	}
+	spin_unlock_irqrestore(&lock, flags);
+	if(lock.locked)
+		return FAIL;
+	return PASS;
+}
+
+/* mutex_test
+ *
+ * Checks that a held mutex can't be taken again and is free once unlocked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: mutex.c
+ */
+int mutex_test() {
+	TEST_HEADER;
+
+	mutex_t mutex;
+
+	mutex_init(&mutex);
+	if(!mutex_trylock(&mutex))
+		return FAIL;
+	if(mutex_trylock(&mutex)) {
+		mutex_unlock(&mutex);
+		return FAIL;
+	}
+	mutex_unlock(&mutex);
+	if(mutex.locked)
+		return FAIL;
+
+	// uncontended, so this never sleeps
+	mutex_lock(&mutex);
+	if(!mutex.locked)
+		return FAIL;
+	mutex_unlock(&mutex);
+	return PASS;
+}
+
+/* sched_balance_test
+ *
+ * Reads every processor's counters back and checks that each migration left one
+ * processor and arrived at another, and that nobody stole more than it received
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: scheduler.c
+ */
+int sched_balance_test() {
+	TEST_HEADER;
+
+	sched_stats_t stats;
+	uint32_t total_in = 0;
+	uint32_t total_out = 0;
+	uint8_t i;
+
+	if(scheduler_get_stats(num_cpus, &stats) != -1)
+		return FAIL;
+
+	for(i = 0; i < num_cpus; i++) {
+		if(scheduler_get_stats(i, &stats) != 0)
+			return FAIL;
+		if(stats.steals > stats.migrations_in || stats.idle_ticks > stats.ticks)
+			return FAIL;
+		total_in += stats.migrations_in;
+		total_out += stats.migrations_out;
+	}
+	if(total_in != total_out)
+		return FAIL;
+	return PASS;
+}
+
+// bytes pushed through each pipe by pipe_throughput_test
+#define PIPE_BENCH_BYTES (4 * 1024 * 1024)
+// largest ring buffer it tries, in pages, also the size of its scratch buffers
+#define PIPE_BENCH_MAX_PAGES 16
+#define PIPE_BENCH_CALIBRATE_US 10000
+
+/* low half of the time stamp counter, enough for the intervals below */
+static inline uint32_t rdtsc_low() {
+	uint32_t low, high;
+	asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+	return low;
+}
+
+/* pipe_throughput_test
+ *
+ * Pushes PIPE_BENCH_BYTES through pipes with 1 to PIPE_BENCH_MAX_PAGES pages of
+ * ring buffer, filling and draining it a buffer at a time, and prints MB/s for
+ * each size. Checks that every byte comes out the way it went in
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the throughput of each buffer size
+ * Files: pipe.c
+ */
+int pipe_throughput_test() {
+	TEST_HEADER;
+
+	uint8_t* src;
+	uint8_t* dst;
+	pipe_t* pipe;
+	uint32_t pages, moved, chunk, i;
+	uint32_t start, cycles, cycles_per_us;
+	int32_t idx;
+	int result = PASS;
+
+	src = (uint8_t *) page_pool_alloc(PIPE_BENCH_MAX_PAGES);
+	dst = (uint8_t *) page_pool_alloc(PIPE_BENCH_MAX_PAGES);
+	if(src == NULL || dst == NULL)
+		return FAIL;
+	for(i = 0; i < PIPE_BENCH_MAX_PAGES * PG_BASE_SIZE; i++)
+		src[i] = (uint8_t) i;
+
+	start = rdtsc_low();
+	pit_delay_us(PIPE_BENCH_CALIBRATE_US);
+	cycles_per_us = (rdtsc_low() - start) / PIPE_BENCH_CALIBRATE_US;
+	if(cycles_per_us == 0)
+		cycles_per_us = 1;
+
+	for(pages = 1; pages <= PIPE_BENCH_MAX_PAGES && result == PASS; pages <<= 1) {
+		idx = pipe_alloc(pages);
+		if(idx < 0) {
+			result = FAIL;
+			break;
+		}
+		pipe = pipe_get(idx);
+		chunk = pages * PG_BASE_SIZE;
+
+		start = rdtsc_low();
+		for(moved = 0; moved < PIPE_BENCH_BYTES; moved += chunk) {
+			if(pipe_copy_in(pipe, src, chunk) != chunk || pipe_copy_out(pipe, dst, chunk) != chunk) {
+				result = FAIL;
+				break;
+			}
+		}
+		cycles = rdtsc_low() - start;
+
+		for(i = 0; i < chunk; i++) {
+			if(dst[i] != src[i])
+				result = FAIL;
+		}
+		// bytes per microsecond is MB/s
+		printf("pipe %d kB buffer: %d MB/s\n", chunk / 1024, PIPE_BENCH_BYTES / (cycles / cycles_per_us + 1));
+		pipe_release(pipe);
+	}
+
+	page_pool_free(src, PIPE_BENCH_MAX_PAGES);
+	page_pool_free(dst, PIPE_BENCH_MAX_PAGES);
+	return result;
+}
+
+/* io_ring_test
+ *
+ * Fills the submission ring with operations that don't need a process: nops, an
+ * unknown op and a close of stdin. Checks that they complete in order with their
+ * user_data and results, that nothing more runs while cq is full, and that the
+ * next submission goes through once a completion was consumed
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: io_ring.c
+ */
+int io_ring_test() {
+	TEST_HEADER;
+
+	io_ring_t* ring;
+	io_sqe_t* sqe;
+	uint32_t i;
+	int result = PASS;
+
+	ring = (io_ring_t *) page_pool_alloc((sizeof(io_ring_t) + PG_BASE_SIZE - 1) / PG_BASE_SIZE);
+	if(ring == NULL)
+		return FAIL;
+	memset(ring, 0, sizeof(io_ring_t));
+
+	for(i = 0; i < IO_RING_ENTRIES; i++) {
+		sqe = &ring->sq[ring->sq_tail & IO_RING_MASK];
+		sqe->op = (i == 1) ? 0xFF : (i == 2) ? IO_OP_CLOSE : IO_OP_NOP;
+		sqe->fd = 0;
+		sqe->user_data = i;
+		ring->sq_tail++;
+	}
+
+	if(io_ring_drain(ring, IO_RING_ENTRIES * 2) != IO_RING_ENTRIES || ring->cq_tail != IO_RING_ENTRIES)
+		result = FAIL;
+	for(i = 0; i < IO_RING_ENTRIES; i++) {
+		if(ring->cq[i].user_data != i || ring->cq[i].result != ((i == 1 || i == 2) ? -1 : 0))
+			result = FAIL;
+	}
+
+	// cq is full, so a new submission has to wait until we consume a completion
+	sqe = &ring->sq[ring->sq_tail & IO_RING_MASK];
+	sqe->op = IO_OP_NOP;
+	sqe->user_data = IO_RING_ENTRIES;
+	ring->sq_tail++;
+	if(io_ring_drain(ring, 1) != 0)
+		result = FAIL;
+	ring->cq_head++;
+	if(io_ring_drain(ring, 1) != 1 || ring->cq[IO_RING_ENTRIES & IO_RING_MASK].user_data != IO_RING_ENTRIES ||
+	   ring->sq_head != ring->sq_tail)
+		result = FAIL;
+
+	page_pool_free(ring, (sizeof(io_ring_t) + PG_BASE_SIZE - 1) / PG_BASE_SIZE);
+	return result;
+}
+
+/* poll_test
+ *
+ * Polls without waiting on fds that aren't open, which have to come back POLLNVAL
+ * and count as ready even though no event was asked for, checks that an empty
+ * poll returns 0 right away, and that fcntl and the nonblocking check refuse them
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Files: poll.c
+ */
+int poll_test() {
+	TEST_HEADER;
+
+	pollfd_t fds[2];
+	int result = PASS;
+
+	fds[0].fd = -1;
+	fds[0].events = POLLIN;
+	fds[1].fd = FILE_DESCRIPTOR_SIZE;
+	fds[1].events = 0;
+	if(poll_files(fds, 2, 0) != 2 || fds[0].revents != POLLNVAL || fds[1].revents != POLLNVAL)
+		result = FAIL;
+	if(poll_files(fds, 0, 0) != 0)
+		result = FAIL;
+	if(poll_ready(-1, POLLOUT) != POLLNVAL)
+		result = FAIL;
+	if(poll_always_ready(0) != (POLLIN | POLLOUT))
+		result = FAIL;
+	if(sys_fcntl(FILE_DESCRIPTOR_SIZE, F_SETFL, O_NONBLOCK) != -1)
+		result = FAIL;
+
+	return result;
+}
+
+// round trips syscall_bench_test times through each way into the kernel
+#define SYSCALL_BENCH_ITERATIONS 100000
+
+// what syscall_bench_user finds at its esp, see tests_user.S
+typedef struct syscall_bench {
+	uint32_t iterations;
+	uint32_t use_sysenter;
+	uint32_t int80_cycles;
+	uint32_t sysenter_cycles;
+	volatile uint32_t done;
+	volatile uint32_t ack;
+} syscall_bench_t;
+
+extern uint8_t syscall_bench_user;
+extern uint8_t syscall_bench_user_end;
+
+/* syscall_bench_test
+ *
+ * Runs syscall_bench_user in a process of its own, which times a syscall that
+ * fails right away through int 0x80 and through sysenter, and prints the cycles
+ * per round trip of each. Checks that sysenter is the faster one
+ * Inputs: None
+ * Outputs: PASS/FAIL, int 0x80 alone has to work if the CPU can't sysenter
+ * Side Effects: prints the cycles per syscall, the process halts afterwards
+ * Files: sysenter.c, syscalls_linkage.S, tests_user.S
+ */
+int syscall_bench_test() {
+	TEST_HEADER;
+
+	PCB_BLOCK_t* process;
+	syscall_bench_t* bench;
+	uint32_t code = PROGRAM_VIRTUAL_ADDRESS_START;
+	uint32_t int80_cycles = 0;
+	uint32_t sysenter_cycles = 0;
+	uint32_t done = 0;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	process = process_alloc(0, 0);
+	if(process == NULL) {
+		restore_flags(flags);
+		return FAIL;
+	}
+	strncpy((int8_t *) process->cmd_name, "syscall_bench", ARG_BUF_SIZE - 1);
+	if(process_address_space_create(process) != RETURN_PASS ||
+	   user_mem_populate(process, code, code + PG_BASE_SIZE) != 0) {
+		spin_lock(&sched_lock);
+		process_free(process);
+		spin_unlock(&sched_lock);
+		restore_flags(flags);
+		return FAIL;
+	}
+
+	// code at the bottom of the page, its stack and numbers at the top
+	bench = (syscall_bench_t *) (code + PG_BASE_SIZE - sizeof(syscall_bench_t));
+	page_dir_load(process->page_directory);
+	memcpy((void *) code, &syscall_bench_user, &syscall_bench_user_end - &syscall_bench_user);
+	memset(bench, 0, sizeof(syscall_bench_t));
+	bench->iterations = SYSCALL_BENCH_ITERATIONS;
+	bench->use_sysenter = sysenter_enabled;
+	page_dir_load(page_directory);
+
+	process_setup_first_run(process, code, (uint32_t) bench);
+	process->state = PROCESS_RUNNABLE;
+	scheduler_enqueue(process);
+	restore_flags(flags);
+
+	// the process sleeps on bench->ack once it is done, which leaves the processor to us
+	while(!done) {
+		cli_and_save(flags);
+		page_dir_load(process->page_directory);
+		done = bench->done;
+		if(done) {
+			int80_cycles = bench->int80_cycles / SYSCALL_BENCH_ITERATIONS;
+			sysenter_cycles = bench->sysenter_cycles / SYSCALL_BENCH_ITERATIONS;
+			bench->ack = 1;
+			futex_wake((uint32_t *) &bench->ack, 1);
+		}
+		page_dir_load(page_directory);
+		restore_flags(flags);
+	}
+
+	printf("int 0x80: %d cycles per syscall\n", int80_cycles);
+	if(!sysenter_enabled)
+		return PASS;
+	printf("sysenter: %d cycles per syscall\n", sysenter_cycles);
+	return (sysenter_cycles < int80_cycles) ? PASS : FAIL;
+}
+
 /* Test suite entry point */
 void launch_tests() {
 	// For CP 1
@@ -528,4 +1988,32 @@ void launch_tests() {
 	// TEST_OUTPUT("fs_file_open_close_test", fs_file_open_close_test());
 	// TEST_OUTPUT("fs_file_open_invalid_file_test", fs_file_open_invalid_file_test());
 	// test_terminal();
+
+	// For CP 5
+	// TEST_OUTPUT("fpu_test", fpu_test());
+	// TEST_OUTPUT("multi_term_test", multi_term_test());
+	// TEST_OUTPUT("process_table_alloc_test", process_table_alloc_test());
+	// TEST_OUTPUT("process_leader_test", process_leader_test());
+	// TEST_OUTPUT("wait_queue_test", wait_queue_test());
+	// TEST_OUTPUT("futex_test", futex_test());
+	// TEST_OUTPUT("frame_alloc_test", frame_alloc_test());
+	// TEST_OUTPUT("page_dir_test", page_dir_test());
+	// TEST_OUTPUT("tlb_flush_test", tlb_flush_test());
+	// TEST_OUTPUT("kmalloc_test", kmalloc_test());
+	// TEST_OUTPUT("user_mem_test", user_mem_test());
+	// TEST_OUTPUT("cow_fork_test", cow_fork_test());
+	// TEST_OUTPUT("cow_futex_test", cow_futex_test());
+	// TEST_OUTPUT("shm_test", shm_test());
+	// TEST_OUTPUT("zero_pool_test", zero_pool_test());
+	// TEST_OUTPUT("swap_test", swap_test());
+	// TEST_OUTPUT("kstack_test", kstack_test());
+	// TEST_OUTPUT("vdata_test", vdata_test());
+	// TEST_OUTPUT("workqueue_test", workqueue_test());
+	// TEST_OUTPUT("smp_test", smp_test());
+	// TEST_OUTPUT("mutex_test", mutex_test());
+	// TEST_OUTPUT("sched_balance_test", sched_balance_test());
+	// TEST_OUTPUT("pipe_throughput_test", pipe_throughput_test());
+	// TEST_OUTPUT("syscall_bench_test", syscall_bench_test());
+	// TEST_OUTPUT("io_ring_test", io_ring_test());
+	// TEST_OUTPUT("poll_test", poll_test());
 }
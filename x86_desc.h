@@ -16,6 +16,9 @@
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
 
+/* Entries in the GDT, two unused, four segments, the TSS and the LDT */
+#define NUM_GDT_ENTRIES 8
+
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
@@ -118,6 +121,7 @@ extern uint16_t ldt_desc;
 extern uint32_t ldt_size;
 extern seg_desc_t ldt_desc_ptr;
 extern seg_desc_t gdt_ptr;
+extern seg_desc_t gdt[NUM_GDT_ENTRIES];
 extern uint32_t ldt;
 
 extern uint32_t tss_size;